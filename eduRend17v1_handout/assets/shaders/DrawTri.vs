@@ -1,18 +1,44 @@
 
+// Vertex layout, set from vertex_format_t when compiling:
+// VERTEX_NORMAL, VERTEX_TANGENTS: 0 = none, 1 = float3, 2 = octahedral
+// VERTEX_TEXCOORD: 0 = none, 1 = float2 (or half2)
+#ifndef VERTEX_NORMAL
+#define VERTEX_NORMAL 1
+#endif
+#ifndef VERTEX_TANGENTS
+#define VERTEX_TANGENTS 1
+#endif
+#ifndef VERTEX_TEXCOORD
+#define VERTEX_TEXCOORD 1
+#endif
+
 cbuffer MatrixBuffer : register(b0)
 {
 	matrix ModelToWorldMatrix;
 	matrix WorldToViewMatrix;
 	matrix ProjectionMatrix;
+	float4 PosScale;	// dequantization of positions, identity for float3
+	float4 PosOffset;
 };
 
 struct VSIn
 {
 	float3 Pos : POSITION;
+#if VERTEX_NORMAL == 1
 	float3 Normal : NORMAL;
+#elif VERTEX_NORMAL == 2
+	float2 Normal : NORMAL;
+#endif
+#if VERTEX_TANGENTS == 1
 	float3 Tangent : TANGENT;
 	float3 Binormal : BINORMAL;
+#elif VERTEX_TANGENTS == 2
+	float2 Tangent : TANGENT;
+	float2 Binormal : BINORMAL;
+#endif
+#if VERTEX_TEXCOORD
 	float2 TexCoord : TEX;
+#endif
 };
 
 struct PSIn
@@ -23,6 +49,18 @@ struct PSIn
 	float3 WorldPos : WORLDPOS;
 };
 
+//-----------------------------------------------------------------------------------------
+// Octahedral decoding of unit vectors
+//-----------------------------------------------------------------------------------------
+
+float3 oct_decode(float2 e)
+{
+	float3 v = float3(e, 1 - abs(e.x) - abs(e.y));
+	float t = max(-v.z, 0);
+	v.xy += v.xy >= 0 ? -t : t;
+	return normalize(v);
+}
+
 //-----------------------------------------------------------------------------------------
 // Vertex Shader
 //-----------------------------------------------------------------------------------------
@@ -38,11 +76,26 @@ PSIn VS_main(VSIn input)
 	// SV_Position expects the output position to be in clip space
 	matrix MVP = mul(ProjectionMatrix, MV);
 	
+	// Decode vertex attributes
+	float3 Pos = input.Pos * PosScale.xyz + PosOffset.xyz;
+#if VERTEX_NORMAL == 1
+	float3 Normal = input.Normal;
+#elif VERTEX_NORMAL == 2
+	float3 Normal = oct_decode(input.Normal);
+#else
+	float3 Normal = float3(0, 0, 1);
+#endif
+#if VERTEX_TEXCOORD
+	float2 TexCoord = input.TexCoord;
+#else
+	float2 TexCoord = float2(0, 0);
+#endif
+
 	// Perform transformations and send to output
-	output.Pos = mul(MVP, float4(input.Pos, 1));
-	output.Normal = normalize( mul(ModelToWorldMatrix, float4(input.Normal,0)).xyz );
-	output.TexCoord = input.TexCoord;
-	output.WorldPos = mul(ModelToWorldMatrix, float4(input.Pos, 1));
+	output.Pos = mul(MVP, float4(Pos, 1));
+	output.Normal = normalize( mul(ModelToWorldMatrix, float4(Normal,0)).xyz );
+	output.TexCoord = TexCoord;
+	output.WorldPos = mul(ModelToWorldMatrix, float4(Pos, 1));
 
 	return output;
 }
\ No newline at end of file
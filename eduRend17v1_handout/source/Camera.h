@@ -10,13 +10,14 @@
 
 #include "vec\vec.h"
 #include "vec\mat.h"
+#include "vec\quat.h"
 #include <iostream>
 
 using namespace linalg;
 
 class camera_t
 {
-	float pitch, yaw;
+	float pitch = 0.0f, yaw = 0.0f;
 	float camera_speed = 50.0f;
 	float sensitivity = 0.5f;
 public:
@@ -26,7 +27,7 @@ public:
 						// zNear should be >0
 						// zFar should depend on the size of the scene
 	vec3f position;
-	mat4f rotationMatrix;
+	quatf rotation;		// View-to-World rotation
 	camera_t(
 		float vfov,
 		float aspect,
@@ -48,32 +49,39 @@ public:
 	//
 	void move(const vec3f& v)
 	{
-		vec4f direction = v.xyz0();
-		vec4f velocity = get_ViewToWorldMatrix() * direction * camera_speed;
-		position += velocity.xyz();
+		position += rotation.rotate(v) * camera_speed;
 	}
 
 	// Return World-to-View matrix for this camera
 	//
 	mat4f get_WorldToViewMatrix()
 	{
-		// Assuming a camera's position and rotation is defined by matrices T(p) and R,
-		// the View-to-World transform is T(p)*R (for a first-person style camera)
-		// World-to-View then is the inverse of T*R;
-		//	inverse(T(p)*R) = inverse(R)*inverse(T(p)) = transpose(R)*T(-p)
-		// Since now there is no rotation, this matrix is simply T(-p)
+		return get_WorldToViewTransform().to_mat4();
+	}
 
-		return transpose(rotationMatrix) * mat4f::translation(-position);
+	// Assuming a camera's position and rotation is defined by matrices T(p) and R,
+	// the View-to-World transform is T(p)*R (for a first-person style camera)
+	// World-to-View then is the inverse of T*R;
+	//	inverse(T(p)*R) = inverse(R)*inverse(T(p)) = transpose(R)*T(-p)
+	// which, R being a rotation, is what inverse_similarity() computes
+	//
+	affine3x4f get_WorldToViewTransform()
+	{
+		return affine3x4f(rotation, position).inverse_similarity();
 	}
 
 	mat4f get_ViewToWorldMatrix() {
-		return mat4f::translation(position)* rotationMatrix;
+		return affine3x4f(rotation, position).to_mat4();
 	}
 
+	// Yaw around the world y axis, then pitch around the camera's x axis:
+	// Ry(yaw) * Rx(pitch), as mat4f::rotation(0, yaw, pitch), from two half-angle
+	// sin/cos pairs
+	//
 	void RotateCamera(float mouseY, float mouseX) {
 		pitch -= mouseY * sensitivity;
 		yaw -= mouseX * sensitivity;
-		rotationMatrix = mat4f::rotation(0, yaw, pitch);
+		rotation = quatf::rotation(yaw, 0.0f, 1.0f, 0.0f) * quatf::rotation(pitch, 1.0f, 0.0f, 0.0f);
 	}
 
 	// Matrix transforming from View space to Clip space
@@ -1,6 +1,19 @@
 
+#include <chrono>
+#include <cstring>
+#include <cfloat>
 #include "Geometry.h"
+#include "mesh_cache.h"
+#include "texture_cache.h"
+#include "vec/transform_batch.h"
 
+namespace
+{
+	PhongBuffer_t phong_constants(const material_t& mtl)
+	{
+		return { float4(mtl.Ka, 0), float4(mtl.Kd, mtl.d), float4(mtl.Ks, mtl.Ns) };
+	}
+}
 
 void Geometry_t::MapMatrixBuffers(
 	ID3D11Buffer* matrix_buffer,
@@ -15,14 +28,77 @@ void Geometry_t::MapMatrixBuffers(
 	matrix_buffer_->ModelToWorldMatrix = ModelToWorldMatrix;
 	matrix_buffer_->WorldToViewMatrix = WorldToViewMatrix;
 	matrix_buffer_->ProjectionMatrix = ProjectionMatrix;
+	matrix_buffer_->PosScale = vertex_decode.pos_scale.xyz0();
+	matrix_buffer_->PosOffset = vertex_decode.pos_offset.xyz0();
 	dxdevice_context->Unmap(matrix_buffer, 0);
 }
 
+void Geometry_t::MapMatrixBuffers(
+	ID3D11Buffer* matrix_buffer,
+	const affine3x4f& ModelToWorldMatrix,
+	const affine3x4f& WorldToViewMatrix,
+	const mat4f& ProjectionMatrix)
+{
+	MapMatrixBuffers(matrix_buffer, ModelToWorldMatrix.to_mat4(), WorldToViewMatrix.to_mat4(), ProjectionMatrix);
+}
+
+
+HRESULT Geometry_t::create_vertex_buffer(	const vertex_t* vertices,
+											size_t nbr_vertices,
+											vertex_encoding_error_t* error)
+{
+	std::vector<unsigned char> encoded;
+	vertex_decode = encode_vertices(vertex_format, vertices, nbr_vertices, encoded);
+	if (error)
+		*error = measure_encoding_error(vertex_format, vertex_decode, vertices, nbr_vertices, encoded.data());
+
+	// Vertex array descriptor
+	D3D11_BUFFER_DESC vbufferDesc = { 0.0f };
+	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbufferDesc.CPUAccessFlags = 0;
+	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	vbufferDesc.MiscFlags = 0;
+	vbufferDesc.ByteWidth = encoded.size();
+	// Data resource
+	D3D11_SUBRESOURCE_DATA vdata;
+	vdata.pSysMem = encoded.data();
+	// Create vertex buffer on device using descriptor & data
+	return dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
+}
+
+
+HRESULT Geometry_t::create_index_buffer(const void* indices, size_t nbr_indices, unsigned index_size)
+{
+	index_format = index_size == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+	//  Index array descriptor
+	D3D11_BUFFER_DESC ibufferDesc = { 0.0f };
+	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibufferDesc.CPUAccessFlags = 0;
+	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	ibufferDesc.MiscFlags = 0;
+	ibufferDesc.ByteWidth = nbr_indices*index_size;
+	// Data resource
+	D3D11_SUBRESOURCE_DATA idata;
+	idata.pSysMem = indices;
+	// Create index buffer on device using descriptor & data
+	return dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
+}
+
+HRESULT Geometry_t::create_index_buffer(const std::vector<unsigned>& indices)
+{
+	std::vector<unsigned short> indices16;
+	if (pack_indices_16bit(indices, indices16))
+		return create_index_buffer(indices16.data(), indices16.size(), 2);
+	return create_index_buffer(indices.data(), indices.size(), 4);
+}
+
 
 Quad_t::Quad_t(
 	ID3D11Device* dxdevice,
-	ID3D11DeviceContext* dxdevice_context)
-	: Geometry_t(dxdevice, dxdevice_context)
+	ID3D11DeviceContext* dxdevice_context,
+	const vertex_format_t& vertex_format)
+	: Geometry_t(dxdevice, dxdevice_context, vertex_format)
 {
 	// Populate the vertex array with 4 vertices
 	vertex_t v0, v1, v2, v3;
@@ -53,31 +129,11 @@ Quad_t::Quad_t(
 	indices.push_back(2);
 	indices.push_back(3);
 
-	// Vertex array descriptor
-	D3D11_BUFFER_DESC vbufferDesc = { 0.0f };
-	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbufferDesc.CPUAccessFlags = 0;
-	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = vertices.size()*sizeof(vertex_t);
-	// Data resource
-	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &vertices[0];
-	// Create vertex buffer on device using descriptor & data
-	HRESULT vhr = dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
+	// Create vertex buffer on device
+	HRESULT vhr = create_vertex_buffer(vertices.data(), vertices.size());
 
-	//  Index array descriptor
-	D3D11_BUFFER_DESC ibufferDesc = { 0.0f };
-	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibufferDesc.CPUAccessFlags = 0;
-	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = indices.size()*sizeof(unsigned);
-	// Data resource
-	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
-	// Create index buffer on device using descriptor & data
-	HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
+	// Create index buffer on device
+	HRESULT ihr = create_index_buffer(indices);
 
 	// Local data is now loaded to device so it can be released
 	vertices.clear();
@@ -92,12 +148,12 @@ void Quad_t::render() const
 	dxdevice_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// bind our vertex buffer
-	UINT32 stride = sizeof(vertex_t); //  sizeof(float) * 8;
+	UINT32 stride = vertex_format.stride();
 	UINT32 offset = 0;
 	dxdevice_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
 	// bind our index buffer
-	dxdevice_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	dxdevice_context->IASetIndexBuffer(index_buffer, index_format, 0);
 
 	// make the drawcall
 	dxdevice_context->DrawIndexed(nbr_indices, 0, 0);
@@ -107,85 +163,187 @@ void Quad_t::render() const
 OBJModel_t::OBJModel_t(
 	const std::string& objfile,
 	ID3D11Device* dxdevice,
-	ID3D11DeviceContext* dxdevice_context)
-	: Geometry_t(dxdevice, dxdevice_context)
+	ID3D11DeviceContext* dxdevice_context,
+	const vertex_format_t& vertex_format)
+	: Geometry_t(dxdevice, dxdevice_context, vertex_format)
 {
-	// Load the OBJ
-	mesh_t* mesh = new mesh_t();
-	mesh->load_obj(objfile);
+	auto load_start = std::chrono::high_resolution_clock::now();
+
+	// load options, part of the cache key: vertices shared between drawcalls (bit 0),
+	// vertex cache optimization (bit 1), tangents (bit 2), texture atlases (bit 3)
+	const bool optimize = true;
+	const bool tangents = true;
+	const bool atlases = true;
+	const unsigned cache_options = 1 | (optimize ? 2 : 0) | (tangents ? 4 : 0) | (atlases ? 8 : 0);
+
+	// Vertex and index data, either mapped from the mesh cache or loaded from the OBJ
+	mesh_cache_t cache;
+	std::vector<vertex_t> vertices;
+	std::vector<unsigned> indices;
+	std::vector<unsigned short> indices16;
+	const vertex_t* vertex_data;
+	const void* index_data;
+	size_t nbr_vertices, nbr_indices;
+	unsigned index_size;
+
+	bool cached = cache.load(objfile, cache_options);
+	if (cached)
+	{
+		vertex_data = cache.vertices;
+		nbr_vertices = cache.nbr_vertices;
+		index_data = cache.indices;
+		nbr_indices = cache.nbr_indices;
+		index_size = cache.index_size;
+		index_ranges = cache.index_ranges;
+		append_materials(cache.materials);
+	}
+	else
+	{
+		// Load the OBJ
+		mesh_t* mesh = new mesh_t();
+		mesh->load_obj(objfile, true, true, true);
+		if (atlases)
+			mesh->pack_texture_atlases(objfile + ".atlas");
+		if (tangents)
+			mesh->compute_tangents();
+		if (optimize)
+			mesh->optimize_vertex_cache();
+
+		// Load and organize indices in ranges per drawcall (material),
+		// and use 16-bit indices if possible
+		mesh->get_index_ranges(indices, index_ranges);
+		bool use_16bit = pack_indices_16bit(indices, indices16);
+
+		mesh->get_vertices(vertices);
+		vertex_data = vertices.data();
+		nbr_vertices = vertices.size();
+		index_data = use_16bit ? (const void*)indices16.data() : (const void*)indices.data();
+		nbr_indices = indices.size();
+		index_size = use_16bit ? 2 : 4;
+
+		// Copy materials from mesh
+		append_materials(mesh->materials);
+
+		if (!mesh_cache_t::write(objfile, cache_options, mesh->source_files, vertices, index_data, nbr_indices, index_size, index_ranges, materials))
+			printf("Failed to write mesh cache %s\n", mesh_cache_t::cache_filename(objfile).c_str());
+
+		SAFE_DELETE(mesh);
+	}
 
-	// Load and organize indices in ranges per drawcall (material)
+	double load_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - load_start).count();
+	printf("%s %s in %.1f ms (%d index ranges, %d-bit indices)\n", cached ? "Mapped cached" : "Loaded", objfile.c_str(), load_ms, (int)index_ranges.size(), index_size * 8);
 
-	std::vector<unsigned> indices;
-	size_t i_ofs = 0;
+	// Create vertex buffer on device
+	vertex_encoding_error_t verr;
+	HRESULT vhr = create_vertex_buffer(vertex_data, nbr_vertices, &verr);
+	printf("Vertex format %s: %u bytes/vertex, %.1f KB (%.1f KB as vertex_t)\n",
+		vertex_format.name().c_str(), vertex_format.stride(),
+		nbr_vertices * vertex_format.stride() / 1024.0, nbr_vertices * sizeof(vertex_t) / 1024.0);
+	printf("\tmax error: position %.2e, normal %.4f deg, tangents %.4f deg, texcoord %.2e\n",
+		verr.position, verr.normal, verr.tangent, verr.texcoord);
+
+	// Create index buffer on device
+	HRESULT ihr = create_index_buffer(index_data, nbr_indices, index_size);
 
-	for (auto& dc : mesh->drawcalls)
+	// Go through materials and load textures (if any) to device, all in one batch
+	// through the texture cache so files used before are not loaded again
+	texture_cache_t& texture_cache = texture_cache_t::instance();
+
+	std::vector<std::string> texture_files;
+	std::vector<ID3D11ShaderResourceView**> texture_views;
+	std::vector<bool> texture_linear;
+	for (auto& mtl : materials)
 	{
-		// Append the drawcall indices
-		for (auto& tri : dc.tris)
-			indices.insert(indices.end(), tri.vi, tri.vi + 3);
+		material_constants.push_back(phong_constants(mtl));
+
+		std::pair<const std::string*, ID3D11ShaderResourceView**> maps[] = {
+			{ &mtl.map_Kd, &mtl.map_Kd_TexSRV },
+			{ &mtl.map_Ks, &mtl.map_Ks_TexSRV },
+			{ &mtl.map_d, &mtl.map_d_TexSRV },
+			{ &mtl.map_bump, &mtl.map_bump_TexSRV } };
+		for (auto& map : maps)
+			if (map.first->size())
+			{
+				texture_files.push_back(*map.first);
+				texture_views.push_back(map.second);
+				texture_linear.push_back(map.second == &mtl.map_bump_TexSRV || map.second == &mtl.map_d_TexSRV);
+			}
+	}
+
+	texture_cache.acquire(dxdevice, dxdevice_context, texture_files, texture_views, texture_linear);
+	texture_cache.print_stats();
+
+	if (texture_cache.streaming)
+		compute_material_bounds(vertex_data, index_data, index_size);
+}
 
-		// Create a range
-		size_t i_size = dc.tris.size() * 3;
-		int mtl_index = dc.mtl_index > -1 ? dc.mtl_index : -1;
-		index_ranges.push_back({ i_ofs, i_size, 0, mtl_index });
+void OBJModel_t::compute_material_bounds(const vertex_t* vertices, const void* indices, unsigned index_size)
+{
+	std::vector<vec3f> lo(materials.size(), vec3f(FLT_MAX, FLT_MAX, FLT_MAX)), hi(materials.size(), vec3f(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	std::vector<float> x, y, z;
+	for (auto& irange : index_ranges)
+	{
+		// drawcalls without a material have no textures to stream
+		if (irange.mtl_index < 0)
+			continue;
+
+		// the positions the range draws, gathered into streams for transformed_bounds
+		x.resize(irange.size);
+		y.resize(irange.size);
+		z.resize(irange.size);
+		for (size_t i = 0; i < irange.size; i++)
+		{
+			size_t j = irange.start + i;
+			size_t index = irange.ofs + (index_size == 2 ? ((const unsigned short*)indices)[j] : ((const unsigned*)indices)[j]);
+			const vec3f& p = vertices[index].Pos;
+			x[i] = p.x; y[i] = p.y; z[i] = p.z;
+		}
+		aabb3f box = transformed_bounds(affine3x4f_identity, x.data(), y.data(), z.data(), irange.size);
 
-		i_ofs = indices.size();
+		vec3f& l = lo[irange.mtl_index];
+		vec3f& h = hi[irange.mtl_index];
+		l = vec3f((std::min)(l.x, box.lo.x), (std::min)(l.y, box.lo.y), (std::min)(l.z, box.lo.z));
+		h = vec3f((std::max)(h.x, box.hi.x), (std::max)(h.y, box.hi.y), (std::max)(h.z, box.hi.z));
 	}
 
-	// Vertex array descriptor
-	D3D11_BUFFER_DESC vbufferDesc = { 0.0f };
-	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbufferDesc.CPUAccessFlags = 0;
-	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = mesh->vertices.size()*sizeof(vertex_t);
-	// Data resource
-	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &(mesh->vertices)[0];
-	// Create vertex buffer on device using descriptor & data
-	HRESULT vhr = dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
+	material_bounds.assign(materials.size(), vec4f(0, 0, 0, 0));
+	for (size_t m = 0; m < materials.size(); m++)
+		if (lo[m].x <= hi[m].x)
+			material_bounds[m] = vec4f((lo[m] + hi[m]) * 0.5f, (hi[m] - lo[m]).norm2() * 0.5f);
+}
 
-	// Index array descriptor
-	D3D11_BUFFER_DESC ibufferDesc = { 0.0f };
-	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibufferDesc.CPUAccessFlags = 0;
-	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = indices.size()*sizeof(unsigned);
-	// Data resource
-	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
-	// Create index buffer on device using descriptor & data
-	HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
+void OBJModel_t::request_textures(const affine3x4f& ModelToWorldMatrix, const camera_t& camera, float viewport_height) const
+{
+	texture_cache_t& texture_cache = texture_cache_t::instance();
 
-	// Copy materials from mesh
-	append_materials(mesh->materials);
+	// radii grow with the largest scale of the transform
+	const affine3x4f& M = ModelToWorldMatrix;
+	float scale = sqrtf((std::max)((std::max)(M.col[0].norm2squared(), M.col[1].norm2squared()), M.col[2].norm2squared()));
 
-	// Go through materials and load textures (if any) to device
+	for (size_t m = 0; m < material_bounds.size(); m++)
+	{
+		const vec4f& bounds = material_bounds[m];
+		if (bounds.w <= 0)
+			continue;
+		vec3f center = M.transform_point(bounds.xyz());
+		float pixels = screen_size(center, bounds.w * scale, camera.position, camera.vfov, viewport_height);
+
+		const material_t& mtl = materials[m];
+		for (auto view : { mtl.map_Kd_TexSRV, mtl.map_Ks_TexSRV, mtl.map_d_TexSRV, mtl.map_bump_TexSRV })
+			texture_cache.request(view, pixels);
+	}
+}
 
+OBJModel_t::~OBJModel_t()
+{
+	texture_cache_t& texture_cache = texture_cache_t::instance();
 	for (auto& mtl : materials)
 	{
-		HRESULT hr;
-		std::wstring wstr; // for conversion from string to wstring
-
-		// map_Kd (diffuse texture)
-		//
-		if (mtl.map_Kd.size()) {
-			// Convert the file path string to wstring
-			wstr = std::wstring(mtl.map_Kd.begin(), mtl.map_Kd.end());
-			// Load texture to device and obtain pointers to it
-			hr = DirectX::CreateWICTextureFromFile(dxdevice, dxdevice_context, wstr.c_str(), &mtl.map_Kd_Tex, &mtl.map_Kd_TexSRV);
-			// Say how it went
-			printf("loading texture %s - %s\n", mtl.map_Kd.c_str(), SUCCEEDED(hr) ? "OK" : "FAILED");
-		}
-
-		// Same thing with other textres here such as mtl.map_bump (Bump/Normal texture) etc
-		//
-		// ...
+		texture_cache.release(&mtl.map_Kd_TexSRV);
+		texture_cache.release(&mtl.map_Ks_TexSRV);
+		texture_cache.release(&mtl.map_d_TexSRV);
+		texture_cache.release(&mtl.map_bump_TexSRV);
 	}
-
-	SAFE_DELETE(mesh);
 }
 
 
@@ -195,223 +353,111 @@ void OBJModel_t::render() const
 	dxdevice_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// Bind vertex buffer
-	UINT32 stride = sizeof(vertex_t);
+	UINT32 stride = vertex_format.stride();
 	UINT32 offset = 0;
 	dxdevice_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
 	// Bind index buffer
-	dxdevice_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	dxdevice_context->IASetIndexBuffer(index_buffer, index_format, 0);
 
 	// Iterate drawcalls
+	int bound_mtl_index = -2;	// none yet; -1 is default_mtl
 	for (auto& irange : index_ranges)
 	{
-		// Fetch material
-		const material_t& mtl = materials[irange.mtl_index];
+		// Fetch material; drawcalls without one (mtl_index -1) use default_mtl
+		bool has_mtl = irange.mtl_index >= 0;
+		const material_t& mtl = has_mtl ? materials[irange.mtl_index] : default_mtl;
+
+		// Upload its constants, unless the previous drawcall had the same material
+		if (phong_buffer && irange.mtl_index != bound_mtl_index)
+		{
+			PhongBuffer_t constants = has_mtl ? material_constants[irange.mtl_index] : phong_constants(default_mtl);
+			D3D11_MAPPED_SUBRESOURCE resource;
+			dxdevice_context->Map(phong_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+			memcpy(resource.pData, &constants, sizeof(PhongBuffer_t));
+			dxdevice_context->Unmap(phong_buffer, 0);
+			bound_mtl_index = irange.mtl_index;
+		}
 
-		// Bind textures
-		dxdevice_context->PSSetShaderResources(0, 1, &mtl.map_Kd_TexSRV);
-		// ...other textures here (see material_t)
+		// Bind textures: t0 map_Kd, t1 map_Ks, t2 map_d, t3 map_bump
+		ID3D11ShaderResourceView* views[] = { mtl.map_Kd_TexSRV, mtl.map_Ks_TexSRV, mtl.map_d_TexSRV, mtl.map_bump_TexSRV };
+		dxdevice_context->PSSetShaderResources(0, 4, views);
 
 		// Make the drawcall
-		dxdevice_context->DrawIndexed(irange.size, irange.start, 0);
+		dxdevice_context->DrawIndexed(irange.size, irange.start, irange.ofs);
 	}
 }
 
-Cube::Cube(
-	ID3D11Device* dxdevice,
-	ID3D11DeviceContext* dxdevice_context)
-	: Geometry_t(dxdevice, dxdevice_context)
+namespace
 {
-	// Populate the vertex array with 4 vertices
-	vertex_t v0, v1, v2, v3, v4, v5, v6,
-		v7, v8, v9, v10, v11, v12,
-		v13, v14, v15, v16, v17, v18,
-		v19, v20, v21, v22, v23;
-	//front
-	v0.Pos = { -0.5, -0.5f, 0.5f };
-	v0.Normal = { 0, 0, 1 };
-	v0.TexCoord = { 0, 0 };
-	v1.Pos = { 0.5, -0.5f, 0.5f };
-	v1.Normal = { 0, 0, 1 };
-	v1.TexCoord = { 0, 1 };
-	v2.Pos = { 0.5, 0.5f, 0.5f };
-	v2.Normal = { 0, 0, 1 };
-	v2.TexCoord = { 1, 1 };
-	v3.Pos = { -0.5, 0.5f, 0.5f };
-	v3.Normal = { 0, 0, 1 };
-	v3.TexCoord = { 1, 0 };
-	//back
-	v4.Pos = { -0.5, -0.5f, -0.5f };
-	v4.Normal = { 0, 0, -1 };
-	v4.TexCoord = { 0, 0 };
-	v5.Pos = { 0.5, -0.5f, -0.5f };
-	v5.Normal = { 0, 0, -1 };
-	v5.TexCoord = { 0, 1 };
-	v6.Pos = { 0.5, 0.5f, -0.5f };
-	v6.Normal = { 0, 0, -1 };
-	v6.TexCoord = { 1, 1 };
-	v7.Pos = { -0.5, 0.5f, -0.5f };
-	v7.Normal = { 0, 0, -1 };
-	v7.TexCoord = { 1, 0 };
-	//right side
-	v8.Pos = { 0.5, -0.5f, 0.5f };
-	v8.Normal = { 1, 0, 0 };
-	v8.TexCoord = { 0, 0 };
-	v9.Pos = { 0.5, -0.5f, -0.5f };
-	v9.Normal = { 1, 0, 0 };
-	v9.TexCoord = { 0, 1 };
-	v10.Pos = { 0.5, 0.5f, -0.5f };
-	v10.Normal = { 1, 0, 0 };
-	v10.TexCoord = { 1, 1 };
-	v11.Pos = { 0.5, 0.5f, 0.5f };
-	v11.Normal = { 1, 0, 0 };
-	v11.TexCoord = { 1, 0 };
-	//left side
-	v12.Pos = { -0.5, -0.5f, -0.5f };
-	v12.Normal = { -1, 0, 0 };
-	v12.TexCoord = { 0, 0 };
-	v13.Pos = { -0.5, -0.5f, 0.5f };
-	v13.Normal = { -1, 0, 0 };
-	v13.TexCoord = { 0, 1 };
-	v14.Pos = { -0.5, 0.5f, 0.5f };
-	v14.Normal = { -1, 0, 0 };
-	v14.TexCoord = { 1, 1 };
-	v15.Pos = { -0.5, 0.5f, -0.5f };
-	v15.Normal = { -1, 0, 0 };
-	v15.TexCoord = { 1, 0 };
-	//Upside
-	v16.Pos = { -0.5, 0.5f, 0.5f };
-	v16.Normal = { 0, 1, 0 };
-	v16.TexCoord = { 0, 0 };
-	v17.Pos = { 0.5, 0.5f, 0.5f };
-	v17.Normal = { 0, 1, 0 };
-	v17.TexCoord = { 0, 1 };
-	v18.Pos = { 0.5, 0.5f, -0.5f };
-	v18.Normal = { 0, 1, 0 };
-	v18.TexCoord = { 1, 1 };
-	v19.Pos = { -0.5, 0.5f, -0.5f };
-	v19.Normal = { 0, 1, 0 };
-	v19.TexCoord = { 1, 0 };
-	//downside
-	v20.Pos = { -0.5, -0.5f, 0.5f };
-	v20.Normal = { 0, -1, 0 };
-	v20.TexCoord = { 0, 0 };
-	v21.Pos = { 0.5, -0.5f, 0.5f };
-	v21.Normal = { 0, -1, 0 };
-	v21.TexCoord = { 0, 1 };
-	v22.Pos = { 0.5, -0.5f, -0.5f };
-	v22.Normal = { 0, -1, 0 };
-	v22.TexCoord = { 1, 1 };
-	v23.Pos = { -0.5, -0.5f, -0.5f };
-	v23.Normal = { 0, -1, 0 };
-	v23.TexCoord = { 1, 0 };
-
-	vertices.push_back(v0);
-	vertices.push_back(v1);
-	vertices.push_back(v2);
-	vertices.push_back(v3);
-	vertices.push_back(v4);
-	vertices.push_back(v5);
-	vertices.push_back(v6);
-	vertices.push_back(v7);
-	vertices.push_back(v8);
-	vertices.push_back(v9);
-	vertices.push_back(v10);
-	vertices.push_back(v11);
-	vertices.push_back(v12);
-	vertices.push_back(v13);
-	vertices.push_back(v14);
-	vertices.push_back(v15);
-	vertices.push_back(v16);
-	vertices.push_back(v17);
-	vertices.push_back(v18);
-	vertices.push_back(v19);
-	vertices.push_back(v20);
-	vertices.push_back(v21);
-	vertices.push_back(v22);
-	vertices.push_back(v23);
-
-
-	// Populate the index array with two triangles
-	// Triangle #1
-	indices.push_back(0);
-	indices.push_back(1);
-	indices.push_back(3);
-	// Triangle #2
-	indices.push_back(1);
-	indices.push_back(2);
-	indices.push_back(3);
-	// Triangle #3
-	indices.push_back(7);
-	indices.push_back(5);
-	indices.push_back(4);
-	// Triangle #4
-	indices.push_back(7);
-	indices.push_back(6);
-	indices.push_back(5);
-	// Triangle #5
-	indices.push_back(8);
-	indices.push_back(9);
-	indices.push_back(11);
-	// Triangle #6
-	indices.push_back(9);
-	indices.push_back(10);
-	indices.push_back(11);
-	//Triangle #7
-	indices.push_back(12);
-	indices.push_back(13);
-	indices.push_back(15);
-	// Triangle #8
-	indices.push_back(13);
-	indices.push_back(14);
-	indices.push_back(15);
-	// Triangle #9
-	indices.push_back(16);
-	indices.push_back(17);
-	indices.push_back(19);
-	// Triangle #10
-	indices.push_back(17);
-	indices.push_back(18);
-	indices.push_back(19);
-	// Triangle #11
-	indices.push_back(23);
-	indices.push_back(21);
-	indices.push_back(20);
-	// Triangle #12
-	indices.push_back(23);
-	indices.push_back(22);
-	indices.push_back(21);
-
-	// Vertex array descriptor
-	D3D11_BUFFER_DESC vbufferDesc = { 0.0f };
-	vbufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbufferDesc.CPUAccessFlags = 0;
-	vbufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vbufferDesc.MiscFlags = 0;
-	vbufferDesc.ByteWidth = vertices.size() * sizeof(vertex_t);
-	// Data resource
-	D3D11_SUBRESOURCE_DATA vdata;
-	vdata.pSysMem = &vertices[0];
-	// Create vertex buffer on device using descriptor & data
-	HRESULT vhr = dxdevice->CreateBuffer(&vbufferDesc, &vdata, &vertex_buffer);
+	//
+	// Cube data as compile-time constants, four vertices with their own normal per face
+	//
+	constexpr vertex_t cube_vertex(const vec3f& pos, const vec3f& normal, const vec2f& texcoord)
+	{
+		return vertex_t{ pos, normal, vec3f(), vec3f(), texcoord };
+	}
 
-	//  Index array descriptor
-	D3D11_BUFFER_DESC ibufferDesc = { 0.0f };
-	ibufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibufferDesc.CPUAccessFlags = 0;
-	ibufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibufferDesc.MiscFlags = 0;
-	ibufferDesc.ByteWidth = indices.size() * sizeof(unsigned);
-	// Data resource
-	D3D11_SUBRESOURCE_DATA idata;
-	idata.pSysMem = &indices[0];
-	// Create index buffer on device using descriptor & data
-	HRESULT ihr = dxdevice->CreateBuffer(&ibufferDesc, &idata, &index_buffer);
+	constexpr vertex_t cube_vertices[] =
+	{
+		// front
+		cube_vertex({ -0.5f, -0.5f, 0.5f }, { 0, 0, 1 }, { 0, 0 }),
+		cube_vertex({ 0.5f, -0.5f, 0.5f }, { 0, 0, 1 }, { 0, 1 }),
+		cube_vertex({ 0.5f, 0.5f, 0.5f }, { 0, 0, 1 }, { 1, 1 }),
+		cube_vertex({ -0.5f, 0.5f, 0.5f }, { 0, 0, 1 }, { 1, 0 }),
+		// back
+		cube_vertex({ -0.5f, -0.5f, -0.5f }, { 0, 0, -1 }, { 0, 0 }),
+		cube_vertex({ 0.5f, -0.5f, -0.5f }, { 0, 0, -1 }, { 0, 1 }),
+		cube_vertex({ 0.5f, 0.5f, -0.5f }, { 0, 0, -1 }, { 1, 1 }),
+		cube_vertex({ -0.5f, 0.5f, -0.5f }, { 0, 0, -1 }, { 1, 0 }),
+		// right side
+		cube_vertex({ 0.5f, -0.5f, 0.5f }, { 1, 0, 0 }, { 0, 0 }),
+		cube_vertex({ 0.5f, -0.5f, -0.5f }, { 1, 0, 0 }, { 0, 1 }),
+		cube_vertex({ 0.5f, 0.5f, -0.5f }, { 1, 0, 0 }, { 1, 1 }),
+		cube_vertex({ 0.5f, 0.5f, 0.5f }, { 1, 0, 0 }, { 1, 0 }),
+		// left side
+		cube_vertex({ -0.5f, -0.5f, -0.5f }, { -1, 0, 0 }, { 0, 0 }),
+		cube_vertex({ -0.5f, -0.5f, 0.5f }, { -1, 0, 0 }, { 0, 1 }),
+		cube_vertex({ -0.5f, 0.5f, 0.5f }, { -1, 0, 0 }, { 1, 1 }),
+		cube_vertex({ -0.5f, 0.5f, -0.5f }, { -1, 0, 0 }, { 1, 0 }),
+		// up side
+		cube_vertex({ -0.5f, 0.5f, 0.5f }, { 0, 1, 0 }, { 0, 0 }),
+		cube_vertex({ 0.5f, 0.5f, 0.5f }, { 0, 1, 0 }, { 0, 1 }),
+		cube_vertex({ 0.5f, 0.5f, -0.5f }, { 0, 1, 0 }, { 1, 1 }),
+		cube_vertex({ -0.5f, 0.5f, -0.5f }, { 0, 1, 0 }, { 1, 0 }),
+		// down side
+		cube_vertex({ -0.5f, -0.5f, 0.5f }, { 0, -1, 0 }, { 0, 0 }),
+		cube_vertex({ 0.5f, -0.5f, 0.5f }, { 0, -1, 0 }, { 0, 1 }),
+		cube_vertex({ 0.5f, -0.5f, -0.5f }, { 0, -1, 0 }, { 1, 1 }),
+		cube_vertex({ -0.5f, -0.5f, -0.5f }, { 0, -1, 0 }, { 1, 0 }),
+	};
+
+	// two triangles per face
+	constexpr unsigned short cube_indices[] =
+	{
+		0, 1, 3,	1, 2, 3,		// front
+		7, 5, 4,	7, 6, 5,		// back
+		8, 9, 11,	9, 10, 11,		// right
+		12, 13, 15,	13, 14, 15,		// left
+		16, 17, 19,	17, 18, 19,		// up
+		23, 21, 20,	23, 22, 21,		// down
+	};
+
+	static_assert(sizeof(cube_vertices) / sizeof(vertex_t) == 24, "a cube has 24 vertices");
+	static_assert(cube_vertices[10].Pos == vec3f(0.5f, 0.5f, -0.5f) && cube_vertices[10].Normal == vec3f(1, 0, 0), "right face corner");
+	static_assert(dot(cube_vertices[22].Normal, cube_vertices[22].Pos) == 0.5f, "faces lie on their planes");
+}
 
-	// Local data is now loaded to device so it can be released
-	vertices.clear();
-	nbr_indices = indices.size();
-	indices.clear();
+Cube::Cube(
+	ID3D11Device* dxdevice,
+	ID3D11DeviceContext* dxdevice_context,
+	const vertex_format_t& vertex_format)
+	: Geometry_t(dxdevice, dxdevice_context, vertex_format)
+{
+	// Create vertex and index buffers on device straight from the constant data
+	nbr_indices = sizeof(cube_indices) / sizeof(cube_indices[0]);
+	HRESULT vhr = create_vertex_buffer(cube_vertices, sizeof(cube_vertices) / sizeof(vertex_t));
+	HRESULT ihr = create_index_buffer(cube_indices, nbr_indices, sizeof(cube_indices[0]));
 }
 
 void Cube::render() const
@@ -420,12 +466,12 @@ void Cube::render() const
 	dxdevice_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	// bind our vertex buffer
-	UINT32 stride = sizeof(vertex_t); //  sizeof(float) * 8;
+	UINT32 stride = vertex_format.stride();
 	UINT32 offset = 0;
 	dxdevice_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
 
 	// bind our index buffer
-	dxdevice_context->IASetIndexBuffer(index_buffer, DXGI_FORMAT_R32_UINT, 0);
+	dxdevice_context->IASetIndexBuffer(index_buffer, index_format, 0);
 
 	// make the drawcall
 	dxdevice_context->DrawIndexed(nbr_indices, 0, 0);
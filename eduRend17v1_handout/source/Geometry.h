@@ -15,6 +15,8 @@
 #include "ShaderBuffers.h"
 #include "drawcall.h"
 #include "mesh.h"
+#include "vertex_format.h"
+#include "Camera.h"
 
 using namespace linalg;
 
@@ -28,14 +30,39 @@ protected:
 	// Pointers to the class' vertex & index arrays
 	ID3D11Buffer* vertex_buffer = nullptr;
 	ID3D11Buffer* index_buffer = nullptr;
+	DXGI_FORMAT index_format = DXGI_FORMAT_R32_UINT;
+
+	// Layout of the vertex buffer, and how to decode its positions
+	const vertex_format_t vertex_format;
+	vertex_decode_t vertex_decode;
+
+	//
+	// Encode vertices to vertex_format and create the vertex buffer; optionally measure
+	// the encoding error
+	//
+	HRESULT create_vertex_buffer(	const vertex_t* vertices,
+									size_t nbr_vertices,
+									vertex_encoding_error_t* error = nullptr);
+
+	//
+	// Create the index buffer from 16-bit (index_size 2) or 32-bit indices
+	//
+	HRESULT create_index_buffer(const void* indices, size_t nbr_indices, unsigned index_size);
+
+	//
+	// Create the index buffer, with 16-bit indices if they all fit
+	//
+	HRESULT create_index_buffer(const std::vector<unsigned>& indices);
 
 public:
 
 	Geometry_t(
 		ID3D11Device* dxdevice, 
-		ID3D11DeviceContext* dxdevice_context) 
+		ID3D11DeviceContext* dxdevice_context,
+		const vertex_format_t& vertex_format = vertex_format_t::full()) 
 		:	dxdevice(dxdevice),
-			dxdevice_context(dxdevice_context)
+			dxdevice_context(dxdevice_context),
+			vertex_format(vertex_format)
 	{ }
 
 	//
@@ -47,6 +74,15 @@ public:
 		mat4f WorldToViewMatrix,
 		mat4f ProjectionMatrix);
 
+	//
+	// Same, from affine transforms, which are expanded to 4x4 for the shaders
+	//
+	void MapMatrixBuffers(
+		ID3D11Buffer* matrix_buffer,
+		const affine3x4f& ModelToWorldMatrix,
+		const affine3x4f& WorldToViewMatrix,
+		const mat4f& ProjectionMatrix);
+
 	//
 	// Abstract render method: must be implemented by derived classes
 	//
@@ -73,7 +109,8 @@ public:
 
 	Quad_t(
 		ID3D11Device* dx3ddevice,
-		ID3D11DeviceContext* dx3ddevice_context);
+		ID3D11DeviceContext* dx3ddevice_context,
+		const vertex_format_t& vertex_format = vertex_format_t::full());
 
 	virtual void render() const;
 
@@ -82,16 +119,14 @@ public:
 
 class Cube : public Geometry_t
 {
-	// our local vertex and index arrays
-	std::vector<vertex_t> vertices;
-	std::vector<unsigned> indices;
 	unsigned nbr_indices = 0;
 
 public:
 
 	Cube(
 		ID3D11Device* dx3ddevice,
-		ID3D11DeviceContext* dx3ddevice_context);
+		ID3D11DeviceContext* dx3ddevice_context,
+		const vertex_format_t& vertex_format = vertex_format_t::full());
 
 	virtual void render() const;
 
@@ -101,17 +136,19 @@ public:
 class OBJModel_t : public Geometry_t
 {
 	// index ranges, representing drawcalls, within an index array
-	struct index_range_t
-	{
-		size_t start;
-		size_t size;
-		unsigned ofs;
-		int mtl_index;
-	};
-
 	std::vector<index_range_t> index_ranges;
 	std::vector<material_t> materials;
 
+	// constants of each material, uploaded as they are per drawcall
+	std::vector<PhongBuffer_t> material_constants;
+	ID3D11Buffer* phong_buffer = nullptr;
+
+	// bounding sphere of the triangles of each material (xyz center, w radius), in model
+	// space; radius 0 for unused materials
+	std::vector<vec4f> material_bounds;
+
+	void compute_material_bounds(const vertex_t* vertices, const void* indices, unsigned index_size);
+
 	void append_materials(const std::vector<material_t>& mtl_vec)
 	{
 		materials.insert(materials.end(), mtl_vec.begin(), mtl_vec.end());
@@ -122,11 +159,24 @@ public:
 	OBJModel_t(
 		const std::string& objfile,
 		ID3D11Device* dxdevice,
-		ID3D11DeviceContext* dxdevice_context);
+		ID3D11DeviceContext* dxdevice_context,
+		const vertex_format_t& vertex_format = vertex_format_t::full());
+
+	//
+	// Buffer for the material constants of each drawcall (PhongBuffer_t); without one,
+	// drawcalls use what the buffer currently holds
+	//
+	void set_phong_buffer(ID3D11Buffer* buffer) { phong_buffer = buffer; }
+
+	//
+	// Requests this frame's resolution of the model's textures from the texture cache,
+	// from the screen size of each material seen from the camera (texture_cache_t::request)
+	//
+	void request_textures(const affine3x4f& ModelToWorldMatrix, const camera_t& camera, float viewport_height) const;
 
 	virtual void render() const;
 
-	~OBJModel_t() { }
+	~OBJModel_t();
 };
 
 #endif
\ No newline at end of file
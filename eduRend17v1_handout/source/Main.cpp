@@ -7,6 +7,11 @@
 #include "InputHandler.h"
 #include "Camera.h"
 #include "Geometry.h"
+#include "texture_cache.h"
+#include "texture_bake.h"
+#include "texture_mips.h"
+#include "texture_residency.h"
+#include "vec/transform_batch.h"
 
 //--------------------------------------------------------------------------------------
 // Global Variables
@@ -23,6 +28,9 @@ ID3D11DeviceContext*	g_DeviceContext			= nullptr;
 ID3D11RasterizerState*	g_RasterState			= nullptr;
 
 ID3D11InputLayout*		g_InputLayout			= nullptr;
+const vertex_format_t	g_VertexFormat			= vertex_format_t::compact();
+const unsigned			g_TextureDecodeThreads	= 0;	// 0 = one per core, 1 = serial
+const size_t			g_TextureBudgetMB		= 0;	// device memory for streamed textures, 0 = load whole
 ID3D11VertexShader*		g_VertexShader			= nullptr;
 ID3D11PixelShader*		g_PixelShader			= nullptr;
 
@@ -61,16 +69,17 @@ OBJModel_t* hand;
 // Object model-to-world transformation matrices
 float angle = 0;			// A per-frame updated rotation angle (radians)...
 float angle_vel = fPI / 2;	// ...and its velocity
-// World-to-view matrix
-mat4f Mview;
+// World-to-view transform
+affine3x4f Mview;
 // Projection matrix
 mat4f Mproj;
 
-mat4f Mcube;
-mat4f Mderivedcube;
-mat4f Mderivedchildcube;
-mat4f Mhand;
-mat4f Msun;
+// Model transforms are affine: composing and inverting them is cheaper than with mat4f
+affine3x4f Mcube;
+affine3x4f Mderivedcube;
+affine3x4f Mderivedchildcube;
+affine3x4f Mhand;
+affine3x4f Msun;
 
 float camera_vel = 5.0f;	// Camera movement velocity in units/s
 vec4f lightposition;
@@ -92,11 +101,105 @@ void initObjects()
 	camera->moveTo({ 0, 0, 25 });
 
 	// Create objects
-	cube = new Cube(g_Device, g_DeviceContext);
-	cube_child = new Cube(g_Device, g_DeviceContext);
-	cube_grandchild = new Cube(g_Device, g_DeviceContext);
-	sun = new OBJModel_t("C:/Users/hampz/Desktop/assets/sphere/sphere.obj", g_Device, g_DeviceContext);
-	hand = new OBJModel_t("C:/Users/hampz/Desktop/assets/hand/hand.obj", g_Device, g_DeviceContext);
+	texture_cache_t& texture_cache = texture_cache_t::instance();
+	texture_cache.decode_threads = g_TextureDecodeThreads;
+	texture_cache.streaming = g_TextureBudgetMB > 0;
+	texture_cache.residency.budget = g_TextureBudgetMB << 20;
+	cube = new Cube(g_Device, g_DeviceContext, g_VertexFormat);
+	cube_child = new Cube(g_Device, g_DeviceContext, g_VertexFormat);
+	cube_grandchild = new Cube(g_Device, g_DeviceContext, g_VertexFormat);
+	sun = new OBJModel_t("C:/Users/hampz/Desktop/assets/sphere/sphere.obj", g_Device, g_DeviceContext, g_VertexFormat);
+	hand = new OBJModel_t("C:/Users/hampz/Desktop/assets/hand/hand.obj", g_Device, g_DeviceContext, g_VertexFormat);
+	sun->set_phong_buffer(g_Phong_Buffer);
+	hand->set_phong_buffer(g_Phong_Buffer);
+}
+
+//
+// Offline texture baking: "-bake model.obj ..." writes the baked DDS files of the
+// textures of each model (texture_bake.h), which OBJModel_t then loads instead
+//
+int BakeTextures(LPWSTR cmdLine)
+{
+	int argc = 0;
+	LPWSTR* argv = CommandLineToArgvW(cmdLine, &argc);
+	size_t failed = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::wstring wstr(argv[i]);
+		std::string objfile(wstr.begin(), wstr.end());
+		try
+		{
+			mesh_t mesh;
+			mesh.load_obj(objfile);
+			failed += bake_textures(mesh.materials);
+		}
+		catch (std::runtime_error& e)
+		{
+			printf("%s\n", e.what());
+			failed++;
+		}
+	}
+	LocalFree(argv);
+
+	printf("Baking done, %d failed\n", (int)failed);
+	return failed ? 1 : 0;
+}
+
+//
+// "-mipbench dir ...": times the mip generators on all files in the directories
+//
+int BenchmarkMips(LPWSTR cmdLine)
+{
+	int argc = 0;
+	LPWSTR* argv = CommandLineToArgvW(cmdLine, &argc);
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::wstring wstr(argv[i]);
+		std::string dir(wstr.begin(), wstr.end());
+
+		WIN32_FIND_DATAA data;
+		HANDLE find = FindFirstFileA((dir + "/*").c_str(), &data);
+		if (find == INVALID_HANDLE_VALUE)
+			continue;
+		do
+		{
+			if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				files.push_back(dir + "/" + data.cFileName);
+		} while (FindNextFileA(find, &data));
+		FindClose(find);
+	}
+	LocalFree(argv);
+
+	benchmark_mips(files);
+	return 0;
+}
+
+//
+// "-residencybench": runs the texture streaming manager through a synthetic scene
+// without a GPU (texture_residency.h); fails if it breaks its budget or upload limit,
+// or keeps changing levels once the camera stops
+//
+int BenchmarkResidency()
+{
+	bool ok = benchmark_residency();
+	ok = benchmark_residency(40, 8 << 20, 1 << 20) && ok;
+	return ok ? 0 : 1;
+}
+
+//
+// "-matbench": times the SIMD mat4f operations against the scalar ones, affine3x4f
+// against mat4f (vec/mat_simd.h), and the batch transforms against per-element loops
+// (vec/transform_batch.h)
+//
+int BenchmarkMatrices()
+{
+	linalg::benchmark_mat4();
+	linalg::benchmark_affine();
+	linalg::benchmark_transform_batch();
+	return 0;
 }
 
 void SendLightBufferToPS(ID3D11Buffer* tempBuff, float4 col, float4 lightpos, float4 camerapos) {
@@ -113,11 +216,8 @@ void SendLightBufferToPS(ID3D11Buffer* tempBuff, float4 col, float4 lightpos, fl
 void SendPhongBufferToPS(ID3D11Buffer* tempBuff, float4 amb_color, float4 diffuse_color, float4 spec_color, float shine) {
 	D3D11_MAPPED_SUBRESOURCE resource;
 	g_DeviceContext->Map(tempBuff, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
-	PhongBuffer_t* buffer = (PhongBuffer_t*)resource.pData;
-	buffer->ambient_color = amb_color;
-	buffer->diffuse_color = diffuse_color;
-	buffer->specular_color = spec_color;
-	//buffer->shine = shine;
+	PhongBuffer_t phong = { amb_color, diffuse_color, float4(spec_color.xyz(), shine) };
+	memcpy(resource.pData, &phong, sizeof(PhongBuffer_t));
 	g_DeviceContext->Unmap(tempBuff, 0);
 }
 
@@ -159,22 +259,24 @@ void updateObjects(float dt)
 	// Now set/update object transformations
 	// This can be done using any sequence of transformation matrices,
 	// but the T*R*S order is most common; i.e. scale, then rotate, and then translate.
-	// If no transformation is desired, an identity matrix can be obtained 
-	// via e.g. Mquad = linalg::mat4f_identity; 
+	// If no transformation is desired, an identity transform can be obtained 
+	// via e.g. Mquad = affine3x4f::identity(); 
+	// affine3x4f::TRS(t, q, s) builds T*R*S directly from a rotation quaternion q,
+	// without the products
+
+	// Rotate continuously around the y- and x-axes
+	quatf spin_y = quatf::rotation(-angle, 0.0f, 1.0f, 0.0f);
+	quatf spin_x = quatf::rotation(-angle, 1.0f, 0.0f, 0.0f);
 
 	// Cube
-	Mcube = mat4f::translation(0, 7, 0) *					// No translation
-		mat4f::rotation(-angle, 0.0f, 1.0f, 0.0f) *		// Rotate continuously around the y-axis
-		mat4f::scaling(1.5, 1.5, 1.5);					// Scale uniformly to 150%
+	Mcube = affine3x4f::TRS({ 0, 7, 0 }, spin_y, { 1.5f, 1.5f, 1.5f });	// Scale uniformly to 150%
 	
-	Mderivedcube = Mcube * (mat4f::translation(2, 2, 0)* mat4f::rotation(-angle, 1.0f, 0.0f, 0)*mat4f::scaling(1.5, 1.5, 1.5));
-	Mderivedchildcube = Mderivedcube* (mat4f::translation(2, 2, 0)* mat4f::rotation(-angle, 0, 1.0f, 0)*mat4f::scaling(1.5, 1.5, 1.5));
+	Mderivedcube = Mcube * affine3x4f::TRS({ 2, 2, 0 }, spin_x, { 1.5f, 1.5f, 1.5f });
+	Mderivedchildcube = Mderivedcube * affine3x4f::TRS({ 2, 2, 0 }, spin_y, { 1.5f, 1.5f, 1.5f });
 
 	//SUN & HAND
-	Msun = mat4f::translation(lightposition.x, lightposition.y, lightposition.z);
-	Mhand = mat4f::translation(0, -5, 0) *
-		mat4f::rotation(0.0f, 0.0f, 1.0f, 0.0f) *
-		mat4f::scaling(15, 15, 15);
+	Msun = affine3x4f::translation(lightposition.x, lightposition.y, lightposition.z);
+	Mhand = affine3x4f::TRS({ 0, -5, 0 }, quatf_identity, { 15, 15, 15 });
 	
 	// Increase the rotation angle. dt is the frame time step.
 	angle += angle_vel * dt;
@@ -186,8 +288,19 @@ void updateObjects(float dt)
 void renderObjects()
 {
 	// Obtain the matrices needed for rendering from the camera
-	Mview = camera->get_WorldToViewMatrix();
+	Mview = camera->get_WorldToViewTransform();
 	Mproj = camera->get_ProjectionMatrix();
+
+	// Raise or lower the resolution of streamed textures to what this view needs
+	texture_cache_t& texture_cache = texture_cache_t::instance();
+	if (texture_cache.streaming)
+	{
+		texture_cache.begin_frame();
+		hand->request_textures(Mhand, *camera, (float)height);
+		sun->request_textures(Msun, *camera, (float)height);
+		texture_cache.stream(g_Device);
+	}
+
 	// CUBE
 	cube->MapMatrixBuffers(g_MatrixBuffer, Mcube, Mview, Mproj);
 	cube->render();
@@ -221,6 +334,11 @@ void releaseObjects()
 //--------------------------------------------------------------------------------------
 int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow )
 {
+	// for measuring the time to the first frame
+	__int64 startTimeStamp = 0;
+	QueryPerformanceCounter((LARGE_INTEGER*)&startTimeStamp);
+	bool firstFrame = true;
+
 	// load console and redirect some I/O to it
 	// note: this has to be done before the win32 window is initialized, or DirectInput will fail miserably
 #ifdef USECONSOLE
@@ -230,6 +348,15 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 	freopen("conout$", "w", stderr);
 #endif
 
+	if (wcsncmp(lpCmdLine, L"-bake", 5) == 0)
+		return BakeTextures(lpCmdLine);
+	if (wcsncmp(lpCmdLine, L"-mipbench", 9) == 0)
+		return BenchmarkMips(lpCmdLine);
+	if (wcsncmp(lpCmdLine, L"-residencybench", 15) == 0)
+		return BenchmarkResidency();
+	if (wcsncmp(lpCmdLine, L"-matbench", 9) == 0)
+		return BenchmarkMatrices();
+
 	// init the win32 window
 	if( FAILED( InitWindow( hInstance, nCmdShow ) ) )
 		return 0;
@@ -299,6 +426,15 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
 			Update(dt);
 			Render(dt);
 
+			if (firstFrame)
+			{
+				__int64 frameTimeStamp = 0;
+				QueryPerformanceCounter((LARGE_INTEGER*)&frameTimeStamp);
+				printf("First frame after %.1f ms (%u texture decode threads, 0 = one per core)\n",
+					(frameTimeStamp - startTimeStamp) * secsPerCnt * 1000.0f, g_TextureDecodeThreads);
+				firstFrame = false;
+			}
+
 			prevTimeStamp = currTimeStamp;
 		}
 	}
@@ -408,7 +544,8 @@ HRESULT CreateShadersAndInputLayout()
 
 	printf("\nCompiling vertex shader...\n");
 	ID3DBlob* pVertexShader = nullptr;
-	if(SUCCEEDED(hr = CompileShader("../../assets/shaders/DrawTri.vs", "VS_main", "vs_5_0", nullptr, &pVertexShader)))
+	std::vector<D3D_SHADER_MACRO> vertexDefines = g_VertexFormat.shader_defines();
+	if(SUCCEEDED(hr = CompileShader("../../assets/shaders/DrawTri.vs", "VS_main", "vs_5_0", vertexDefines.data(), &pVertexShader)))
 	{
 		if(SUCCEEDED(hr = g_Device->CreateVertexShader(
 			pVertexShader->GetBufferPointer(),
@@ -416,17 +553,12 @@ HRESULT CreateShadersAndInputLayout()
 			nullptr,
 			&g_VertexShader)))
 		{
-			D3D11_INPUT_ELEMENT_DESC inputDesc[] = {
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "BINORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-				{ "TEX", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 48, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
+			// Input layout matching the vertex format
+			std::vector<D3D11_INPUT_ELEMENT_DESC> inputDesc = g_VertexFormat.input_layout();
 
 			hr = g_Device->CreateInputLayout(
-						inputDesc,
-						ARRAYSIZE(inputDesc),
+						inputDesc.data(),
+						(UINT)inputDesc.size(),
 						pVertexShader->GetBufferPointer(),
 						pVertexShader->GetBufferSize(),
 						&g_InputLayout);
@@ -13,6 +13,8 @@ struct MatrixBuffer_t
 	mat4f ModelToWorldMatrix;
 	mat4f WorldToViewMatrix;
 	mat4f ProjectionMatrix;
+	float4 PosScale;	// vertex_decode_t, w unused
+	float4 PosOffset;
 };
 
 struct PointLightBuffer_t {
@@ -21,11 +23,13 @@ struct PointLightBuffer_t {
 	float4 camera_pos;
 };
 
+//
+// Material constants, laid out as the shaders' PhongBuffer
+//
 struct PhongBuffer_t {
-	float4 ambient_color;
-	float4 diffuse_color;
-	float4 specular_color;
-	//float shine;
+	float4 ambient_color;	// Ka, w unused
+	float4 diffuse_color;	// Kd, w = opacity
+	float4 specular_color;	// Ks, w = specular exponent
 };
 
 #endif
\ No newline at end of file
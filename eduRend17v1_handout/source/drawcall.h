@@ -30,21 +30,25 @@ struct material_t
 {
 	//  Phong color components: ambient, diffuse & specular
     vec3f Ka = {0,0.5,0}, Kd = {0,0.5,0}, Ks = {1,1,1};
+    float Ns = 300;		// Specular exponent
+    float d = 1;		// Opacity ('d', or 1 - 'Tr')
+    int illum = 2;		// Illumination model
     
 	std::string name;		// Material name
 	std::string map_Kd;		// Texture file path
+	std::string map_Ks;		// Texture file path
+	std::string map_d;		// Texture file path
 	std::string map_bump;	// Texture file path
 
-	// Device texture pointers
+	// Device texture views, from the texture cache (texture_cache.h)
 	ID3D11ShaderResourceView*	map_Kd_TexSRV	= nullptr;
-	ID3D11Resource*				map_Kd_Tex		= nullptr;
-	// other map types here ...
+	ID3D11ShaderResourceView*	map_Ks_TexSRV	= nullptr;
+	ID3D11ShaderResourceView*	map_d_TexSRV	= nullptr;
+	ID3D11ShaderResourceView*	map_bump_TexSRV	= nullptr;
 };
 
 static material_t default_mtl = material_t();
 
-typedef std::unordered_map<std::string, material_t> mtl_hash_t;
-
 struct triangle_t 
 { 
 	unsigned vi[3]; 
@@ -57,7 +61,7 @@ struct quad_t_
 
 struct drawcall_t
 {
-    std::string group_name;
+    unsigned group_id = 0;		// interned name, see mesh_t::names
     int mtl_index = -1;
     std::vector<triangle_t> tris;
     std::vector<quad_t_> quads;
@@ -69,4 +73,15 @@ struct drawcall_t
     }
 };
 
+//
+// index range, representing a drawcall, within an index array
+//
+struct index_range_t
+{
+	size_t start;
+	size_t size;
+	unsigned ofs;
+	int mtl_index;
+};
+
 #endif
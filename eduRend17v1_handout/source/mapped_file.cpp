@@ -0,0 +1,120 @@
+//
+//  mapped_file.cpp
+//	read-only memory mapping of a whole file
+//
+
+#include <cstring>
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+mapped_file_t::mapped_file_t(const std::string& filename)
+{
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size))
+		return;
+	length = (size_t)file_size.QuadPart;
+
+	// an empty file cannot be mapped, but is still a valid (empty) range
+	if (!length)
+	{
+		open = true;
+		return;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+		return;
+	mapping_handle = mapping;
+
+	data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	open = data != nullptr;
+}
+
+mapped_file_t::~mapped_file_t()
+{
+	if (data) UnmapViewOfFile(data);
+	if (mapping_handle) CloseHandle((HANDLE)mapping_handle);
+	if (file_handle) CloseHandle((HANDLE)file_handle);
+}
+
+#else
+
+mapped_file_t::mapped_file_t(const std::string& filename)
+{
+	fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+		return;
+	length = (size_t)st.st_size;
+
+	if (!length)
+	{
+		open = true;
+		return;
+	}
+
+	void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED)
+		return;
+	madvise(p, length, MADV_SEQUENTIAL);
+
+	data = (const char*)p;
+	open = true;
+}
+
+mapped_file_t::~mapped_file_t()
+{
+	if (data) munmap((void*)data, length);
+	if (fd >= 0) close(fd);
+}
+
+#endif
+
+//
+// Single-lane variant of xxHash64's round function: reads 8 bytes per step, which keeps
+// hashing a mapped file far below the cost of parsing it.
+//
+uint64_t mapped_file_t::hash_bytes(const void* p, size_t n)
+{
+	const uint64_t k1 = 0x9E3779B185EBCA87ull, k2 = 0xC2B2AE3D27D4EB4Full, k3 = 0x165667B19E3779F9ull;
+	const unsigned char* b = (const unsigned char*)p;
+	uint64_t h = k3 ^ (n * k1);
+
+	for (; n >= 8; n -= 8, b += 8)
+	{
+		uint64_t w;
+		memcpy(&w, b, 8);
+		w *= k2;
+		w = (w << 31) | (w >> 33);
+		h ^= w * k1;
+		h = ((h << 27) | (h >> 37)) * k1 + k3;
+	}
+	for (; n; n--, b++)
+	{
+		h ^= *b * k3;
+		h = ((h << 11) | (h >> 53)) * k1;
+	}
+
+	h ^= h >> 33; h *= k2;
+	h ^= h >> 29; h *= k3;
+	h ^= h >> 32;
+	return h;
+}
@@ -0,0 +1,52 @@
+//
+//  mapped_file.h
+//	read-only memory mapping of a whole file
+//
+
+#pragma once
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstdint>
+
+//
+// Maps a file into the address space for reading. The contents are not
+// null-terminated, so parse them as the range [begin(), end()).
+//
+class mapped_file_t
+{
+	const char* data = nullptr;
+	size_t length = 0;
+	bool open = false;
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#else
+	int fd = -1;
+#endif
+
+public:
+
+	mapped_file_t(const std::string& filename);
+
+	~mapped_file_t();
+
+	mapped_file_t(const mapped_file_t&) = delete;
+	mapped_file_t& operator = (const mapped_file_t&) = delete;
+
+	bool is_open() const { return open; }
+	size_t size() const { return length; }
+	const char* begin() const { return data; }
+	const char* end() const { return data + length; }
+
+	//
+	// 64-bit hash of the file contents, for detecting changed files
+	//
+	uint64_t content_hash() const { return hash_bytes(data, length); }
+
+	static uint64_t hash_bytes(const void* p, size_t n);
+};
+
+#endif
@@ -5,248 +5,569 @@
 //
 
 #include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
 #include "mesh.h"
+#include "mapped_file.h"
 
 using linalg::int3;
 
+//
+// one vertex of an OBJ face: v, v/vt, v//vn or v/vt/vn (absent indices are 0)
+//
+struct face_vertex_t { int v = 0, vt = 0, vn = 0; };
 
-void mesh_t::load_mtl(	std::string path, 
-						std::string filename, 
-						mtl_hash_t &mtl_hash)
+//
+// Parses the vertices of an 'f' record into fv.
+//
+// Returns 3 or 4 (extra vertices of larger polygons are ignored), or 0 if the record
+// is malformed or mixes vertex formats.
+//
+static int parse_face(const char* p, const char* end, face_vertex_t fv[4])
 {
-    std::string fullpath = path+filename;
-    
-    std::ifstream in(fullpath.c_str());
-    if (!in)
-        throw std::runtime_error(std::string("Failed to open ") + fullpath);
-    std::cout << "Opened " << fullpath << "\n";
-    
-    std::string line;
-    material_t *current_mtl = NULL;
-    
-    while (getline(in, line, '\n'))
-    {
-        char str0[1024] = {0}, str1[1024];
-        float a,b,c;
-        
-        if (sscanf(line.c_str(), "newmtl %s", str0) == 1)
-        {
-            // check for duplicate
-            if (mtl_hash.find(str0) != mtl_hash.end() ) printf("Warning: duplicate material '%s'\n", str0);
-            
-            mtl_hash[str0] = material_t();
-            current_mtl = &mtl_hash[str0];
-            current_mtl->name = str0;
-        }
-        else if (!current_mtl)
-        {
-            // no parsed material so can't add any content
-            continue;
-        }
-        else if (sscanf(line.c_str(), "map_Kd %[^\n]", str0) == 1)
-        {
-            // search for the image file and ignore the rest
-            std::string mapfile;
-			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
-                current_mtl->map_Kd = path + mapfile;
-            else
-                throw std::runtime_error(std::string("Error: no allowed format found for 'map_Kd' in material ") + current_mtl->name);
-        }
-        else if (sscanf(line.c_str(), "map_bump %[^\n]", str0) == 1)
-        {
-            // search for the image file and ignore the rest
-            std::string mapfile;
-			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
-                current_mtl->map_bump = path+mapfile;
-            else
-                throw std::runtime_error(std::string("Error: no allowed format found for 'map_bump' in material ") + current_mtl->name);
-        }
-        else if (sscanf(line.c_str(), "bump %[^\n]", str0) == 1)
-        {
-            // search for the image file and ignore the rest
-            std::string mapfile;
-			if (find_filename_from_suffixes(str0, ALLOWED_TEXTURE_SUFFIXES, mapfile))
-                current_mtl->map_bump = path+mapfile;
-            else
-                throw std::runtime_error(std::string("Error: no allowed format found for 'bump' in material ") + current_mtl->name);
-        }
-        else if (sscanf(line.c_str(), "Ka %f %f %f", &a, &b, &c) == 3)
-        {
-            current_mtl->Ka = vec3f(a, b, c);
-        }
-        else if (sscanf(line.c_str(), "Kd %f %f %f", &a, &b, &c) == 3)
-        {
-            current_mtl->Kd = vec3f(a, b, c);
-        }
-        else if (sscanf(line.c_str(), "Ks %f %f %f", &a, &b, &c) == 3)
-        {
-            current_mtl->Ks = vec3f(a, b, c);
-        }
-    }
-    in.close();
+	int n = 0, format = -1;
+
+	for (; n < 4; n++)
+	{
+		face_vertex_t& f = fv[n];
+		if (!parse_int(p, end, f.v))
+			break;
+
+		// 0: v, 1: v/vt, 2: v//vn, 3: v/vt/vn
+		int fmt = 0;
+		if (p < end && *p == '/')
+		{
+			p++;
+			if (p < end && *p == '/')
+			{
+				p++;
+				if (!parse_int(p, end, f.vn)) return 0;
+				fmt = 2;
+			}
+			else
+			{
+				if (!parse_int(p, end, f.vt)) return 0;
+				fmt = 1;
+				if (p < end && *p == '/')
+				{
+					p++;
+					if (!parse_int(p, end, f.vn)) return 0;
+					fmt = 3;
+				}
+			}
+		}
+
+		if (format < 0) format = fmt;
+		else if (fmt != format) return 0;
+	}
+
+	return n >= 3 ? n : 0;
 }
 
-void mesh_t::load_obj(const std::string& filename,
-	bool auto_generate_normals,
-	bool triangulate)
+//
+// Raw OBJ records from one newline-aligned range of the file
+//
+// Chunks are parsed independently, so everything that depends on earlier lines (element
+// counts for relative indices, the active drawcall, group name and skinning vertex offset)
+// is kept as chunk-local state and resolved when the chunks are merged in file order.
+//
+struct obj_chunk_t
 {
-	std::string parentdir = get_parentdir(filename);
+	std::vector<vec3f> vertices, normals;
+	std::vector<vec2f> texcoords;
 
-	std::ifstream in(filename.c_str());
-	if (!in) throw std::runtime_error(std::string("Failed to open ") + filename);
-	std::cout << "Opened " << filename << "\n";
+	// faces before the first usemtl; they belong to the drawcall active when the chunk starts
+	unwelded_drawcall_t head;
+	// drawcalls started in this chunk
+	std::vector<unwelded_drawcall_t> drawcalls;
+	std::vector<bool> local_group, local_v_ofs;
 
-	// raw data from obj
-	std::vector<vec3f> file_vertices, file_normals;
-	std::vector<vec2f> file_texcoords;
-	std::vector<unwelded_drawcall_t> file_drawcalls;
-	mtl_hash_t file_materials;
+	// files referenced by mtllib, in order
+	std::vector<std::string> mtllibs;
 
-	std::string current_group_name;
-	unwelded_drawcall_t default_drawcall;
-	unwelded_drawcall_t* current_drawcall = &default_drawcall;
-	int last_ofs = 0; bool face_section = false; // info for skin weight mapping
+	// material & group names, with ids local to the chunk until the merge
+	string_interner_t names;
+
+	// relative (negative) face indices, stored chunk-local until the merge adds the element offsets
+	struct fixup_t { int drawcall; bool quad; unsigned face, mask; };
+	std::vector<fixup_t> fixups;
+
+	// group & skinning state: -1/false where it is inherited from earlier chunks
+	bool has_group = false, has_usemtl = false, face_section = false;
+	unsigned group_id = 0;
+	int first_v_ofs = -1, last_ofs = -1;
+};
+
+//
+// Converts a 1-based OBJ index to 0-based. Relative indices become chunk-local and set
+// their bit in rel_mask. Absent indices (0) become -1.
+//
+static inline int resolve_index(int i, size_t count, unsigned bit, unsigned& rel_mask)
+{
+	if (i >= 0) return i - 1;
+	rel_mask |= bit;
+	return (int)count + i;
+}
+
+static void parse_obj_chunk(const char* p, const char* end, bool triangulate, obj_chunk_t& chunk)
+{
+	unwelded_drawcall_t* current_drawcall = &chunk.head;
+	int current_drawcall_index = -1;
 
-	std::string line;
-	while (getline(in, line))
+	while (p < end)
 	{
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if (!eol) eol = end;
+
+		const char* tok = skip_blanks(p, eol);
+		const char* tok_end = find_token_end(tok, eol);
+		const char* q = tok_end;
+		p = eol + 1;
+
 		float x, y, z;
-		int a[3], b[3], c[3], d[3];
-		char str[1024];
 
-		// material file
+		if (tok == tok_end || *tok == '#')
+			continue;
+
+		// face
 		//
-		if (sscanf(line.c_str(), "mtllib %s", str) == 1)
+		if (token_equals(tok, tok_end, "f"))
 		{
-			load_mtl(parentdir, str, file_materials);
+			face_vertex_t fv[4];
+			int n = parse_face(q, eol, fv);
+			if (!n)
+				continue;
+
+			// 0-based indices laid out as in unwelded_quad_t: 4x vertex, 4x normal, 4x texel
+			int v[4], vn[4], vt[4];
+			unsigned rel_mask = 0;
+			for (int i = 0; i < n; i++)
+			{
+				v[i] = resolve_index(fv[i].v, chunk.vertices.size(), 1 << i, rel_mask);
+				vn[i] = resolve_index(fv[i].vn, chunk.normals.size(), 1 << (4 + i), rel_mask);
+				vt[i] = resolve_index(fv[i].vt, chunk.texcoords.size(), 1 << (8 + i), rel_mask);
+			}
+
+			if (n == 4 && !triangulate)
+			{
+				current_drawcall->quads.push_back({ v[0], v[1], v[2], v[3], vn[0], vn[1], vn[2], vn[3], vt[0], vt[1], vt[2], vt[3] });
+				if (rel_mask)
+					chunk.fixups.push_back({ current_drawcall_index, true, (unsigned)current_drawcall->quads.size() - 1, rel_mask });
+				continue;
+			}
+
+			// triangle(s): quads are split along the 0-2 diagonal
+			for (int t = 0; t < n - 2; t++)
+			{
+				int a = 0, b = t + 1, c = t + 2;
+				current_drawcall->tris.push_back({ v[a], v[b], v[c], vn[a], vn[b], vn[c], vt[a], vt[b], vt[c] });
+
+				// move the relative-index bits of corners a,b,c into triangle slots 0-8
+				unsigned tri_mask = 0;
+				int corners[3] = { a, b, c };
+				for (int i = 0; i < 3; i++)
+					for (int k = 0; k < 3; k++)
+						if (rel_mask & (1 << (4 * k + corners[i])))
+							tri_mask |= 1 << (3 * k + i);
+				if (tri_mask)
+					chunk.fixups.push_back({ current_drawcall_index, false, (unsigned)current_drawcall->tris.size() - 1, tri_mask });
+			}
 		}
-		// active material
+		// 3D/2D vertex
 		//
-		else if (sscanf(line.c_str(), "usemtl %s", str) == 1)
+		else if (token_equals(tok, tok_end, "v"))
 		{
-			unwelded_drawcall_t udc;
-			udc.mtl_name = str;
-			udc.group_name = current_group_name;
-			udc.v_ofs = last_ofs; face_section = true; // skinning: set current vertex offset and mark beginning of a face-section
-			file_drawcalls.push_back(udc);
-			current_drawcall = &file_drawcalls.back();
-		}
-		else if (sscanf(line.c_str(), "g %s", str) == 1)
-		{
-			current_group_name = str;
+			if (!parse_float(q, eol, x) || !parse_float(q, eol, y))
+				continue;
+
+			if (parse_float(q, eol, z))
+			{
+				// update vertex offset and mark end to a face section
+				if (!chunk.has_usemtl) {
+					if (chunk.first_v_ofs < 0)
+						chunk.first_v_ofs = (int)chunk.vertices.size();
+				}
+				else if (chunk.face_section) {
+					chunk.last_ofs = (int)chunk.vertices.size();
+					chunk.face_section = false;
+				}
+
+				chunk.vertices.push_back(vec3f(x, y, z));
+			}
+			else
+				chunk.vertices.push_back(vec3f(x, y, 0.0f));
 		}
-		// 3D vertex
+		// 2D/3D texel (3D not supported: ignore last component)
 		//
-		else if (sscanf(line.c_str(), "v %f %f %f", &x, &y, &z) == 3)
+		else if (token_equals(tok, tok_end, "vt"))
 		{
-			// update vertex offset and mark end to a face section
-			if (face_section) {
-				last_ofs = file_vertices.size();
-				face_section = false;
-			}
-
-			file_vertices.push_back(vec3f(x, y, z));
+			if (parse_float(q, eol, x) && parse_float(q, eol, y))
+				chunk.texcoords.push_back(vec2f(x, y));
 		}
-		// 2D vertex
+		// normal
 		//
-		else if (sscanf(line.c_str(), "v %f %f", &x, &y) == 2)
+		else if (token_equals(tok, tok_end, "vn"))
 		{
-			file_vertices.push_back(vec3f(x, y, 0.0f));
+			if (parse_float(q, eol, x) && parse_float(q, eol, y) && parse_float(q, eol, z))
+				chunk.normals.push_back(vec3f(x, y, z));
 		}
-		// 3D texel (not supported: ignore last component)
+		// active material
 		//
-		else if (sscanf(line.c_str(), "vt %f %f %f", &x, &y, &z) == 3)
+		else if (token_equals(tok, tok_end, "usemtl"))
 		{
-			file_texcoords.push_back(vec2f(x, y));
+			const char* name = skip_blanks(q, eol);
+			const char* name_end = find_token_end(name, eol);
+			if (name == name_end)
+				continue;
+
+			unwelded_drawcall_t udc;
+			udc.mtl_id = chunk.names.intern(name, name_end);
+			udc.group_id = chunk.group_id;
+			udc.v_ofs = chunk.last_ofs; // skinning: set current vertex offset and mark beginning of a face-section
+			chunk.drawcalls.push_back(udc);
+			chunk.local_group.push_back(chunk.has_group);
+			chunk.local_v_ofs.push_back(chunk.last_ofs >= 0);
+			chunk.has_usemtl = chunk.face_section = true;
+
+			current_drawcall_index = (int)chunk.drawcalls.size() - 1;
+			current_drawcall = &chunk.drawcalls.back();
 		}
-		// 2D texel
-		//
-		else if (sscanf(line.c_str(), "vt %f %f", &x, &y) == 2)
+		else if (token_equals(tok, tok_end, "g"))
 		{
-			file_texcoords.push_back(vec2f(x, y));
+			const char* name = skip_blanks(q, eol);
+			const char* name_end = find_token_end(name, eol);
+			if (name != name_end)
+			{
+				chunk.group_id = chunk.names.intern(name, name_end);
+				chunk.has_group = true;
+			}
 		}
-		// normal
+		// material file
 		//
-		else if (sscanf(line.c_str(), "vn %f %f %f", &x, &y, &z) == 3)
+		else if (token_equals(tok, tok_end, "mtllib"))
 		{
-			file_normals.push_back(vec3f(x, y, z));
+			std::string str;
+			if (parse_token(q, eol, str))
+				chunk.mtllibs.push_back(str);
 		}
-		// face: 4x vertex
+		// unknown obj syntax
 		//
-		else if (sscanf(line.c_str(), "f %d %d %d %d", &a[0], &b[0], &c[0], &d[0]) == 4)
+		else
 		{
-			if (triangulate) {
-				current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, -1, -1, -1, -1, -1, -1 });
-				current_drawcall->tris.push_back({ a[0] - 1, c[0] - 1, d[0] - 1, -1, -1, -1, -1, -1, -1 });
-			}
-			else
-				current_drawcall->quads.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, d[0] - 1, -1, -1, -1, -1, -1, -1, -1, -1 });
+
 		}
-		// face: 3x vertex
-		//
-		else if (sscanf(line.c_str(), "f %d %d %d", &a[0], &b[0], &c[0]) == 3)
+	}
+}
+
+//
+// Open-addressing hash table from (v,vn,vt) index-combos to welded vertex indices
+//
+// Sized up front for a known max number of entries (at most half full), so it never
+// rehashes. Keys are mixed with a murmur3-style finalizer, which spreads combos that
+// share a position index but differ in normal/texel index.
+//
+class index3_table_t
+{
+	struct entry_t { int v, vn, vt; unsigned index; };
+	static const unsigned empty = ~0u;
+
+	std::vector<entry_t> entries;
+	size_t mask;
+
+	static unsigned hash(int v, int vn, int vt)
+	{
+		unsigned h = (unsigned)v * 0x9E3779B1u;
+		h ^= (unsigned)vn * 0x85EBCA77u + (h << 6) + (h >> 2);
+		h ^= (unsigned)vt * 0xC2B2AE3Du + (h << 6) + (h >> 2);
+		h ^= h >> 16; h *= 0x85EBCA6Bu;
+		h ^= h >> 13; h *= 0xC2B2AE35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+public:
+
+	index3_table_t(size_t max_entries)
+	{
+		size_t capacity = 16;
+		while (capacity < 2 * max_entries) capacity *= 2;
+		entries.resize(capacity, { 0, 0, 0, empty });
+		mask = capacity - 1;
+	}
+
+	//
+	// Returns the index stored for the combo, or stores and returns 'index' if it is new
+	//
+	unsigned find_or_insert(int v, int vn, int vt, unsigned index, bool& inserted)
+	{
+		for (size_t i = hash(v, vn, vt) & mask; ; i = (i + 1) & mask)
 		{
-			current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, -1, -1, -1, -1, -1, -1 });
+			entry_t& e = entries[i];
+			if (e.index == empty)
+			{
+				e = { v, vn, vt, index };
+				inserted = true;
+				return index;
+			}
+			if (e.v == v && e.vn == vn && e.vt == vt)
+			{
+				inserted = false;
+				return e.index;
+			}
 		}
-		// face: 4x vertex/texel (triangulate)
-		//
-		else if (sscanf(line.c_str(), "f %d/%d %d/%d %d/%d %d/%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1], &d[0], &d[1]) == 8)
+	}
+};
+
+template<class T>
+static void append(std::vector<T>& dst, std::vector<T>& src)
+{
+	if (dst.empty()) dst.swap(src);
+	else dst.insert(dst.end(), src.begin(), src.end());
+}
+
+
+//
+// Parses in place like the OBJ chunks
+//
+void mesh_t::load_mtl(	const std::string& path,
+						const std::string& filename,
+						mtl_library_t &mtls)
+{
+	std::string fullpath = path+filename;
+
+	mapped_file_t file(fullpath);
+	if (!file.is_open())
+		throw std::runtime_error(std::string("Failed to open ") + fullpath);
+	std::cout << "Opened " << fullpath << "\n";
+
+	material_t *current_mtl = NULL;
+
+	// search for the image file of a map_* record and ignore the rest
+	auto parse_map = [&](const char* p, const char* eol, const char* record, std::string& map)
+	{
+		p = skip_blanks(p, eol);
+		if (p == eol)
+			return;
+		unsigned id = texture_paths.resolve(path, p, eol);
+		if (id != texture_path_cache_t::npos)
+			map = texture_paths.path(id);
+		else
+			throw std::runtime_error(std::string("Error: no allowed format found for '") + record + "' in material " + current_mtl->name);
+	};
+
+	const char* p = file.begin(), *end = file.end();
+	while (p < end)
+	{
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if (!eol) eol = end;
+
+		// records may be indented, as 3ds Max exports them
+		const char* tok = skip_blanks(p, eol);
+		const char* tok_end = find_token_end(tok, eol);
+		const char* q = tok_end;
+		p = eol + 1;
+
+		float a, b, c;
+
+		if (tok == tok_end || *tok == '#')
+			continue;
+
+		if (token_equals(tok, tok_end, "newmtl"))
 		{
-			if (triangulate) {
-				current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, -1, -1, -1, a[1] - 1, b[1] - 1, c[1] - 1 });
-				current_drawcall->tris.push_back({ a[0] - 1, c[0] - 1, d[0] - 1, -1, -1, -1, a[1] - 1, c[1] - 1, d[1] - 1 });
+			const char* name = skip_blanks(q, eol);
+			const char* name_end = find_token_end(name, eol);
+			if (name == name_end)
+				continue;
+
+			unsigned id = names.intern(name, name_end);
+			if (mtls.index.size() <= id)
+				mtls.index.resize(id + 1, -1);
+
+			// check for duplicate
+			if (mtls.index[id] > -1)
+			{
+				printf("Warning: duplicate material '%s'\n", names.name(id).c_str());
+				mtls.materials[mtls.index[id]] = material_t();
 			}
 			else
-				current_drawcall->quads.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, d[0] - 1, -1, -1, -1, -1, a[1] - 1, b[1] - 1, c[1] - 1, d[1] - 1 });
+			{
+				mtls.index[id] = (int)mtls.materials.size();
+				mtls.materials.push_back(material_t());
+			}
+			current_mtl = &mtls.materials[mtls.index[id]];
+			current_mtl->name = names.name(id);
 		}
-		// face: 3x vertex/texel
-		//
-		else if (sscanf(line.c_str(), "f %d/%d %d/%d %d/%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1]) == 6)
+		else if (!current_mtl)
 		{
-			current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, -1, -1, -1, a[1] - 1, b[1] - 1, c[1] - 1 });
+			// no parsed material so can't add any content
+			continue;
 		}
-		// face: 4x vertex//normal (triangulate)
-		//
-		else if (sscanf(line.c_str(), "f %d//%d %d//%d %d//%d %d//%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1], &d[0], &d[1]) == 8)
+		else if (token_equals(tok, tok_end, "map_Kd"))
+			parse_map(q, eol, "map_Kd", current_mtl->map_Kd);
+		else if (token_equals(tok, tok_end, "map_Ks"))
+			parse_map(q, eol, "map_Ks", current_mtl->map_Ks);
+		else if (token_equals(tok, tok_end, "map_d"))
+			parse_map(q, eol, "map_d", current_mtl->map_d);
+		else if (token_equals(tok, tok_end, "map_bump"))
+			parse_map(q, eol, "map_bump", current_mtl->map_bump);
+		else if (token_equals(tok, tok_end, "bump"))
+			parse_map(q, eol, "bump", current_mtl->map_bump);
+		else if (token_equals(tok, tok_end, "Ka"))
 		{
-			if (triangulate) {
-				current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, a[1] - 1, b[1] - 1, c[1] - 1, -1, -1, -1 });
-				current_drawcall->tris.push_back({ a[0] - 1, c[0] - 1, d[0] - 1, a[1] - 1, c[1] - 1, d[1] - 1, -1, -1, -1 });
-			}
-			else
-				current_drawcall->quads.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, d[0] - 1, a[2] - 1, b[2] - 1, c[2] - 1, d[2] - 1, -1, -1, -1, -1 });
+			if (parse_float(q, eol, a) && parse_float(q, eol, b) && parse_float(q, eol, c))
+				current_mtl->Ka = vec3f(a, b, c);
 		}
-		// face: 3x vertex//normal
-		//
-		else if (sscanf(line.c_str(), "f %d//%d %d//%d %d//%d", &a[0], &a[1], &b[0], &b[1], &c[0], &c[1]) == 6)
+		else if (token_equals(tok, tok_end, "Kd"))
 		{
-			current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, a[1] - 1, b[1] - 1, c[1] - 1, -1, -1, -1 });
+			if (parse_float(q, eol, a) && parse_float(q, eol, b) && parse_float(q, eol, c))
+				current_mtl->Kd = vec3f(a, b, c);
 		}
-		// face: 4x vertex/texel/normal (triangulate)
-		//
-		else if (sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d", &a[0], &a[1], &a[2], &b[0], &b[1], &b[2], &c[0], &c[1], &c[2], &d[0], &d[1], &d[2]) == 12)
+		else if (token_equals(tok, tok_end, "Ks"))
 		{
-			if (triangulate) {
-				current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, a[2] - 1, b[2] - 1, c[2] - 1, a[1] - 1, b[1] - 1, c[1] - 1 });
-				current_drawcall->tris.push_back({ a[0] - 1, c[0] - 1, d[0] - 1, a[2] - 1, c[2] - 1, d[2] - 1, a[1] - 1, c[1] - 1, d[1] - 1 });
-			}
-			else
-				current_drawcall->quads.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, d[0] - 1, a[2] - 1, b[2] - 1, c[2] - 1, d[2] - 1, a[1] - 1, b[1] - 1, c[1] - 1, d[1] - 1 });
+			if (parse_float(q, eol, a) && parse_float(q, eol, b) && parse_float(q, eol, c))
+				current_mtl->Ks = vec3f(a, b, c);
 		}
-		// face: 3x vertex/texel/normal
-		//
-		else if (sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", &a[0], &a[1], &a[2], &b[0], &b[1], &b[2], &c[0], &c[1], &c[2]) == 9)
+		else if (token_equals(tok, tok_end, "Ns"))
+			parse_float(q, eol, current_mtl->Ns);
+		else if (token_equals(tok, tok_end, "d"))
+			parse_float(q, eol, current_mtl->d);
+		else if (token_equals(tok, tok_end, "Tr"))
 		{
-			current_drawcall->tris.push_back({ a[0] - 1, b[0] - 1, c[0] - 1, a[2] - 1, b[2] - 1, c[2] - 1, a[1] - 1, b[1] - 1, c[1] - 1 });
+			if (parse_float(q, eol, a))
+				current_mtl->d = 1.0f - a;
 		}
-		// unknown obj syntax
-		//
+		else if (token_equals(tok, tok_end, "illum"))
+			parse_int(q, eol, current_mtl->illum);
+	}
+}
+
+void mesh_t::load_obj(const std::string& filename,
+	bool auto_generate_normals,
+	bool triangulate,
+	bool weld_across_drawcalls,
+	unsigned nbr_threads)
+{
+	std::string parentdir = get_parentdir(filename);
+
+	mapped_file_t file(filename);
+	if (!file.is_open()) throw std::runtime_error(std::string("Failed to open ") + filename);
+	std::cout << "Opened " << filename << "\n";
+	source_files.push_back(filename);
+
+	auto parse_start = std::chrono::high_resolution_clock::now();
+
+	// split the file at newlines into one chunk per thread,
+	// but don't bother with threads for small files
+	const size_t min_chunk_size = 256 * 1024;
+	if (!nbr_threads)
+		nbr_threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t nbr_chunks = std::max<size_t>(1, std::min<size_t>(nbr_threads, file.size() / min_chunk_size));
+
+	std::vector<obj_chunk_t> chunks(nbr_chunks);
+	std::vector<std::future<void>> workers;
+	const char* chunk_begin = file.begin();
+	for (size_t i = 0; i < nbr_chunks; i++)
+	{
+		const char* chunk_end = file.begin() + file.size() * (i + 1) / nbr_chunks;
+		if (chunk_end < chunk_begin) chunk_end = chunk_begin;
+		const char* eol = (const char*)memchr(chunk_end, '\n', file.end() - chunk_end);
+		chunk_end = (i + 1 == nbr_chunks || !eol) ? file.end() : eol + 1;
+
+		if (i + 1 < nbr_chunks)
+			workers.push_back(std::async(std::launch::async, parse_obj_chunk, chunk_begin, chunk_end, triangulate, std::ref(chunks[i])));
 		else
+			parse_obj_chunk(chunk_begin, chunk_end, triangulate, chunks[i]);
+
+		chunk_begin = chunk_end;
+	}
+	for (auto& w : workers)
+		w.get();
+
+	// raw data from obj
+	std::vector<vec3f> file_vertices, file_normals;
+	std::vector<vec2f> file_texcoords;
+	std::vector<unwelded_drawcall_t> file_drawcalls;
+	mtl_library_t file_materials;
+
+	size_t total_v = 0, total_vn = 0, total_vt = 0;
+	for (auto& c : chunks) {
+		total_v += c.vertices.size(); total_vn += c.normals.size(); total_vt += c.texcoords.size();
+	}
+	file_vertices.reserve(total_v);
+	file_normals.reserve(total_vn);
+	file_texcoords.reserve(total_vt);
+
+	// merge chunks in file order
+	//
+	unsigned current_group_id = 0;
+	unwelded_drawcall_t default_drawcall;
+	int current_drawcall = -1;
+	int last_ofs = 0; bool face_section = false; // info for skin weight mapping
+
+	for (auto& c : chunks)
+	{
+		int v_base = (int)file_vertices.size(), vn_base = (int)file_normals.size(), vt_base = (int)file_texcoords.size();
+
+		// relative indices
+		for (auto& f : c.fixups)
+		{
+			unwelded_drawcall_t& dc = f.drawcall < 0 ? c.head : c.drawcalls[f.drawcall];
+			int* vi = f.quad ? dc.quads[f.face].vi : dc.tris[f.face].vi;
+			int n = f.quad ? 4 : 3;
+			for (int k = 0; k < 3 * n; k++)
+				if (f.mask & (1 << k))
+					vi[k] += k < n ? v_base : (k < 2 * n ? vn_base : vt_base);
+		}
+
+		// chunk-local name ids to mesh ids
+		std::vector<unsigned> name_ids(c.names.size());
+		for (unsigned id = 0; id < c.names.size(); id++)
+			name_ids[id] = names.intern(c.names.name(id));
+
+		for (auto& mtllib : c.mtllibs)
 		{
+			load_mtl(parentdir, mtllib, file_materials);
+			source_files.push_back(parentdir + mtllib);
+		}
 
+		// skinning: first vertex after a usemtl in an earlier chunk
+		if (face_section && c.first_v_ofs >= 0) {
+			last_ofs = v_base + c.first_v_ofs;
+			face_section = false;
 		}
+
+		unwelded_drawcall_t& head_drawcall = current_drawcall < 0 ? default_drawcall : file_drawcalls[current_drawcall];
+		append(head_drawcall.tris, c.head.tris);
+		append(head_drawcall.quads, c.head.quads);
+
+		for (size_t i = 0; i < c.drawcalls.size(); i++)
+		{
+			unwelded_drawcall_t& udc = c.drawcalls[i];
+			udc.mtl_id = name_ids[udc.mtl_id];
+			udc.group_id = c.local_group[i] ? name_ids[udc.group_id] : current_group_id;
+			udc.v_ofs = c.local_v_ofs[i] ? v_base + udc.v_ofs : last_ofs;
+			file_drawcalls.push_back(std::move(udc));
+		}
+		if (c.drawcalls.size())
+			current_drawcall = (int)file_drawcalls.size() - 1;
+
+		if (c.has_usemtl) {
+			face_section = c.face_section;
+			if (c.last_ofs >= 0) last_ofs = v_base + c.last_ofs;
+		}
+		if (c.has_group)
+			current_group_id = name_ids[c.group_id];
+
+		append(file_vertices, c.vertices);
+		append(file_normals, c.normals);
+		append(file_texcoords, c.texcoords);
 	}
-	in.close();
+	chunks.clear();
+
+	double parse_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - parse_start).count();
+	double parse_mb = file.size() / (1024.0 * 1024.0);
+	printf("Parsed %.2f MB in %.1f ms (%.1f MB/s, %d threads)\n", parse_mb, parse_ms, parse_ms > 0 ? parse_mb / (parse_ms / 1000.0) : 0.0, (int)nbr_chunks);
 
 	// use defualt drawcall if no instance of usemtl
 	if (!file_drawcalls.size())
@@ -262,52 +583,86 @@ void mesh_t::load_obj(const std::string& filename,
 	// auto-generate normals
 	if (!has_normals && auto_generate_normals)
 	{
-		compute_normals(file_vertices, file_normals, file_drawcalls);
+		auto normals_start = std::chrono::high_resolution_clock::now();
+
+		// threads only pay off for large meshes
+		const size_t min_faces_per_thread = 256 * 1024;
+		size_t nbr_faces = 0;
+		for (auto& dc : file_drawcalls)
+			nbr_faces += dc.tris.size() + dc.quads.size();
+		unsigned normal_threads = (unsigned)std::max<size_t>(1, std::min<size_t>(nbr_threads, nbr_faces / min_faces_per_thread));
+
+		compute_normals(file_vertices, file_normals, file_drawcalls, NORMAL_WEIGHT_UNIFORM, normal_threads);
 		has_normals = true;
-		printf("Auto-generated %d normals\n", (int)file_normals.size());
+
+		double normals_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - normals_start).count();
+		printf("Auto-generated %d normals (%.2f ms)\n", (int)file_normals.size(), normals_ms);
 	}
 #endif
 
 #if 1
 	printf("Welding vertex array...");
+	auto weld_start = std::chrono::high_resolution_clock::now();
 
-	std::unordered_map<std::string, unsigned> mtl_to_index_hash;
+	// name id -> index in materials
+	std::vector<int> mtl_to_index(names.size(), -1);
 
-	// hash function for int3
-	struct int3_hashfunction {
-		std::size_t operator () (const int3& i3) const {
-			return i3.x;
-		}
-	};
+	// one table for all drawcalls if vertices are shared between them
+	size_t total_corners = 0;
+	for (auto &dc : file_drawcalls)
+		total_corners += dc.tris.size() * 3 + dc.quads.size() * 4;
+	index3_table_t shared_index3_to_index_hash(weld_across_drawcalls ? total_corners : 0);
+
+	// for stats: last drawcall to use each vertex, and number of vertices reused by another drawcall
+	std::vector<int> vertex_last_drawcall;
+	int shared_vertices = 0;
 
 	for (auto &dc : file_drawcalls)
 	{
 		drawcall_t wdc;
-		wdc.group_name = dc.group_name;
+		wdc.group_id = dc.group_id;
+		int dc_index = (int)drawcalls.size();
 
-		std::unordered_map<int3, unsigned, int3_hashfunction> index3_to_index_hash;
+		index3_table_t local_index3_to_index_hash(weld_across_drawcalls ? 0 : dc.tris.size() * 3 + dc.quads.size() * 4);
+		index3_table_t& index3_to_index_hash = weld_across_drawcalls ? shared_index3_to_index_hash : local_index3_to_index_hash;
+
+		// creates a welded vertex the first time an index-combo is seen
+		auto weld = [&](int v, int vn, int vt) -> unsigned
+		{
+			bool inserted;
+			unsigned index = index3_to_index_hash.find_or_insert(v, vn, vt, (unsigned)vertices.size(), inserted);
+			if (inserted)
+			{
+				vertices.push_back(	file_vertices[v],
+									vn > -1 ? file_normals[vn] : vec3f(0, 0, 0),
+									vt > -1 ? file_texcoords[vt] : vec2f(0, 0));
+				vertex_last_drawcall.push_back(dc_index);
+			}
+			else if (vertex_last_drawcall[index] != dc_index)
+			{
+				vertex_last_drawcall[index] = dc_index;
+				shared_vertices++;
+			}
+			return index;
+		};
 
 		// material
 		//
-		if (dc.mtl_name.size())
+		if (dc.mtl_id)
 		{
 			//
 			// is material added to main vector?
-			auto mtl_index = mtl_to_index_hash.find(dc.mtl_name);
-			if (mtl_index == mtl_to_index_hash.end())
+			if (mtl_to_index[dc.mtl_id] < 0)
 			{
-				auto mtl = file_materials.find(dc.mtl_name);
-
-				if (mtl == file_materials.end())
-					throw std::runtime_error(std::string("Error: used material ") + dc.mtl_name + " not found\n");
+				const material_t* mtl = file_materials.find(dc.mtl_id);
 
-				wdc.mtl_index = (unsigned)materials.size();
-				mtl_to_index_hash[dc.mtl_name] = (unsigned)materials.size();
+				if (!mtl)
+					throw std::runtime_error(std::string("Error: used material ") + names.name(dc.mtl_id) + " not found\n");
 
-				materials.push_back(mtl->second);
+				mtl_to_index[dc.mtl_id] = (int)materials.size();
+				materials.push_back(*mtl);
 			}
-			else
-				wdc.mtl_index = mtl_index->second;;
+			wdc.mtl_index = mtl_to_index[dc.mtl_id];
 		}
 		else
 			// mtl string is empty, use empty index
@@ -315,75 +670,28 @@ void mesh_t::load_obj(const std::string& filename,
 
 		// weld vertices from triangles
 		//
-		for (auto &tri : dc.tris)
+		wdc.tris.resize(dc.tris.size());
+		for (size_t t = 0; t < dc.tris.size(); t++)
 		{
-			triangle_t wtri;
-
+			const unwelded_triangle_t& tri = dc.tris[t];
 			for (int i = 0; i < 3; i++)
-			{
-				int3 i3 = { tri.vi[0 + i], tri.vi[3 + i], tri.vi[6 + i] };
-
-				auto s = index3_to_index_hash.find(i3);
-				if (s == index3_to_index_hash.end())
-				{
-					// index-combo does not exist, create it
-					vertex_t v;
-					v.Pos = file_vertices[i3.x];
-					if (i3.y > -1) v.Normal = file_normals[i3.y];
-					if (i3.z > -1) v.TexCoord = file_texcoords[i3.z];
-
-					wtri.vi[i] = (unsigned)vertices.size();
-					index3_to_index_hash[i3] = (unsigned)(vertices.size());
-
-					vertices.push_back(v);
-				}
-				else
-				{
-					// use existing index-combo
-					wtri.vi[i] = s->second;
-				}
-			}
-			wdc.tris.push_back(wtri);
+				wdc.tris[t].vi[i] = weld(tri.vi[0 + i], tri.vi[3 + i], tri.vi[6 + i]);
 		}
 
-#if 1
 		// weld vertices from quads
 		//
-		for (auto &quad : dc.quads)
+		wdc.quads.resize(dc.quads.size());
+		for (size_t q = 0; q < dc.quads.size(); q++)
 		{
-			quad_t_ wquad;
-
+			const unwelded_quad_t& quad = dc.quads[q];
 			for (int i = 0; i < 4; i++)
-			{
-				int3 i3 = { quad.vi[0 + i], quad.vi[3 + i], quad.vi[6 + i] };
-
-				auto s = index3_to_index_hash.find(i3);
-				if (s == index3_to_index_hash.end())
-				{
-					// index-combo does not exist, create it
-					vertex_t v;
-					v.Pos = file_vertices[i3.x];
-					if (i3.y > -1) v.Normal = file_normals[i3.y];
-					if (i3.z > -1) v.TexCoord = file_texcoords[i3.z];
-
-					wquad.vi[i] = (unsigned)vertices.size();
-					index3_to_index_hash[i3] = (unsigned)(vertices.size());
-
-					vertices.push_back(v);
-				}
-				else
-				{
-					// use existing index-combo
-					wquad.vi[i] = s->second;
-				}
-			}
-			wdc.quads.push_back(wquad);
+				wdc.quads[q].vi[i] = weld(quad.vi[0 + i], quad.vi[4 + i], quad.vi[8 + i]);
 		}
-#endif
 
 		drawcalls.push_back(wdc);
 	}
-	printf("Done\n");
+	double weld_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - weld_start).count();
+	printf("Done (%.2f ms, %.3f ms/drawcall)\n", weld_ms, file_drawcalls.size() ? weld_ms / file_drawcalls.size() : 0.0);
 
 	// Produce and print some stats
 	//
@@ -392,25 +700,35 @@ void mesh_t::load_obj(const std::string& filename,
 		tris += dc.tris.size();
 		quads += dc.quads.size();
 	}
-	printf("\t%d vertices\n\t%d drawcalls\n\t%d triangles\n\t%d quads\n",
-		vertices.size(), drawcalls.size(), tris, quads);
+	vec3f lo, hi;
+	vertices.bounds(lo, hi);
+	printf("\t%d vertices\n\t%d drawcalls\n\t%d triangles\n\t%d quads\n\tbounds (%.3g, %.3g, %.3g) - (%.3g, %.3g, %.3g)\n",
+		(int)vertices.size(), (int)drawcalls.size(), tris, quads, lo.x, lo.y, lo.z, hi.x, hi.y, hi.z);
+	if (weld_across_drawcalls)
+		printf("\t%d vertices shared between drawcalls (%.1f KB saved)\n",
+			shared_vertices, shared_vertices * sizeof(vertex_t) / 1024.0);
 	printf("Loaded materials:\n");
 	for (auto &mtl : materials)
 		printf("\t%s\n", mtl.name.c_str());
+	if (texture_paths.hits + texture_paths.misses)
+		printf("\t%d texture references to %d files\n", (int)(texture_paths.hits + texture_paths.misses), (int)texture_paths.size());
 
 #ifdef MESH_FORCE_CCW
     // Force ccw: flip triangle if geometric normal points away from vertex normal (at index=0)
     
+    const float *px = vertices.px.data(), *py = vertices.py.data(), *pz = vertices.pz.data();
+    const float *nx = vertices.nx.data(), *ny = vertices.ny.data(), *nz = vertices.nz.data();
+
     for (auto& dc : drawcalls)
         for (auto& tri : dc.tris)
         {
-            int a = tri.vi[0], b = tri.vi[1], c = tri.vi[2];
-            vec3f v0 = vertices[a].Pos, v1 = vertices[b].Pos, v2 = vertices[c].Pos;
+            unsigned a = tri.vi[0], b = tri.vi[1], c = tri.vi[2];
+            float e1x = px[b] - px[a], e1y = py[b] - py[a], e1z = pz[b] - pz[a];
+            float e2x = px[c] - px[a], e2y = py[c] - py[a], e2z = pz[c] - pz[a];
+            float gx = e1y*e2z - e1z*e2y, gy = e1z*e2x - e1x*e2z, gz = e1x*e2y - e1y*e2x;
 
-            vec3f geo_n = linalg::normalize((v1-v0)%(v2-v0));
-            vec3f vert_n = vertices[a].Normal;
-            
-            if (linalg::dot(geo_n, vert_n) < 0)
+            // same test as dot(normalize(geo_n), vert_n) < 0, where degenerate faces normalize to 0
+            if (gx*gx + gy*gy + gz*gz >= 1.0e-8 && gx*nx[a] + gy*ny[a] + gz*nz[a] < 0)
                 std::swap(tri.vi[0], tri.vi[1]);
         }
 #endif
@@ -422,3 +740,63 @@ void mesh_t::load_obj(const std::string& filename,
     
 #endif
 }
+
+void mesh_t::get_index_ranges(	std::vector<unsigned>& indices,
+								std::vector<index_range_t>& index_ranges) const
+{
+	const unsigned max_span = 0xffff;
+	bool rebase = vertices.size() > max_span + 1;
+
+	for (auto& dc : drawcalls)
+	{
+		int mtl_index = dc.mtl_index > -1 ? dc.mtl_index : -1;
+		size_t start = indices.size();
+		unsigned lo = ~0u, hi = 0;
+
+		// close the current range: make its indices relative to its lowest vertex
+		auto end_range = [&]()
+		{
+			if (indices.size() == start)
+				return;
+			unsigned ofs = rebase ? lo : 0;
+			for (size_t i = start; i < indices.size(); i++)
+				indices[i] -= ofs;
+			index_ranges.push_back({ start, indices.size() - start, ofs, mtl_index });
+			start = indices.size();
+			lo = ~0u; hi = 0;
+		};
+
+		for (auto& tri : dc.tris)
+		{
+			unsigned tri_lo = std::min(tri.vi[0], std::min(tri.vi[1], tri.vi[2]));
+			unsigned tri_hi = std::max(tri.vi[0], std::max(tri.vi[1], tri.vi[2]));
+
+			if (rebase && std::max(hi, tri_hi) - std::min(lo, tri_lo) > max_span)
+				end_range();
+
+			lo = std::min(lo, tri_lo);
+			hi = std::max(hi, tri_hi);
+			indices.insert(indices.end(), tri.vi, tri.vi + 3);
+		}
+		end_range();
+
+		// keep a range for drawcalls without triangles
+		if (!dc.tris.size())
+			index_ranges.push_back({ start, 0, 0, mtl_index });
+	}
+}
+
+bool pack_indices_16bit(const std::vector<unsigned>& indices, std::vector<unsigned short>& out)
+{
+	out.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] > 0xffff)
+		{
+			out.clear();
+			return false;
+		}
+		out[i] = (unsigned short)indices[i];
+	}
+	return true;
+}
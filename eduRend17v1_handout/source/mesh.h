@@ -15,6 +15,9 @@
 
 #include "vec/vec.h"
 #include "drawcall.h"
+#include "vertex_streams.h"
+#include "string_interner.h"
+#include "texture_paths.h"
 #include "parseutil.h"
 
 using linalg::vec3f;
@@ -32,52 +35,48 @@ struct unwelded_triangle_t { int vi[9]; };
 struct unwelded_quad_t { int vi[12]; };
 struct unwelded_drawcall_t
 {
-	std::string mtl_name;
-	std::string group_name;
+	unsigned mtl_id = 0;	// interned names, 0 if none
+	unsigned group_id = 0;
 	std::vector<unwelded_triangle_t> tris;
 	std::vector<unwelded_quad_t> quads;
 	int v_ofs = 0;
 };
 
+//
+// materials from MTL files, looked up by the interned id of their names
+//
+struct mtl_library_t
+{
+	std::vector<material_t> materials;
+	std::vector<int> index;	// name id -> materials index, -1 if not defined
+
+	const material_t* find(unsigned name_id) const
+	{
+		return name_id < index.size() && index[name_id] > -1 ? &materials[index[name_id]] : nullptr;
+	}
+};
+
+enum normal_weighting_t
+{
+	NORMAL_WEIGHT_UNIFORM,	// each face counts the same
+	NORMAL_WEIGHT_AREA,		// large faces count more
+	NORMAL_WEIGHT_ANGLE,	// faces count by their corner angle at the vertex
+};
+
 //
 // Creates normals to a set of vertices by averaging the geometric normals of the faces they belong to
 //
 // If a model lacks normals, this function can be used to create them. Works best for relatively smooth models.
+// Normals are indexed like the vertices, and the faces of drawcalls are pointed to them.
 //
-static void compute_normals(const std::vector<vec3f> &v, std::vector<vec3f> &vn, std::vector<unwelded_drawcall_t> &drawcalls)
-{
-    std::vector<vec3f> *v_bin = new std::vector<vec3f>[v.size()];
-    
-    // bin normals from all faces to vertex bins
-    for (unwelded_drawcall_t& dc : drawcalls)
-        for(unwelded_triangle_t& tri : dc.tris)
-        {
-            int a = tri.vi[0], b = tri.vi[1], c = tri.vi[2];
-            vec3f v0 = v[a], v1 = v[b], v2 = v[c];
-            vec3f n = linalg::normalize((v1-v0)%(v2-v0));
-            
-            v_bin[a].push_back(n);
-            v_bin[b].push_back(n);
-            v_bin[c].push_back(n);
-            
-            memcpy(tri.vi+3, tri.vi, 3*sizeof(int));
-        }
-
-    // average binned normals and add to array
-    for (int i=0; i<v.size(); i++)
-    {
-        vec3f n = vec3f(0,0,0);
-        for (int j=0; j<v_bin[i].size(); j++)
-        {
-            n += v_bin[i][j];
-        }
-        n = linalg::normalize(n);
-        
-        vn.push_back(n);
-    }
-
-    delete[] v_bin;
-}
+// With nbr_threads > 1, faces are split between threads that accumulate into their own arrays, which
+// may change the result in the last bits.
+//
+void compute_normals(	const std::vector<vec3f> &v,
+						std::vector<vec3f> &vn,
+						std::vector<unwelded_drawcall_t> &drawcalls,
+						normal_weighting_t weighting = NORMAL_WEIGHT_UNIFORM,
+						unsigned nbr_threads = 1);
 
 
 //
@@ -90,17 +89,84 @@ class mesh_t
 public:
     bool has_normals, has_texcoords;
     
-    std::vector<vertex_t> vertices;
+    // welded vertices, as separate attribute streams; see get_vertices
+    vertex_streams_t vertices;
     std::vector<drawcall_t> drawcalls;
     std::vector<material_t> materials;
+
+    // material and group names; drawcall_t::group_id indexes this
+    string_interner_t names;
+
+    // texture references of the materials, resolved to file paths
+    texture_path_cache_t texture_paths = texture_path_cache_t(ALLOWED_TEXTURE_SUFFIXES);
+
+    // the obj and mtl files the mesh was loaded from
+    std::vector<std::string> source_files;
     
-    static void load_mtl(	std::string dir,
-							std::string filename,
-							mtl_hash_t &mtl_hash);
+    //
+    // Adds the materials of an MTL file to mtls, interning their names in names
+    //
+    void load_mtl(	const std::string& dir,
+					const std::string& filename,
+					mtl_library_t &mtls);
     
+    //
+    // weld_across_drawcalls: store each unique vertex once for the whole mesh, instead of
+    // once per drawcall using it
+    // nbr_threads: max number of threads parsing the file in parallel (0 = one per core),
+    // gives the same result regardless of thread count
+    //
     void load_obj(	const std::string& filename,
 					bool auto_generate_normals = true,
-					bool triangulate = true);
+					bool triangulate = true,
+					bool weld_across_drawcalls = false,
+					unsigned nbr_threads = 0);
+
+    //
+    // Fills in vertex tangents and binormals from the texture coordinates (MikkTSpace
+    // conventions), splitting vertices on mirrored texture seams. Only triangles are used.
+    // nbr_threads: 0 = one per core; the result does not depend on it
+    //
+    void compute_tangents(unsigned nbr_threads = 0);
+
+    //
+    // Packs the diffuse maps of materials with small textures (at most max_texture_size
+    // texels across) into shared atlases of at most max_atlas_size, written with mips to
+    // atlas_basename<N>.dds, and moves their texture coordinates into atlas space. Then
+    // merges materials that share an atlas and their constants, and drawcalls that share
+    // a material. Only materials with no other maps and coordinates within [0, 1] qualify.
+    // Prints the number of drawcalls before and after.
+    //
+    void pack_texture_atlases(	const std::string& atlas_basename,
+								unsigned max_texture_size = 512,
+								unsigned max_atlas_size = 2048);
+
+    //
+    // Reorders the triangles of each drawcall for post-transform cache reuse, then the
+    // vertices in order of first use. Prints ACMR/ATVR before and after (mesh_optimize.h).
+    //
+    void optimize_vertex_cache();
+
+    //
+    // Interleaved vertices for upload
+    //
+    void get_vertices(std::vector<vertex_t>& out) const { vertices.interleave(out); }
+
+    const std::string& group_name(const drawcall_t& dc) const { return names.name(dc.group_id); }
+
+    //
+    // Triangle indices of all drawcalls in one array, with one index range per drawcall.
+    // Meshes with more vertices than 16-bit indices can address have their drawcalls split
+    // into ranges spanning at most 65536 vertices each; range indices are then relative
+    // to the range's base vertex (ofs), so they can be packed with pack_indices_16bit.
+    //
+    void get_index_ranges(	std::vector<unsigned>& indices,
+							std::vector<index_range_t>& index_ranges) const;
 };
 
+//
+// Copies indices to 16 bits. Returns false, leaving out empty, if an index does not fit.
+//
+bool pack_indices_16bit(const std::vector<unsigned>& indices, std::vector<unsigned short>& out);
+
 #endif
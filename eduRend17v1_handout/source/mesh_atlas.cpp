@@ -0,0 +1,222 @@
+//
+//  mesh_atlas.cpp
+//
+//	Texture atlases for materials with small textures
+//
+
+#include <cstdio>
+#include <algorithm>
+#include <map>
+#include <chrono>
+#include "mesh.h"
+#include "texture_atlas.h"
+#include "texture_decode.h"
+#include "texture_mips.h"
+#include "texture_bake.h"
+
+namespace
+{
+	// keeps whole texels of each image down to mip 4, with 8 texels of padding at mip 0
+	const unsigned atlas_padding = 8;
+	const unsigned atlas_alignment = 16;
+
+	//
+	// Same constants, so drawcalls using either can share one material
+	//
+	bool same_constants(const material_t& a, const material_t& b)
+	{
+		return a.Ka == b.Ka && a.Kd == b.Kd && a.Ks == b.Ks && a.Ns == b.Ns && a.d == b.d && a.illum == b.illum;
+	}
+
+	template<class F>
+	void for_each_index(drawcall_t& dc, F fn)
+	{
+		for (auto& tri : dc.tris)
+			for (unsigned& i : tri.vi)
+				fn(i);
+		for (auto& quad : dc.quads)
+			for (unsigned& i : quad.vi)
+				fn(i);
+	}
+}
+
+void mesh_t::pack_texture_atlases(const std::string& atlas_basename, unsigned max_texture_size, unsigned max_atlas_size)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	const size_t nbr_drawcalls = drawcalls.size();
+	printf("Packing texture atlases...\n");
+
+	// candidates: a diffuse map and no other, with texture coordinates that stay on it
+	const float uv_margin = 1.0e-3f;
+	std::vector<bool> candidate(materials.size());
+	for (size_t m = 0; m < materials.size(); m++)
+	{
+		const material_t& mtl = materials[m];
+		candidate[m] = mtl.map_Kd.size() && mtl.map_Ks.empty() && mtl.map_d.empty() && mtl.map_bump.empty();
+	}
+	for (auto& dc : drawcalls)
+	{
+		if (dc.mtl_index < 0 || !candidate[dc.mtl_index])
+			continue;
+		for_each_index(dc, [&](unsigned& i)
+		{
+			if (vertices.u[i] < -uv_margin || vertices.u[i] > 1 + uv_margin ||
+				vertices.v[i] < -uv_margin || vertices.v[i] > 1 + uv_margin)
+				candidate[dc.mtl_index] = false;
+		});
+	}
+
+	// their textures, once each, if they are small enough
+	std::vector<std::string> files;
+	std::vector<int> mtl_image(materials.size(), -1);
+	for (size_t m = 0; m < materials.size(); m++)
+		if (candidate[m])
+		{
+			auto f = std::find(files.begin(), files.end(), materials[m].map_Kd);
+			mtl_image[m] = (int)(f - files.begin());
+			if (f == files.end())
+				files.push_back(materials[m].map_Kd);
+		}
+
+	std::vector<decoded_image_t> images;
+	decode_images(files, images);
+	std::vector<atlas_size_t> sizes(images.size());
+	for (size_t i = 0; i < images.size(); i++)
+		if (images[i].channels == 4 && std::max(images[i].width, images[i].height) <= max_texture_size)
+		{
+			sizes[i].width = images[i].width;
+			sizes[i].height = images[i].height;
+		}
+
+	std::vector<atlas_rect_t> rects;
+	std::vector<atlas_size_t> atlas_sizes;
+	unsigned nbr_atlases = pack_atlases(sizes, max_atlas_size, atlas_padding, atlas_alignment, rects, atlas_sizes);
+
+	// an atlas of one image saves nothing
+	std::vector<unsigned> images_per_atlas(nbr_atlases);
+	for (auto& r : rects)
+		if (r.atlas < nbr_atlases)
+			images_per_atlas[r.atlas]++;
+	for (size_t m = 0; m < materials.size(); m++)
+		if (mtl_image[m] > -1 && (rects[mtl_image[m]].atlas >= nbr_atlases || images_per_atlas[rects[mtl_image[m]].atlas] < 2))
+			mtl_image[m] = -1;
+
+	// write the atlases: BC1, or BC3 if any of their images have alpha
+	std::vector<decoded_image_t> atlases;
+	compose_atlases(images, rects, atlas_sizes, atlas_padding, atlases);
+	std::vector<std::string> atlas_files(nbr_atlases);
+	for (unsigned a = 0; a < nbr_atlases; a++)
+	{
+		if (images_per_atlas[a] < 2)
+			continue;
+		bool alpha = false;
+		for (size_t i = 0; i < images.size(); i++)
+			if (rects[i].atlas == a)
+				for (size_t p = 3; p < images[i].pixels.size() && !alpha; p += 4)
+					alpha = images[i].pixels[p] < 255;
+
+		std::vector<decoded_image_t> mips;
+		generate_mips(atlases[a], true, mips, 0);
+		atlas_files[a] = atlas_basename + std::to_string(a) + ".dds";
+		if (!write_dds(atlas_files[a], mips, alpha ? TEXTURE_BC3 : TEXTURE_BC1, 0))
+		{
+			printf("\tfailed to write %s\n", atlas_files[a].c_str());
+			for (size_t m = 0; m < materials.size(); m++)
+				if (mtl_image[m] > -1 && rects[mtl_image[m]].atlas == a)
+					mtl_image[m] = -1;
+			atlas_files[a].clear();
+			continue;
+		}
+		printf("\t%s: %ux%u, %u textures\n", atlas_files[a].c_str(), atlases[a].width, atlases[a].height, images_per_atlas[a]);
+
+		// the mesh is out of date when the textures packed into it change
+		for (size_t i = 0; i < images.size(); i++)
+			if (rects[i].atlas == a)
+				source_files.push_back(files[i]);
+		source_files.push_back(atlas_files[a]);
+	}
+
+	// vertices are moved into atlas space by the material of their first drawcall; other
+	// materials using the same vertex get a copy
+	std::vector<int> owner(vertices.size(), -2);	// material, -1 if none packed, -2 if not used yet
+	std::map<std::pair<unsigned, int>, unsigned> copies;
+	for (auto& dc : drawcalls)
+	{
+		int mtl = dc.mtl_index > -1 && mtl_image[dc.mtl_index] > -1 ? dc.mtl_index : -1;
+		for_each_index(dc, [&](unsigned& i)
+		{
+			if (owner[i] == -2)
+				owner[i] = mtl;
+			if (owner[i] == mtl)
+				return;
+
+			auto c = copies.find({ i, mtl });
+			if (c == copies.end())
+			{
+				c = copies.insert({ { i, mtl }, (unsigned)vertices.size() }).first;
+				vertices.push_back_copy(i);
+				owner.push_back(mtl);
+			}
+			i = c->second;
+		});
+	}
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		if (owner[i] < 0)
+			continue;
+		const atlas_rect_t& r = rects[mtl_image[owner[i]]];
+		const decoded_image_t& image = images[mtl_image[owner[i]]];
+		const atlas_size_t& size = atlas_sizes[r.atlas];
+		vertices.u[i] = (r.x + vertices.u[i] * image.width) / size.width;
+		vertices.v[i] = (r.y + vertices.v[i] * image.height) / size.height;
+	}
+
+	// materials that now share an atlas and their constants become one
+	std::vector<int> mtl_remap(materials.size());
+	std::vector<material_t> merged;
+	for (size_t m = 0; m < materials.size(); m++)
+	{
+		mtl_remap[m] = (int)merged.size();
+		if (mtl_image[m] > -1)
+		{
+			const std::string& atlas_file = atlas_files[rects[mtl_image[m]].atlas];
+			auto same = std::find_if(merged.begin(), merged.end(), [&](const material_t& mtl)
+			{
+				return mtl.map_Kd == atlas_file && same_constants(mtl, materials[m]);
+			});
+			mtl_remap[m] = (int)(same - merged.begin());
+			if (same != merged.end())
+				continue;
+			materials[m].map_Kd = atlas_file;
+		}
+		merged.push_back(materials[m]);
+	}
+	materials = std::move(merged);
+
+	// then one drawcall per atlas material, where it first appears; drawcalls of
+	// materials that were not packed keep their place and group
+	std::vector<drawcall_t> merged_drawcalls;
+	std::map<int, size_t> mtl_drawcall;
+	for (auto& dc : drawcalls)
+	{
+		bool packed = dc.mtl_index > -1 && mtl_image[dc.mtl_index] > -1;
+		int mtl = dc.mtl_index > -1 ? mtl_remap[dc.mtl_index] : -1;
+		auto d = packed ? mtl_drawcall.find(mtl) : mtl_drawcall.end();
+		if (d == mtl_drawcall.end())
+		{
+			if (packed)
+				mtl_drawcall[mtl] = merged_drawcalls.size();
+			merged_drawcalls.push_back(std::move(dc));
+			merged_drawcalls.back().mtl_index = mtl;
+			continue;
+		}
+		drawcall_t& into = merged_drawcalls[d->second];
+		into.tris.insert(into.tris.end(), dc.tris.begin(), dc.tris.end());
+		into.quads.insert(into.quads.end(), dc.quads.begin(), dc.quads.end());
+	}
+	drawcalls = std::move(merged_drawcalls);
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("Done (%.1f ms): %d drawcalls before, %d after, %d materials, %d vertices copied\n",
+		ms, (int)nbr_drawcalls, (int)drawcalls.size(), (int)materials.size(), (int)copies.size());
+}
@@ -0,0 +1,270 @@
+//
+//  mesh_cache.cpp
+//
+//	Binary cache of processed OBJ models
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "mesh_cache.h"
+#include "mesh.h"
+
+// bump when the layout or the mesh processing changes
+#define MESH_CACHE_VERSION 7
+
+//
+// File layout
+//
+//	header_t
+//	per source file: content hash, size, path
+//	per material: Ka, Kd, Ks, Ns, d, illum, name, map_Kd, map_Ks, map_d, map_bump
+//	per index range: start, size, ofs, mtl_index
+//	vertex array (16-byte aligned)
+//	index array (16 or 32 bit)
+//
+// Strings are stored as a 32-bit length followed by the characters.
+//
+struct mesh_cache_header_t
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t options;
+	uint32_t vertex_size;
+	uint32_t index_size;
+	uint32_t nbr_source_files;
+	uint32_t nbr_materials;
+	uint32_t nbr_index_ranges;
+	uint64_t nbr_vertices;
+	uint64_t nbr_indices;
+	uint64_t vertices_offset;
+	uint64_t indices_offset;
+};
+
+static const char mesh_cache_magic[8] = { 'E', 'D', 'U', 'M', 'E', 'S', 'H', 0 };
+
+//
+// compile-time processing options also change the output
+//
+static unsigned build_options()
+{
+	unsigned opt = 0;
+#ifdef MESH_FORCE_CCW
+	opt |= 1 << 0;
+#endif
+#ifdef MESH_SORT_DRAWCALLS
+	opt |= 1 << 1;
+#endif
+	return opt;
+}
+
+namespace
+{
+	struct writer_t
+	{
+		std::vector<char> buf;
+
+		void put(const void* p, size_t n) { buf.insert(buf.end(), (const char*)p, (const char*)p + n); }
+		template<class T> void put(const T& v) { put(&v, sizeof(T)); }
+		void put(const std::string& s) { put((uint32_t)s.size()); put(s.data(), s.size()); }
+		void align(size_t a) { buf.resize((buf.size() + a - 1) / a * a, 0); }
+	};
+
+	// bounds-checked reads; any overrun marks the reader as failed
+	struct reader_t
+	{
+		const char* p;
+		const char* end;
+		bool ok = true;
+
+		reader_t(const char* p, const char* end) : p(p), end(end) { }
+
+		bool get(void* dst, size_t n)
+		{
+			if (!ok || (size_t)(end - p) < n) return ok = false;
+			memcpy(dst, p, n);
+			p += n;
+			return true;
+		}
+		template<class T> bool get(T& v) { return get(&v, sizeof(T)); }
+		bool get(std::string& s)
+		{
+			uint32_t n;
+			if (!get(n) || (size_t)(end - p) < n) return ok = false;
+			s.assign(p, n);
+			p += n;
+			return true;
+		}
+	};
+}
+
+std::string mesh_cache_t::cache_filename(const std::string& objfile)
+{
+	return objfile + ".cache";
+}
+
+//
+// Reports a cache that does not hold together, which is then rebuilt from the OBJ
+//
+static bool corrupt(const std::string& objfile)
+{
+	printf("Mesh cache %s is corrupt\n", mesh_cache_t::cache_filename(objfile).c_str());
+	return false;
+}
+
+bool mesh_cache_t::load(const std::string& objfile, unsigned options)
+{
+	std::unique_ptr<mapped_file_t> f(new mapped_file_t(cache_filename(objfile)));
+	if (!f->is_open())
+		return false;
+
+	reader_t r(f->begin(), f->end());
+	mesh_cache_header_t h;
+	if (!r.get(h) ||
+		memcmp(h.magic, mesh_cache_magic, sizeof(h.magic)) ||
+		h.version != MESH_CACHE_VERSION ||
+		h.options != (options | build_options() << 16) ||
+		h.vertex_size != sizeof(vertex_t) ||
+		(h.index_size != 2 && h.index_size != 4))
+		return false;
+
+	// stale if any source file changed
+	for (uint32_t i = 0; i < h.nbr_source_files; i++)
+	{
+		uint64_t hash, size;
+		std::string path;
+		if (!r.get(hash) || !r.get(size) || !r.get(path))
+			return false;
+
+		mapped_file_t src(path);
+		if (!src.is_open() || src.size() != size || src.content_hash() != hash)
+		{
+			printf("Mesh cache %s is stale (%s changed)\n", cache_filename(objfile).c_str(), path.c_str());
+			return false;
+		}
+	}
+
+	// counts that cannot fit in the rest of the file mean a corrupt header
+	const size_t min_material_bytes = 3 * sizeof(vec3f) + 2 * sizeof(float) + sizeof(int) + 5 * sizeof(uint32_t);
+	const size_t range_bytes = 2 * sizeof(uint64_t) + sizeof(unsigned) + sizeof(int);
+	if (h.nbr_materials > (size_t)(r.end - r.p) / min_material_bytes ||
+		h.nbr_index_ranges > (size_t)(r.end - r.p) / range_bytes)
+		return corrupt(objfile);
+
+	std::vector<material_t> mtls(h.nbr_materials);
+	for (auto& mtl : mtls)
+		if (!r.get(mtl.Ka) || !r.get(mtl.Kd) || !r.get(mtl.Ks) || !r.get(mtl.Ns) || !r.get(mtl.d) || !r.get(mtl.illum) ||
+			!r.get(mtl.name) || !r.get(mtl.map_Kd) || !r.get(mtl.map_Ks) || !r.get(mtl.map_d) || !r.get(mtl.map_bump))
+			return corrupt(objfile);
+
+	std::vector<index_range_t> ranges(h.nbr_index_ranges);
+	for (auto& range : ranges)
+	{
+		uint64_t start, size;
+		if (!r.get(start) || !r.get(size) || !r.get(range.ofs) || !r.get(range.mtl_index))
+			return corrupt(objfile);
+		if (start > h.nbr_indices || size > h.nbr_indices - start ||
+			range.mtl_index < -1 || range.mtl_index >= (int)h.nbr_materials)
+			return corrupt(objfile);
+		range.start = (size_t)start;
+		range.size = (size_t)size;
+	}
+
+	// vertex & index arrays are used in place
+	uint64_t file_size = f->size();
+	if (h.vertices_offset > file_size || h.nbr_vertices > (file_size - h.vertices_offset) / sizeof(vertex_t) ||
+		h.indices_offset > file_size || h.nbr_indices > (file_size - h.indices_offset) / h.index_size)
+		return corrupt(objfile);
+
+	// every index of a range, plus its offset, has to be a vertex
+	const char* index_data = f->begin() + h.indices_offset;
+	for (auto& range : ranges)
+	{
+		uint64_t max_index = 0;
+		for (size_t i = range.start; i < range.start + range.size; i++)
+			max_index = std::max<uint64_t>(max_index, h.index_size == 2 ? ((const uint16_t*)index_data)[i] : ((const uint32_t*)index_data)[i]);
+		if (range.size && max_index + range.ofs >= h.nbr_vertices)
+			return corrupt(objfile);
+	}
+
+	vertices = (const vertex_t*)(f->begin() + h.vertices_offset);
+	nbr_vertices = (size_t)h.nbr_vertices;
+	indices = index_data;
+	nbr_indices = (size_t)h.nbr_indices;
+	index_size = h.index_size;
+	index_ranges.swap(ranges);
+	materials.swap(mtls);
+	file.swap(f);
+	return true;
+}
+
+bool mesh_cache_t::write(	const std::string& objfile,
+							unsigned options,
+							const std::vector<std::string>& source_files,
+							const std::vector<vertex_t>& vertices,
+							const void* indices,
+							size_t nbr_indices,
+							unsigned index_size,
+							const std::vector<index_range_t>& index_ranges,
+							const std::vector<material_t>& materials)
+{
+	writer_t w;
+
+	mesh_cache_header_t h = {};
+	memcpy(h.magic, mesh_cache_magic, sizeof(h.magic));
+	h.version = MESH_CACHE_VERSION;
+	h.options = options | build_options() << 16;
+	h.vertex_size = sizeof(vertex_t);
+	h.index_size = index_size;
+	h.nbr_source_files = (uint32_t)source_files.size();
+	h.nbr_materials = (uint32_t)materials.size();
+	h.nbr_index_ranges = (uint32_t)index_ranges.size();
+	h.nbr_vertices = vertices.size();
+	h.nbr_indices = nbr_indices;
+	w.put(h);
+
+	for (auto& path : source_files)
+	{
+		mapped_file_t src(path);
+		if (!src.is_open())
+			return false;
+		w.put(src.content_hash());
+		w.put((uint64_t)src.size());
+		w.put(path);
+	}
+
+	for (auto& mtl : materials)
+	{
+		w.put(mtl.Ka); w.put(mtl.Kd); w.put(mtl.Ks); w.put(mtl.Ns); w.put(mtl.d); w.put(mtl.illum);
+		w.put(mtl.name); w.put(mtl.map_Kd); w.put(mtl.map_Ks); w.put(mtl.map_d); w.put(mtl.map_bump);
+	}
+
+	for (auto& range : index_ranges)
+	{
+		w.put((uint64_t)range.start); w.put((uint64_t)range.size); w.put(range.ofs); w.put(range.mtl_index);
+	}
+
+	w.align(16);
+	h.vertices_offset = w.buf.size();
+	if (vertices.size()) w.put(vertices.data(), vertices.size() * sizeof(vertex_t));
+	w.align(16);
+	h.indices_offset = w.buf.size();
+	if (nbr_indices) w.put(indices, nbr_indices * index_size);
+	memcpy(w.buf.data(), &h, sizeof(h));
+
+	// write to a temporary and rename, so a reader never sees a partial cache
+	std::string filename = cache_filename(objfile), tmpname = filename + ".tmp";
+	std::ofstream out(tmpname.c_str(), std::ios::binary);
+	if (!out)
+		return false;
+	out.write(w.buf.data(), w.buf.size());
+	out.close();
+	if (!out)
+	{
+		std::remove(tmpname.c_str());
+		return false;
+	}
+
+	std::remove(filename.c_str());
+	return std::rename(tmpname.c_str(), filename.c_str()) == 0;
+}
@@ -0,0 +1,58 @@
+//
+//  mesh_cache.h
+//
+//	Binary cache of processed OBJ models
+//
+
+#pragma once
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <memory>
+#include <vector>
+#include <string>
+#include "drawcall.h"
+#include "mapped_file.h"
+
+//
+// The cache for model.obj is written to model.obj.cache and holds the data OBJModel_t
+// uploads: the welded vertex array, the index array, the index ranges and the materials.
+// It also stores the content hash of every source file (the obj and its mtl files), so a
+// cache is stale as soon as any of them change.
+//
+// A loaded cache keeps the file mapped; vertices and indices point straight into it.
+//
+class mesh_cache_t
+{
+	std::unique_ptr<mapped_file_t> file;
+
+public:
+
+	const vertex_t* vertices = nullptr;
+	size_t nbr_vertices = 0;
+	const void* indices = nullptr;
+	size_t nbr_indices = 0;
+	unsigned index_size = 4;	// bytes per index: 2 or 4
+	std::vector<index_range_t> index_ranges;
+	std::vector<material_t> materials;
+
+	static std::string cache_filename(const std::string& objfile);
+
+	//
+	// Maps the cache of objfile. Returns false if it is missing, corrupt, stale, or was
+	// written with other load options.
+	//
+	bool load(const std::string& objfile, unsigned options);
+
+	static bool write(	const std::string& objfile,
+						unsigned options,
+						const std::vector<std::string>& source_files,
+						const std::vector<vertex_t>& vertices,
+						const void* indices,
+						size_t nbr_indices,
+						unsigned index_size,
+						const std::vector<index_range_t>& index_ranges,
+						const std::vector<material_t>& materials);
+};
+
+#endif
@@ -0,0 +1,137 @@
+//
+//  mesh_normals.cpp
+//
+//	Vertex normals from face normals
+//
+
+#include <cmath>
+#include <algorithm>
+#include <future>
+#include "mesh.h"
+
+namespace
+{
+	float corner_angle(const vec3f& e1, const vec3f& e2)
+	{
+		return atan2f((e1 % e2).norm2(), linalg::dot(e1, e2));
+	}
+
+	//
+	// Adds the normals of faces [f0, f1) to acc and points the faces to them. Faces are
+	// numbered through all drawcalls, triangles before quads within a drawcall.
+	//
+	void accumulate_normals(	const vec3f* v,
+								std::vector<unwelded_drawcall_t>& drawcalls,
+								size_t f0,
+								size_t f1,
+								normal_weighting_t weighting,
+								vec3f* acc)
+	{
+		size_t base = 0;
+		for (auto& dc : drawcalls)
+		{
+			if (base >= f1)
+				break;
+
+			size_t t0 = std::max(f0, base) - base, t1 = std::min(f1, base + dc.tris.size());
+			for (size_t t = t0; t + base < t1; t++)
+			{
+				int* vi = dc.tris[t].vi;
+				vec3f v0 = v[vi[0]], v1 = v[vi[1]], v2 = v[vi[2]];
+				vec3f n = (v1 - v0) % (v2 - v0);
+
+				if (weighting == NORMAL_WEIGHT_ANGLE)
+				{
+					n = linalg::normalize(n);
+					acc[vi[0]] += n * corner_angle(v1 - v0, v2 - v0);
+					acc[vi[1]] += n * corner_angle(v2 - v1, v0 - v1);
+					acc[vi[2]] += n * corner_angle(v0 - v2, v1 - v2);
+				}
+				else
+				{
+					// the cross product is scaled by the area
+					if (weighting == NORMAL_WEIGHT_UNIFORM)
+						n = linalg::normalize(n);
+					acc[vi[0]] += n;
+					acc[vi[1]] += n;
+					acc[vi[2]] += n;
+				}
+
+				vi[3] = vi[0]; vi[4] = vi[1]; vi[5] = vi[2];
+			}
+			base += dc.tris.size();
+
+			size_t q0 = std::max(f0, base) - base, q1 = std::min(f1, base + dc.quads.size());
+			for (size_t q = q0; q + base < q1; q++)
+			{
+				int* vi = dc.quads[q].vi;
+				vec3f p[4] = { v[vi[0]], v[vi[1]], v[vi[2]], v[vi[3]] };
+
+				// cross product of the diagonals, also right for non-planar quads
+				vec3f n = (p[2] - p[0]) % (p[3] - p[1]);
+				if (weighting != NORMAL_WEIGHT_AREA)
+					n = linalg::normalize(n);
+
+				for (int i = 0; i < 4; i++)
+				{
+					if (weighting == NORMAL_WEIGHT_ANGLE)
+						acc[vi[i]] += n * corner_angle(p[(i + 1) & 3] - p[i], p[(i + 3) & 3] - p[i]);
+					else
+						acc[vi[i]] += n;
+					vi[4 + i] = vi[i];
+				}
+			}
+			base += dc.quads.size();
+		}
+	}
+}
+
+void compute_normals(	const std::vector<vec3f> &v,
+						std::vector<vec3f> &vn,
+						std::vector<unwelded_drawcall_t> &drawcalls,
+						normal_weighting_t weighting,
+						unsigned nbr_threads)
+{
+	size_t nbr_faces = 0;
+	for (auto& dc : drawcalls)
+		nbr_faces += dc.tris.size() + dc.quads.size();
+
+	vn.assign(v.size(), vec3f(0, 0, 0));
+	nbr_threads = (unsigned)std::max<size_t>(1, std::min<size_t>(nbr_threads, nbr_faces));
+
+	if (nbr_threads == 1)
+		accumulate_normals(v.data(), drawcalls, 0, nbr_faces, weighting, vn.data());
+	else
+	{
+		// the first thread accumulates straight into vn, the others into their own arrays
+		std::vector<std::vector<vec3f>> thread_acc(nbr_threads - 1, std::vector<vec3f>(v.size()));
+		std::vector<std::future<void>> workers;
+		for (unsigned i = 0; i < nbr_threads; i++)
+		{
+			size_t f0 = nbr_faces * i / nbr_threads, f1 = nbr_faces * (i + 1) / nbr_threads;
+			vec3f* acc = i ? thread_acc[i - 1].data() : vn.data();
+			workers.push_back(std::async(std::launch::async, accumulate_normals,
+				v.data(), std::ref(drawcalls), f0, f1, weighting, acc));
+		}
+		for (auto& w : workers)
+			w.get();
+		workers.clear();
+
+		// sum the arrays, split by vertex range
+		for (unsigned i = 0; i < nbr_threads; i++)
+		{
+			size_t v0 = v.size() * i / nbr_threads, v1 = v.size() * (i + 1) / nbr_threads;
+			workers.push_back(std::async(std::launch::async, [&, v0, v1]()
+			{
+				for (auto& acc : thread_acc)
+					for (size_t j = v0; j < v1; j++)
+						vn[j] += acc[j];
+			}));
+		}
+		for (auto& w : workers)
+			w.get();
+	}
+
+	for (auto& n : vn)
+		n = linalg::normalize(n);
+}
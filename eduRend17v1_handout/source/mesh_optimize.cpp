@@ -0,0 +1,257 @@
+//
+//  mesh_optimize.cpp
+//
+//	Index and vertex order optimization for the GPU vertex caches
+//
+
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "mesh_optimize.h"
+#include "mesh.h"
+
+vertex_cache_stats_t analyze_vertex_cache(	const unsigned* indices,
+											size_t nbr_indices,
+											size_t nbr_vertices,
+											unsigned cache_size)
+{
+	vertex_cache_stats_t stats;
+
+	// a vertex is cached if fewer than cache_size misses happened since it was loaded
+	std::vector<size_t> loaded_at(nbr_vertices, 0);
+	size_t misses = 0, unique = 0;
+
+	for (size_t i = 0; i < nbr_indices; i++)
+	{
+		unsigned v = indices[i];
+		if (loaded_at[v] && misses - loaded_at[v] < cache_size)
+			continue;
+		if (!loaded_at[v])
+			unique++;
+		loaded_at[v] = ++misses;
+	}
+
+	stats.transformed = misses;
+	if (nbr_indices)
+		stats.acmr = (float)misses / (nbr_indices / 3);
+	if (unique)
+		stats.atvr = (float)misses / unique;
+	return stats;
+}
+
+namespace
+{
+	// LRU cache size the scoring is tuned for
+	const int forsyth_cache_size = 32;
+
+	float forsyth_vertex_score(int cache_pos, unsigned remaining_tris)
+	{
+		if (!remaining_tris)
+			return -1.0f;
+
+		float score = 0.0f;
+		if (cache_pos >= 0)
+		{
+			// the last triangle's vertices get a fixed score, so it is not favoured
+			// just for sharing an edge with it
+			if (cache_pos < 3)
+				score = 0.75f;
+			else
+				score = powf(1.0f - (cache_pos - 3) * (1.0f / (forsyth_cache_size - 3)), 1.5f);
+		}
+
+		// boost vertices with few triangles left, to finish them off
+		return score + 2.0f / sqrtf((float)remaining_tris);
+	}
+}
+
+//
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006
+//
+// Greedily emits the triangle with the highest score, which is the sum of its vertex scores.
+// Only triangles of vertices in the cache are rescored after each step; if none of them
+// are left, the next unemitted triangle in input order is used.
+//
+void optimize_vertex_cache(	unsigned* indices,
+							size_t nbr_indices,
+							size_t nbr_vertices)
+{
+	size_t nbr_tris = nbr_indices / 3;
+	if (nbr_tris < 2)
+		return;
+
+	// triangles of each vertex; the first remaining[v] of them are not yet emitted
+	std::vector<unsigned> remaining(nbr_vertices, 0), adj_ofs(nbr_vertices + 1, 0), adj(nbr_tris * 3);
+	for (size_t i = 0; i < nbr_tris * 3; i++)
+		remaining[indices[i]]++;
+	for (size_t v = 0; v < nbr_vertices; v++)
+		adj_ofs[v + 1] = adj_ofs[v] + remaining[v];
+	{
+		std::vector<unsigned> fill(adj_ofs.begin(), adj_ofs.end() - 1);
+		for (size_t i = 0; i < nbr_tris * 3; i++)
+			adj[fill[indices[i]]++] = (unsigned)(i / 3);
+	}
+
+	std::vector<int> cache_pos(nbr_vertices, -1);
+	std::vector<float> vertex_score(nbr_vertices);
+	for (size_t v = 0; v < nbr_vertices; v++)
+		vertex_score[v] = forsyth_vertex_score(-1, remaining[v]);
+
+	std::vector<float> tri_score(nbr_tris);
+	std::vector<bool> emitted(nbr_tris, false);
+	int best = 0;
+	for (size_t t = 0; t < nbr_tris; t++)
+	{
+		const unsigned* tri = indices + t * 3;
+		tri_score[t] = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+		if (tri_score[t] > tri_score[best])
+			best = (int)t;
+	}
+
+	std::vector<unsigned> out;
+	out.reserve(nbr_tris * 3);
+
+	unsigned cache[forsyth_cache_size + 3], new_cache[forsyth_cache_size + 3];
+	int cache_size = 0;
+	size_t next_unemitted = 0;
+
+	while (best >= 0)
+	{
+		const unsigned* tri = indices + best * 3;
+		out.insert(out.end(), tri, tri + 3);
+		emitted[best] = true;
+
+		// the triangle's vertices go first in the cache, followed by the rest
+		int new_size = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned v = tri[k];
+			new_cache[new_size++] = v;
+
+			unsigned* v_tris = adj.data() + adj_ofs[v];
+			unsigned* it = std::find(v_tris, v_tris + remaining[v], (unsigned)best);
+			std::swap(*it, v_tris[--remaining[v]]);
+		}
+		for (int i = 0; i < cache_size; i++)
+		{
+			unsigned v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				new_cache[new_size++] = v;
+		}
+
+		// rescore vertices, including those pushed out of the cache
+		for (int i = 0; i < new_size; i++)
+		{
+			unsigned v = new_cache[i];
+			cache_pos[v] = i < forsyth_cache_size ? i : -1;
+			vertex_score[v] = forsyth_vertex_score(cache_pos[v], remaining[v]);
+		}
+
+		// rescore their triangles and pick the best
+		best = -1;
+		float best_score = -1.0f;
+		for (int i = 0; i < new_size; i++)
+		{
+			unsigned v = new_cache[i];
+			for (unsigned j = 0; j < remaining[v]; j++)
+			{
+				unsigned t = adj[adj_ofs[v] + j];
+				const unsigned* t_tri = indices + t * 3;
+				tri_score[t] = vertex_score[t_tri[0]] + vertex_score[t_tri[1]] + vertex_score[t_tri[2]];
+				if (tri_score[t] > best_score)
+				{
+					best_score = tri_score[t];
+					best = (int)t;
+				}
+			}
+		}
+
+		cache_size = std::min(new_size, forsyth_cache_size);
+		memcpy(cache, new_cache, cache_size * sizeof(unsigned));
+
+		if (best < 0)
+		{
+			while (next_unemitted < nbr_tris && emitted[next_unemitted])
+				next_unemitted++;
+			best = next_unemitted < nbr_tris ? (int)next_unemitted : -1;
+		}
+	}
+
+	memcpy(indices, out.data(), out.size() * sizeof(unsigned));
+}
+
+void mesh_t::optimize_vertex_cache()
+{
+	auto opt_start = std::chrono::high_resolution_clock::now();
+
+	auto analyze = [this]()
+	{
+		std::vector<unsigned> indices;
+		for (auto& dc : drawcalls)
+			for (auto& tri : dc.tris)
+				indices.insert(indices.end(), tri.vi, tri.vi + 3);
+		return analyze_vertex_cache(indices.data(), indices.size(), vertices.size());
+	};
+	vertex_cache_stats_t before = analyze();
+
+	// reorder the triangles of each drawcall, on indices local to the drawcall
+	std::vector<unsigned> local_index(vertices.size(), ~0u), local_to_global, indices;
+	for (auto& dc : drawcalls)
+	{
+		indices.clear();
+		for (auto& tri : dc.tris)
+			for (int i = 0; i < 3; i++)
+			{
+				unsigned v = tri.vi[i];
+				if (local_index[v] == ~0u)
+				{
+					local_index[v] = (unsigned)local_to_global.size();
+					local_to_global.push_back(v);
+				}
+				indices.push_back(local_index[v]);
+			}
+
+		::optimize_vertex_cache(indices.data(), indices.size(), local_to_global.size());
+
+		for (size_t t = 0; t < dc.tris.size(); t++)
+			for (int i = 0; i < 3; i++)
+				dc.tris[t].vi[i] = local_to_global[indices[t * 3 + i]];
+
+		for (unsigned v : local_to_global)
+			local_index[v] = ~0u;
+		local_to_global.clear();
+	}
+
+	// reorder vertices by first use, so vertex fetches move forward through memory
+	const unsigned unused = ~0u;
+	std::vector<unsigned> remap(vertices.size(), unused);
+	unsigned nbr_used = 0;
+	for (auto& dc : drawcalls)
+	{
+		for (auto& tri : dc.tris)
+			for (unsigned& v : tri.vi)
+			{
+				if (remap[v] == unused) remap[v] = nbr_used++;
+				v = remap[v];
+			}
+		for (auto& quad : dc.quads)
+			for (unsigned& v : quad.vi)
+			{
+				if (remap[v] == unused) remap[v] = nbr_used++;
+				v = remap[v];
+			}
+	}
+
+	for (size_t v = 0; v < vertices.size(); v++)
+		if (remap[v] == unused) remap[v] = nbr_used++;
+	vertices.permute(remap);
+
+	vertex_cache_stats_t after = analyze();
+
+	double opt_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - opt_start).count();
+	printf("Optimized vertex cache (%.2f ms, FIFO size %d)\n\tACMR %.3f -> %.3f\n\tATVR %.3f -> %.3f\n",
+		opt_ms, VERTEX_CACHE_SIM_SIZE, before.acmr, after.acmr, before.atvr, after.atvr);
+}
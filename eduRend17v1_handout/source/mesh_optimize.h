@@ -0,0 +1,42 @@
+//
+//  mesh_optimize.h
+//
+//	Index and vertex order optimization for the GPU vertex caches
+//
+
+#pragma once
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <cstddef>
+
+// FIFO size used when measuring cache efficiency
+#define VERTEX_CACHE_SIM_SIZE 16
+
+//
+// Post-transform cache efficiency of a triangle list, as measured by a simulated FIFO cache.
+//
+// acmr: average cache miss ratio, transformed vertices per triangle (0.5 - 3, lower is better)
+// atvr: average transformed vertex ratio, transformed vertices per unique vertex (1 is optimal)
+//
+struct vertex_cache_stats_t
+{
+	float acmr = 0;
+	float atvr = 0;
+	size_t transformed = 0;
+};
+
+vertex_cache_stats_t analyze_vertex_cache(	const unsigned* indices,
+											size_t nbr_indices,
+											size_t nbr_vertices,
+											unsigned cache_size = VERTEX_CACHE_SIM_SIZE);
+
+//
+// Reorders the triangles of an indexed triangle list in place for post-transform cache reuse,
+// using Forsyth's linear-speed vertex cache optimization. All indices must be < nbr_vertices.
+//
+void optimize_vertex_cache(	unsigned* indices,
+							size_t nbr_indices,
+							size_t nbr_vertices);
+
+#endif
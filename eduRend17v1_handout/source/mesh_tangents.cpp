@@ -0,0 +1,182 @@
+//
+//  mesh_tangents.cpp
+//
+//	Tangent frames for normal mapping
+//
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include "mesh.h"
+#include "parallel.h"
+
+namespace
+{
+	// triangles or vertices; below this many per thread, starting threads costs more
+	const size_t min_items_per_thread = 16 * 1024;
+
+	//
+	// Some unit vector perpendicular to n, for vertices without usable texture coordinates
+	//
+	vec3f any_perpendicular(const vec3f& n)
+	{
+		vec3f axis = fabsf(n.x) < 0.9f ? vec3f(1, 0, 0) : vec3f(0, 1, 0);
+		return linalg::normalize(axis % n);
+	}
+}
+
+//
+// Follows the MikkTSpace conventions: the face tangent is the direction of increasing u,
+// its sign is that of the face's texture space area, and corners are weighted by angle
+// after projecting the face tangent onto the vertex normal. Corners of a vertex with
+// different signs (mirrored texture seams) get separate vertices; the rest are averaged.
+// Binormal = sign * (Normal x Tangent).
+//
+void mesh_t::compute_tangents(unsigned nbr_threads)
+{
+	if (!has_texcoords)
+	{
+		printf("No texture coordinates, tangents not generated\n");
+		return;
+	}
+
+	auto tangents_start = std::chrono::high_resolution_clock::now();
+
+	// corner c of all triangles, in drawcall order
+	std::vector<unsigned> corner_vertex;
+	for (auto& dc : drawcalls)
+		for (auto& tri : dc.tris)
+			corner_vertex.insert(corner_vertex.end(), tri.vi, tri.vi + 3);
+	size_t nbr_tris = corner_vertex.size() / 3, nbr_vertices = vertices.size();
+
+	// weighted, projected tangent per corner and the sign of its face
+	std::vector<float> ctx(nbr_tris * 3), cty(nbr_tris * 3), ctz(nbr_tris * 3);
+	std::vector<unsigned char> cflip(nbr_tris * 3);
+	{
+		const float *px = vertices.px.data(), *py = vertices.py.data(), *pz = vertices.pz.data();
+		const float *nx = vertices.nx.data(), *ny = vertices.ny.data(), *nz = vertices.nz.data();
+		const float *u = vertices.u.data(), *v = vertices.v.data();
+
+		parallel_for(nbr_tris, nbr_threads, min_items_per_thread, [&](size_t t0, size_t t1)
+		{
+			for (size_t t = t0; t < t1; t++)
+			{
+				const unsigned* vi = corner_vertex.data() + t * 3;
+				vec3f p[3], uv[3];
+				for (int k = 0; k < 3; k++)
+				{
+					p[k] = vec3f(px[vi[k]], py[vi[k]], pz[vi[k]]);
+					uv[k] = vec3f(u[vi[k]], v[vi[k]], 0);
+				}
+
+				vec3f e1 = p[1] - p[0], e2 = p[2] - p[0];
+				float du1 = uv[1].x - uv[0].x, dv1 = uv[1].y - uv[0].y;
+				float du2 = uv[2].x - uv[0].x, dv2 = uv[2].y - uv[0].y;
+				float area = du1 * dv2 - du2 * dv1;
+				float sign = area < 0 ? -1.0f : 1.0f;
+
+				// dp/du, up to a positive scale. Its length goes with edge length times texture
+				// area, so it is made unit length before projecting (scaled to its largest
+				// component first, as its squared length can underflow).
+				vec3f face_t = (e1 * dv2 - e2 * dv1) * sign;
+				float face_t_max = std::max(fabsf(face_t.x), std::max(fabsf(face_t.y), fabsf(face_t.z)));
+				if (face_t_max == 0)
+					face_t = vec3f(0, 0, 0);
+				else
+				{
+					face_t = face_t * (1.0f / face_t_max);
+					face_t = face_t * (1.0f / face_t.norm2());
+				}
+
+				for (int k = 0; k < 3; k++)
+				{
+					vec3f n(nx[vi[k]], ny[vi[k]], nz[vi[k]]);
+					vec3f t_k = linalg::normalize(face_t - n * linalg::dot(n, face_t));
+
+					vec3f a = p[(k + 1) % 3] - p[k], b = p[(k + 2) % 3] - p[k];
+					float angle = atan2f((a % b).norm2(), linalg::dot(a, b));
+
+					size_t c = t * 3 + k;
+					ctx[c] = t_k.x * angle;
+					cty[c] = t_k.y * angle;
+					ctz[c] = t_k.z * angle;
+					cflip[c] = area < 0;
+				}
+			}
+		});
+	}
+
+	// sum corners per vertex and sign: slot 2*v for positive, 2*v+1 for negative
+	std::vector<vec3f> acc(nbr_vertices * 2);
+	std::vector<unsigned char> used(nbr_vertices * 2, 0);
+	for (size_t c = 0; c < corner_vertex.size(); c++)
+	{
+		// corners without a tangent do not decide the vertex's sign
+		if (ctx[c] == 0 && cty[c] == 0 && ctz[c] == 0)
+			continue;
+		size_t slot = corner_vertex[c] * 2 + cflip[c];
+		acc[slot] += vec3f(ctx[c], cty[c], ctz[c]);
+		used[slot] = 1;
+	}
+
+	// vertices used with both signs get a copy for the negative one
+	std::vector<unsigned> split_vertex(nbr_vertices, ~0u);
+	for (size_t i = 0; i < nbr_vertices; i++)
+		if (used[i * 2] && used[i * 2 + 1])
+		{
+			split_vertex[i] = (unsigned)vertices.size();
+			vertices.push_back_copy(i);
+		}
+	size_t nbr_split = vertices.size() - nbr_vertices;
+
+	// orthonormalize
+	std::atomic<unsigned> nbr_fallbacks(0);
+	{
+		float *tx = vertices.tx.data(), *ty = vertices.ty.data(), *tz = vertices.tz.data();
+		float *bx = vertices.bx.data(), *by = vertices.by.data(), *bz = vertices.bz.data();
+		const float *nx = vertices.nx.data(), *ny = vertices.ny.data(), *nz = vertices.nz.data();
+
+		parallel_for(nbr_vertices, nbr_threads, min_items_per_thread, [&](size_t v0, size_t v1)
+		{
+			for (size_t i = v0; i < v1; i++)
+				for (int flip = 0; flip < 2; flip++)
+				{
+					// the positive slot also covers vertices no triangle uses
+					if (flip ? !used[i * 2 + 1] : (used[i * 2 + 1] && !used[i * 2]))
+						continue;
+					size_t dst = flip && split_vertex[i] != ~0u ? split_vertex[i] : i;
+
+					vec3f n(nx[i], ny[i], nz[i]);
+					vec3f t = acc[i * 2 + flip];
+					t = linalg::normalize(t - n * linalg::dot(n, t));
+					if (t.norm2squared() == 0)
+					{
+						t = any_perpendicular(n);
+						nbr_fallbacks++;
+					}
+					vec3f b = (n % t) * (flip ? -1.0f : 1.0f);
+
+					tx[dst] = t.x; ty[dst] = t.y; tz[dst] = t.z;
+					bx[dst] = b.x; by[dst] = b.y; bz[dst] = b.z;
+				}
+		});
+	}
+
+	// point negative corners of split vertices to the copies
+	if (nbr_split)
+	{
+		size_t c = 0;
+		for (auto& dc : drawcalls)
+			for (auto& tri : dc.tris)
+				for (int k = 0; k < 3; k++, c++)
+					if (cflip[c] && split_vertex[tri.vi[k]] != ~0u)
+						tri.vi[k] = split_vertex[tri.vi[k]];
+	}
+
+	double tangents_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tangents_start).count();
+	printf("Generated tangents (%.2f ms, %.1f Mtris/s)\n\t%d vertices split at mirrored seams (+%.1f%%), %d without a texture space tangent\n",
+		tangents_ms, tangents_ms > 0 ? nbr_tris / (tangents_ms * 1000.0) : 0.0,
+		(int)nbr_split, nbr_vertices ? 100.0 * nbr_split / nbr_vertices : 0.0, (int)nbr_fallbacks);
+}
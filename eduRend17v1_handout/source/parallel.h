@@ -0,0 +1,71 @@
+//
+//  parallel.h
+//
+//	Splitting loops between threads
+//
+
+#pragma once
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+//
+// Threads for a request of nbr_threads: 0 = one per core
+//
+inline unsigned thread_count(unsigned nbr_threads)
+{
+	return nbr_threads ? nbr_threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+//
+// Runs fn(begin, end) over [0, n) in contiguous parts, one per thread with the calling
+// thread taking the first: up to nbr_threads parts (0 = one per core), fewer where they
+// would get less than min_items_per_thread items. Part boundaries are multiples of
+// alignment, so threads writing neighbouring elements can keep off each other's cache
+// lines.
+//
+template<class F>
+void parallel_for(size_t n, unsigned nbr_threads, size_t min_items_per_thread, F fn, size_t alignment = 1)
+{
+	size_t nbr_parts = std::max<size_t>(1, std::min<size_t>(thread_count(nbr_threads), n / std::max<size_t>(1, min_items_per_thread)));
+	auto split = [&](size_t i) { return i == nbr_parts ? n : n * i / nbr_parts / alignment * alignment; };
+
+	std::vector<std::future<void>> workers;
+	for (size_t i = 1; i < nbr_parts; i++)
+		workers.push_back(std::async(std::launch::async, fn, split(i), split(i + 1)));
+	fn(0, split(1));
+	for (auto& w : workers)
+		w.get();
+}
+
+//
+// Calls fn(i) for each i in [0, n) on up to nbr_threads threads (0 = one per core),
+// handing the items out one at a time, in order; for items whose costs differ a lot
+//
+template<class F>
+void parallel_for_each(size_t n, unsigned nbr_threads, F fn)
+{
+	unsigned nbr_workers = (unsigned)std::min<size_t>(thread_count(nbr_threads), n);
+
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t i; (i = next++) < n;)
+			fn(i);
+	};
+
+	std::vector<std::future<void>> workers;
+	for (unsigned i = 1; i < nbr_workers; i++)
+		workers.push_back(std::async(std::launch::async, worker));
+	if (nbr_workers)
+		worker();
+	for (auto& w : workers)
+		w.get();
+}
+
+#endif
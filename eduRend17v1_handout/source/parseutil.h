@@ -11,6 +11,9 @@
 
 #include <string>
 #include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
 
 inline std::string& rtrim(std::string& str)
 {
@@ -41,36 +44,239 @@ static std::string get_parentdir(std::string path)
 }
 
 //
-// find and extract first occurance of *.[suffix] in a string
+// in-place scanning of a character range [p, end)
 //
-static bool find_filename_from_suffix(const std::string &str, const std::string &suffix, std::string& res)
+// These work directly on (memory mapped) file contents that need not be null-terminated.
+// Each parse_* function skips leading blanks, reads one value and advances p past it,
+// or leaves p untouched and returns false.
+//
+
+inline bool is_blank(char c)
 {
-    std::string dotsuffix = std::string(".")+suffix;
-    size_t end = str.find(dotsuffix);
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
 
-    if (end == std::string::npos)
-        return false;
-    
-    size_t start = str.rfind(" ", end);
-    
-    if (start == end)
-        return false;
-    if (start == std::string::npos)
-        start = -1;
-    
-    res = str.substr(start+1, end-start-1 + dotsuffix.length());
-    return true;
+inline const char* skip_blanks(const char* p, const char* end)
+{
+	while (p < end && is_blank(*p)) p++;
+	return p;
+}
+
+inline const char* find_token_end(const char* p, const char* end)
+{
+	while (p < end && !is_blank(*p) && *p != '\n') p++;
+	return p;
+}
+
+inline bool token_equals(const char* tok, const char* tok_end, const char* str)
+{
+	size_t len = strlen(str);
+	return (size_t)(tok_end - tok) == len && !memcmp(tok, str, len);
+}
+
+//
+// read next token as a string, i.e. what "%s" would give
+//
+inline bool parse_token(const char*& p, const char* end, std::string& res)
+{
+	const char* s = skip_blanks(p, end);
+	const char* e = find_token_end(s, end);
+	if (s == e)
+		return false;
+	res.assign(s, e);
+	p = e;
+	return true;
+}
+
+inline bool parse_int(const char*& p, const char* end, int& res)
+{
+	const char* s = skip_blanks(p, end);
+	bool neg = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		neg = *s++ == '-';
+	if (s == end || (unsigned)(*s - '0') > 9)
+		return false;
+
+	int i = 0;
+	while (s < end && (unsigned)(*s - '0') <= 9)
+		i = i * 10 + (*s++ - '0');
+
+	res = neg ? -i : i;
+	p = s;
+	return true;
 }
 
 //
-// find and extract first occurance of *.[{suffix-list}] in a string
+// Parses a decimal float with the same (correctly rounded) result as strtof/"%f".
 //
-static bool find_filename_from_suffixes(const std::string &str, const std::vector<std::string>& suffixes, std::string& res)
+// Numbers with at most 7 significant digits and a small decimal exponent, i.e. what
+// exporters normally write, are exact in float and take a single multiply or divide.
+// Anything else (long mantissas, large exponents, inf/nan, hex) falls back to strtof.
+//
+inline bool parse_float(const char*& p, const char* end, float& res)
 {
-	for (auto& suffix : suffixes)
-		if (find_filename_from_suffix(str, suffix, res))
+	static const float pow10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+	const char* s = skip_blanks(p, end);
+	const char* start = s;
+
+	bool neg = false;
+	if (s < end && (*s == '-' || *s == '+'))
+		neg = *s++ == '-';
+
+	unsigned long long mant = 0;
+	int exp10 = 0, digits = 0, sig_digits = 0;
+
+	while (s < end && (unsigned)(*s - '0') <= 9)
+	{
+		if (sig_digits < 18) { mant = mant * 10 + (*s - '0'); if (mant) sig_digits++; }
+		else exp10++;
+		s++; digits++;
+	}
+	// "0x..." is left to strtof
+	bool hex = digits == 1 && !mant && s < end && (*s == 'x' || *s == 'X');
+	if (!hex && s < end && *s == '.')
+	{
+		s++;
+		while (s < end && (unsigned)(*s - '0') <= 9)
+		{
+			if (sig_digits < 18) { mant = mant * 10 + (*s - '0'); if (mant) sig_digits++; exp10--; }
+			s++; digits++;
+		}
+	}
+
+	if (digits && !hex)
+	{
+		// exponent is only consumed if it has at least one digit, as in strtof
+		if (s < end && (*s == 'e' || *s == 'E'))
+		{
+			const char* e = s + 1;
+			bool eneg = false;
+			if (e < end && (*e == '-' || *e == '+'))
+				eneg = *e++ == '-';
+			if (e < end && (unsigned)(*e - '0') <= 9)
+			{
+				int x = 0;
+				while (e < end && (unsigned)(*e - '0') <= 9)
+				{
+					if (x < 10000) x = x * 10 + (*e - '0');
+					e++;
+				}
+				exp10 += eneg ? -x : x;
+				s = e;
+			}
+		}
+
+		if (mant <= (1ull << 24) && exp10 >= -10 && exp10 <= 10)
+		{
+			float f = (float)mant;
+			f = exp10 < 0 ? f / pow10[-exp10] : f * pow10[exp10];
+			res = neg ? -f : f;
+			p = s;
 			return true;
-	return false;
+		}
+	}
+
+	// slow path
+	char buf[128];
+	size_t len = find_token_end(start, end) - start;
+	if (!len || len >= sizeof(buf))
+		return false;
+	memcpy(buf, start, len);
+	buf[len] = 0;
+
+	char* buf_end;
+	float f = strtof(buf, &buf_end);
+	if (buf_end == buf)
+		return false;
+
+	res = f;
+	p = start + (buf_end - buf);
+	return true;
+}
+
+inline bool equals_nocase(const char* s, const char* str, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		if (tolower((unsigned char)s[i]) != tolower((unsigned char)str[i]))
+			return false;
+	return true;
+}
+
+//
+// Lexically normalized form of a path, for comparing paths to the same file: '\\' becomes
+// '/', and empty, "." and "dir/.." components are removed. Lowercase on Windows, where
+// file names are not case-sensitive.
+//
+inline std::string canonical_path(const std::string& path)
+{
+	std::vector<std::string> parts;
+	bool absolute = path.size() && (path[0] == '/' || path[0] == '\\');
+
+	size_t start = 0;
+	while (start <= path.size())
+	{
+		size_t end = path.find_first_of("/\\", start);
+		if (end == std::string::npos) end = path.size();
+		std::string part = path.substr(start, end - start);
+
+		if (part == ".." && parts.size() && parts.back() != "..")
+			parts.pop_back();
+		else if (part.size() && part != ".")
+			parts.push_back(part);
+		start = end + 1;
+	}
+
+	std::string res = absolute ? "/" : "";
+	for (size_t i = 0; i < parts.size(); i++)
+		res += (i ? "/" : "") + parts[i];
+#ifdef _WIN32
+	for (auto& c : res)
+		c = (char)tolower((unsigned char)c);
+#endif
+	return res;
+}
+
+//
+// find and extract the first *.[{suffix-list}] in the range [s, e)
+//
+// Suffixes are matched case-insensitively and must end the file name; earlier suffixes
+// in the list take precedence. The file name starts after the last blank before it.
+//
+inline bool find_filename_from_suffixes(const char* s, const char* e, const std::vector<std::string>& suffixes, std::string& res)
+{
+	const char *best = nullptr, *best_end = nullptr;
+	size_t best_suffix = suffixes.size();
+
+	for (const char* dot = s; (dot = (const char*)memchr(dot, '.', e - dot)) != nullptr; dot++)
+	{
+		const char* ext = dot + 1;
+		const char* ext_end = find_token_end(ext, e);
+		for (size_t i = 0; i < best_suffix; i++)
+			if ((size_t)(ext_end - ext) == suffixes[i].size() && equals_nocase(ext, suffixes[i].data(), suffixes[i].size()))
+			{
+				best = dot;
+				best_end = ext_end;
+				best_suffix = i;
+				break;
+			}
+	}
+	if (!best)
+		return false;
+
+	const char* start = best;
+	while (start > s && !is_blank(start[-1]))
+		start--;
+	if (start == best)
+		return false;
+
+	res.assign(start, best_end);
+	return true;
+}
+
+inline bool find_filename_from_suffixes(const std::string &str, const std::vector<std::string>& suffixes, std::string& res)
+{
+	return find_filename_from_suffixes(str.data(), str.data() + str.size(), suffixes, res);
 }
 
 #endif /* parseutil_h */
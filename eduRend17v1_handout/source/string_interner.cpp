@@ -0,0 +1,75 @@
+//
+//  string_interner.cpp
+//
+
+#include <cstring>
+#include "string_interner.h"
+
+string_interner_t::string_interner_t()
+{
+	clear();
+}
+
+void string_interner_t::clear()
+{
+	strings.assign(1, std::string());
+	table.assign(16, 0);
+	table[find_slot(nullptr, nullptr, hash(nullptr, nullptr))] = 1;
+}
+
+size_t string_interner_t::hash(const char* s, const char* e)
+{
+	// FNV-1a
+	size_t h = (size_t)14695981039346656037ull;
+	for (; s < e; s++)
+		h = (h ^ (unsigned char)*s) * (size_t)1099511628211ull;
+	return h;
+}
+
+//
+// Slot holding the string, or the empty slot it would go in
+//
+unsigned string_interner_t::find_slot(const char* s, const char* e, size_t h) const
+{
+	size_t mask = table.size() - 1, len = e - s;
+	for (size_t i = h & mask;; i = (i + 1) & mask)
+	{
+		unsigned id = table[i];
+		if (!id)
+			return (unsigned)i;
+		const std::string& str = strings[id - 1];
+		if (str.size() == len && !memcmp(str.data(), s, len))
+			return (unsigned)i;
+	}
+}
+
+void string_interner_t::grow()
+{
+	table.assign(table.size() * 2, 0);
+	for (unsigned id = 0; id < strings.size(); id++)
+	{
+		const char* s = strings[id].data();
+		const char* e = s + strings[id].size();
+		table[find_slot(s, e, hash(s, e))] = id + 1;
+	}
+}
+
+unsigned string_interner_t::intern(const char* s, const char* e)
+{
+	unsigned slot = find_slot(s, e, hash(s, e));
+	if (table[slot])
+		return table[slot] - 1;
+
+	unsigned id = (unsigned)strings.size();
+	strings.emplace_back(s, e);
+	table[slot] = id + 1;
+	if (strings.size() * 2 > table.size())
+		grow();
+	return id;
+}
+
+unsigned string_interner_t::find(const char* s, const char* e) const
+{
+	unsigned slot = find_slot(s, e, hash(s, e));
+	return table[slot] ? table[slot] - 1 : npos;
+}
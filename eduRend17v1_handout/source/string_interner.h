@@ -0,0 +1,51 @@
+//
+//  string_interner.h
+//	maps strings to small integer ids
+//
+
+#pragma once
+#ifndef STRING_INTERNER_H
+#define STRING_INTERNER_H
+
+#include <string>
+#include <vector>
+
+//
+// Each distinct string gets an id, numbered from 0 in order of first appearance, so
+// names can be stored, compared and used as array indices as plain integers. Id 0 is
+// always the empty string.
+//
+// Lookups take a character range and only copy the string the first time it is seen.
+//
+class string_interner_t
+{
+	std::vector<std::string> strings;
+	// open addressing table of id + 1, 0 for empty slots; at most half full
+	std::vector<unsigned> table;
+
+	static size_t hash(const char* s, const char* e);
+	unsigned find_slot(const char* s, const char* e, size_t h) const;
+	void grow();
+
+public:
+
+	static const unsigned npos = ~0u;
+
+	string_interner_t();
+
+	unsigned intern(const char* s, const char* e);
+	unsigned intern(const std::string& str) { return intern(str.data(), str.data() + str.size()); }
+
+	//
+	// id of a string, or npos if it has not been interned
+	//
+	unsigned find(const char* s, const char* e) const;
+	unsigned find(const std::string& str) const { return find(str.data(), str.data() + str.size()); }
+
+	const std::string& name(unsigned id) const { return strings[id]; }
+	size_t size() const { return strings.size(); }
+
+	void clear();
+};
+
+#endif
@@ -0,0 +1,127 @@
+//
+//  texture_atlas.cpp
+//
+//	Packing of small images into shared atlas images
+//
+
+#include <algorithm>
+#include <cstring>
+#include "texture_atlas.h"
+
+namespace
+{
+	unsigned align_up(unsigned x, unsigned alignment)
+	{
+		return (x + alignment - 1) / alignment * alignment;
+	}
+
+	struct shelf_t
+	{
+		unsigned atlas;
+		unsigned y, height;
+		unsigned width;		// used so far
+	};
+}
+
+unsigned pack_atlases(	const std::vector<atlas_size_t>& sizes,
+						unsigned max_size,
+						unsigned padding,
+						unsigned alignment,
+						std::vector<atlas_rect_t>& rects,
+						std::vector<atlas_size_t>& atlas_sizes)
+{
+	rects.assign(sizes.size(), atlas_rect_t());
+	atlas_sizes.clear();
+	alignment = std::max(alignment, 1u);
+
+	// tallest first, so each shelf is as high as its first image
+	std::vector<unsigned> order(sizes.size());
+	for (unsigned i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b)
+	{
+		return sizes[a].height != sizes[b].height ? sizes[a].height > sizes[b].height : sizes[a].width > sizes[b].width;
+	});
+
+	std::vector<shelf_t> shelves;
+	std::vector<unsigned> atlas_bottom;		// top of the free space below the last shelf
+	for (unsigned i : order)
+	{
+		unsigned w = align_up(sizes[i].width + 2 * padding, alignment);
+		unsigned h = align_up(sizes[i].height + 2 * padding, alignment);
+		if (!sizes[i].width || !sizes[i].height || w > max_size || h > max_size)
+			continue;
+
+		// first shelf with room, else a new shelf in the first atlas with room, else a new atlas
+		shelf_t* shelf = nullptr;
+		for (auto& s : shelves)
+			if (s.height >= h && s.width + w <= max_size)
+			{
+				shelf = &s;
+				break;
+			}
+		if (!shelf)
+		{
+			unsigned atlas = 0;
+			while (atlas < atlas_bottom.size() && atlas_bottom[atlas] + h > max_size)
+				atlas++;
+			if (atlas == atlas_bottom.size())
+			{
+				atlas_bottom.push_back(0);
+				atlas_sizes.push_back(atlas_size_t());
+			}
+			shelves.push_back({ atlas, atlas_bottom[atlas], h, 0 });
+			atlas_bottom[atlas] += h;
+			shelf = &shelves.back();
+		}
+
+		rects[i].atlas = shelf->atlas;
+		rects[i].x = shelf->width + padding;
+		rects[i].y = shelf->y + padding;
+		shelf->width += w;
+
+		atlas_size_t& size = atlas_sizes[shelf->atlas];
+		size.width = std::max(size.width, shelf->width);
+		size.height = std::max(size.height, shelf->y + h);
+	}
+	return (unsigned)atlas_sizes.size();
+}
+
+void compose_atlases(	const std::vector<decoded_image_t>& images,
+						const std::vector<atlas_rect_t>& rects,
+						const std::vector<atlas_size_t>& atlas_sizes,
+						unsigned padding,
+						std::vector<decoded_image_t>& atlases)
+{
+	atlases.resize(atlas_sizes.size());
+	for (size_t a = 0; a < atlas_sizes.size(); a++)
+	{
+		atlases[a].width = atlas_sizes[a].width;
+		atlases[a].height = atlas_sizes[a].height;
+		atlases[a].channels = 4;
+		atlases[a].pixels.assign(atlases[a].row_pitch() * atlases[a].height, 0);
+	}
+
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		const decoded_image_t& image = images[i];
+		if (rects[i].atlas >= atlases.size() || image.channels != 4)
+			continue;
+		decoded_image_t& atlas = atlases[rects[i].atlas];
+		const int w = (int)image.width, h = (int)image.height, p = (int)padding;
+
+		for (int y = -p; y < h + p; y++)
+		{
+			const uint8_t* src = image.pixels.data() + std::min(std::max(y, 0), h - 1) * image.row_pitch();
+			uint8_t* dst = atlas.pixels.data() + (rects[i].y + y) * atlas.row_pitch() + (rects[i].x - p) * 4;
+
+			// the image row, with its first and last texels repeated into the padding
+			for (int x = 0; x < p; x++, dst += 4)
+				memcpy(dst, src, 4);
+			memcpy(dst, src, w * 4);
+			dst += w * 4;
+			for (int x = 0; x < p; x++, dst += 4)
+				memcpy(dst, src + (w - 1) * 4, 4);
+		}
+	}
+}
@@ -0,0 +1,54 @@
+//
+//  texture_atlas.h
+//
+//	Packing of small images into shared atlas images
+//
+
+#pragma once
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <vector>
+#include "texture_decode.h"
+
+//
+// Where an image went: the atlas, and the top left of the image itself inside its padding
+//
+struct atlas_rect_t
+{
+	unsigned atlas = ~0u;	// ~0u if the image did not fit
+	unsigned x = 0, y = 0;
+};
+
+struct atlas_size_t
+{
+	unsigned width = 0, height = 0;
+};
+
+//
+// Shelf packs images of the given sizes into atlases of at most max_size x max_size,
+// tallest first. Each image gets padding texels on every side, and its padded rectangle
+// is placed on a multiple of alignment, so it keeps to whole texels in the mips down to
+// that factor. Images too large for an empty atlas are left out.
+//
+// Atlases are cropped to what they use, rounded up to alignment. Returns their number.
+//
+unsigned pack_atlases(	const std::vector<atlas_size_t>& sizes,
+						unsigned max_size,
+						unsigned padding,
+						unsigned alignment,
+						std::vector<atlas_rect_t>& rects,
+						std::vector<atlas_size_t>& atlas_sizes);
+
+//
+// Copies RGBA images to the atlases at rects, filling the padding around each with its
+// edge texels, so filtering and mips bleed the image's own colors rather than its
+// neighbours'. Texels no image covers are left black.
+//
+void compose_atlases(	const std::vector<decoded_image_t>& images,
+						const std::vector<atlas_rect_t>& rects,
+						const std::vector<atlas_size_t>& atlas_sizes,
+						unsigned padding,
+						std::vector<decoded_image_t>& atlases);
+
+#endif
@@ -0,0 +1,316 @@
+//
+//  texture_bake.cpp
+//
+//	Offline conversion of material textures to block-compressed DDS files with mips
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <set>
+#include "texture_bake.h"
+#include "texture_mips.h"
+#include "mapped_file.h"
+#include "parallel.h"
+
+namespace
+{
+	uint16_t to_565(const uint8_t c[3])
+	{
+		return (uint16_t)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+	}
+
+	void from_565(uint16_t v, int c[3])
+	{
+		int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+		c[0] = (r << 3) | (r >> 2);
+		c[1] = (g << 2) | (g >> 4);
+		c[2] = (b << 3) | (b >> 2);
+	}
+
+	//
+	// BC1-style color block; the 4-color mode is always used, as BC3 requires
+	//
+	void encode_color_block(const uint8_t rgba[64], uint8_t block[8])
+	{
+		uint8_t lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 3; c++)
+			{
+				lo[c] = std::min(lo[c], rgba[i * 4 + c]);
+				hi[c] = std::max(hi[c], rgba[i * 4 + c]);
+			}
+		for (int c = 0; c < 3; c++)
+		{
+			int inset = (hi[c] - lo[c]) >> 4;
+			lo[c] = (uint8_t)(lo[c] + inset);
+			hi[c] = (uint8_t)(hi[c] - inset);
+		}
+
+		uint16_t c0 = to_565(hi), c1 = to_565(lo);
+		if (c0 < c1)
+			std::swap(c0, c1);
+		memset(block, 0, 8);
+		block[0] = (uint8_t)c0; block[1] = (uint8_t)(c0 >> 8);
+		block[2] = (uint8_t)c1; block[3] = (uint8_t)(c1 >> 8);
+		if (c0 == c1)
+			return;
+
+		int palette[4][3];
+		from_565(c0, palette[0]);
+		from_565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		uint32_t indices = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, best_dist = INT_MAX;
+			for (int k = 0; k < 4; k++)
+			{
+				int dr = rgba[i * 4] - palette[k][0], dg = rgba[i * 4 + 1] - palette[k][1], db = rgba[i * 4 + 2] - palette[k][2];
+				int dist = dr * dr + dg * dg + db * db;
+				if (dist < best_dist) { best_dist = dist; best = k; }
+			}
+			indices |= (uint32_t)best << (i * 2);
+		}
+		memcpy(block + 4, &indices, 4);
+	}
+
+	//
+	// BC4 block of one channel, in the 8-value mode
+	//
+	void encode_channel_block(const uint8_t rgba[64], int channel, uint8_t block[8])
+	{
+		int a0 = 0, a1 = 255;
+		for (int i = 0; i < 16; i++)
+		{
+			a0 = std::max(a0, (int)rgba[i * 4 + channel]);
+			a1 = std::min(a1, (int)rgba[i * 4 + channel]);
+		}
+		memset(block, 0, 8);
+		block[0] = (uint8_t)a0;
+		block[1] = (uint8_t)a1;
+		if (a0 == a1)
+			return;
+
+		int palette[8] = { a0, a1 };
+		for (int k = 1; k < 7; k++)
+			palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, best_dist = INT_MAX;
+			for (int k = 0; k < 8; k++)
+			{
+				int dist = abs(rgba[i * 4 + channel] - palette[k]);
+				if (dist < best_dist) { best_dist = dist; best = k; }
+			}
+			indices |= (uint64_t)best << (i * 3);
+		}
+		for (int b = 0; b < 6; b++)
+			block[2 + b] = (uint8_t)(indices >> (b * 8));
+	}
+
+	unsigned block_size(texture_compression_t compression)
+	{
+		return compression == TEXTURE_BC1 ? 8 : 16;
+	}
+
+	uint32_t fourcc(char a, char b, char c, char d)
+	{
+		return (uint32_t)(uint8_t)a | (uint32_t)(uint8_t)b << 8 | (uint32_t)(uint8_t)c << 16 | (uint32_t)(uint8_t)d << 24;
+	}
+
+	// DDS_HEADER, as 32-bit words following the "DDS " magic
+	enum
+	{
+		DDS_SIZE = 0, DDS_FLAGS, DDS_HEIGHT, DDS_WIDTH, DDS_LINEAR_SIZE, DDS_DEPTH, DDS_MIP_COUNT,
+		DDS_RESERVED1,		// 11 words: marker, source hash low, high
+		DDS_PF_SIZE = 18, DDS_PF_FLAGS, DDS_PF_FOURCC,
+		DDS_CAPS = 26,
+		DDS_HEADER_WORDS = 31
+	};
+	const uint32_t dds_bake_marker = fourcc('E', 'D', 'U', 'B');
+}
+
+void encode_bc1_block(const uint8_t rgba[64], uint8_t block[8])
+{
+	encode_color_block(rgba, block);
+}
+
+void encode_bc3_block(const uint8_t rgba[64], uint8_t block[16])
+{
+	encode_channel_block(rgba, 3, block);
+	encode_color_block(rgba, block + 8);
+}
+
+void encode_bc5_block(const uint8_t rgba[64], uint8_t block[16])
+{
+	encode_channel_block(rgba, 0, block);
+	encode_channel_block(rgba, 1, block + 8);
+}
+
+void compress_image(const decoded_image_t& image, texture_compression_t compression, std::vector<uint8_t>& blocks)
+{
+	unsigned blocks_x = (image.width + 3) / 4, blocks_y = (image.height + 3) / 4, size = block_size(compression);
+	blocks.resize((size_t)blocks_x * blocks_y * size);
+
+	uint8_t rgba[64];
+	uint8_t* out = blocks.data();
+	for (unsigned by = 0; by < blocks_y; by++)
+		for (unsigned bx = 0; bx < blocks_x; bx++, out += size)
+		{
+			for (unsigned i = 0; i < 16; i++)
+			{
+				unsigned x = std::min(bx * 4 + (i & 3), image.width - 1), y = std::min(by * 4 + (i >> 2), image.height - 1);
+				memcpy(rgba + i * 4, image.pixels.data() + (size_t)y * image.row_pitch() + x * 4, 4);
+			}
+			switch (compression)
+			{
+			case TEXTURE_BC1: encode_bc1_block(rgba, out); break;
+			case TEXTURE_BC3: encode_bc3_block(rgba, out); break;
+			case TEXTURE_BC5: encode_bc5_block(rgba, out); break;
+			}
+		}
+}
+
+bool write_dds(	const std::string& filename,
+				const std::vector<decoded_image_t>& mips,
+				texture_compression_t compression,
+				uint64_t source_hash)
+{
+	if (mips.empty())
+		return false;
+
+	uint32_t header[DDS_HEADER_WORDS] = {};
+	header[DDS_SIZE] = sizeof(header);
+	header[DDS_FLAGS] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;	// caps, height, width, pixelformat, mipmapcount, linearsize
+	header[DDS_HEIGHT] = mips[0].height;
+	header[DDS_WIDTH] = mips[0].width;
+	header[DDS_LINEAR_SIZE] = ((mips[0].width + 3) / 4) * ((mips[0].height + 3) / 4) * block_size(compression);
+	header[DDS_MIP_COUNT] = (uint32_t)mips.size();
+	header[DDS_RESERVED1] = dds_bake_marker;
+	header[DDS_RESERVED1 + 1] = (uint32_t)source_hash;
+	header[DDS_RESERVED1 + 2] = (uint32_t)(source_hash >> 32);
+	header[DDS_PF_SIZE] = 32;
+	header[DDS_PF_FLAGS] = 0x4;	// fourcc
+	header[DDS_PF_FOURCC] = compression == TEXTURE_BC1 ? fourcc('D', 'X', 'T', '1') :
+							compression == TEXTURE_BC3 ? fourcc('D', 'X', 'T', '5') : fourcc('A', 'T', 'I', '2');
+	header[DDS_CAPS] = 0x1000 | 0x8 | 0x400000;	// texture, complex, mipmap
+
+	// write to a temporary and rename, so a reader never sees a partial file
+	std::string tmpname = filename + ".tmp";
+	std::ofstream out(tmpname.c_str(), std::ios::binary);
+	if (!out)
+		return false;
+	out.write("DDS ", 4);
+	out.write((const char*)header, sizeof(header));
+
+	std::vector<uint8_t> blocks;
+	for (auto& mip : mips)
+	{
+		compress_image(mip, compression, blocks);
+		out.write((const char*)blocks.data(), blocks.size());
+	}
+	out.close();
+	if (!out)
+	{
+		std::remove(tmpname.c_str());
+		return false;
+	}
+
+	std::remove(filename.c_str());
+	return std::rename(tmpname.c_str(), filename.c_str()) == 0;
+}
+
+bool read_dds_source_hash(const void* data, size_t size, uint64_t& source_hash)
+{
+	uint32_t header[DDS_HEADER_WORDS];
+	if (size < 4 + sizeof(header) || memcmp(data, "DDS ", 4))
+		return false;
+	memcpy(header, (const char*)data + 4, sizeof(header));
+	if (header[DDS_RESERVED1] != dds_bake_marker)
+		return false;
+
+	source_hash = header[DDS_RESERVED1 + 1] | (uint64_t)header[DDS_RESERVED1 + 2] << 32;
+	return true;
+}
+
+std::string baked_filename(const std::string& texture_file, bool linear)
+{
+	return texture_file + (linear ? ".linear.dds" : ".dds");
+}
+
+bool bake_texture(const std::string& texture_file, bool linear)
+{
+	mapped_file_t src(texture_file);
+	if (!src.is_open())
+	{
+		printf("Failed to open %s\n", texture_file.c_str());
+		return false;
+	}
+	uint64_t hash = src.content_hash(), baked_hash;
+
+	std::string filename = baked_filename(texture_file, linear);
+	{
+		mapped_file_t baked(filename);
+		if (baked.is_open() && read_dds_source_hash(baked.begin(), baked.size(), baked_hash) && baked_hash == hash)
+			return true;
+	}
+
+	decoded_image_t image;
+	if (!decode_image(src.begin(), src.size(), image))
+	{
+		printf("Failed to decode %s\n", texture_file.c_str());
+		return false;
+	}
+
+	texture_compression_t compression = linear ? TEXTURE_BC5 : TEXTURE_BC1;
+	for (size_t i = 3; i < image.pixels.size(); i += 4)
+		if (image.pixels[i] < 255)
+		{
+			compression = TEXTURE_BC3;
+			break;
+		}
+
+	std::vector<decoded_image_t> mips;
+	generate_mips(image, !linear, mips);
+
+	bool ok = write_dds(filename, mips, compression, hash);
+	printf("%s %s (%ux%u, %s, %d mips)\n", ok ? "Baked" : "Failed to write", filename.c_str(),
+		image.width, image.height, compression == TEXTURE_BC1 ? "BC1" : compression == TEXTURE_BC3 ? "BC3" : "BC5", (int)mips.size());
+	return ok;
+}
+
+size_t bake_textures(const std::vector<material_t>& materials, unsigned nbr_threads)
+{
+	// (file, linear), once each; a file used both ways gets both baked files
+	std::set<std::pair<std::string, bool>> unique;
+	for (auto& mtl : materials)
+	{
+		for (auto* map : { &mtl.map_Kd, &mtl.map_Ks })
+			if (map->size())
+				unique.insert({ *map, false });
+		for (auto* map : { &mtl.map_d, &mtl.map_bump })
+			if (map->size())
+				unique.insert({ *map, true });
+	}
+	std::vector<std::pair<std::string, bool>> textures(unique.begin(), unique.end());
+
+	std::atomic<size_t> failed(0);
+	parallel_for_each(textures.size(), nbr_threads, [&](size_t i)
+	{
+		if (!bake_texture(textures[i].first, textures[i].second))
+			failed++;
+	});
+	return failed;
+}
@@ -0,0 +1,72 @@
+//
+//  texture_bake.h
+//
+//	Offline conversion of material textures to block-compressed DDS files with mips
+//
+
+#pragma once
+#ifndef TEXTURE_BAKE_H
+#define TEXTURE_BAKE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "drawcall.h"
+#include "texture_decode.h"
+
+enum texture_compression_t
+{
+	TEXTURE_BC1,	// RGB, 4 bits/pixel; for opaque color maps
+	TEXTURE_BC3,	// RGBA, 8 bits/pixel; for color maps with alpha
+	TEXTURE_BC5,	// RG, 8 bits/pixel; for bump and normal maps
+};
+
+//
+// Block encoders: 4x4 RGBA8 pixels (row by row) to one block. Color endpoints are the
+// bounding box of the block, inset by 1/16 of its extent; single channels (alpha, BC5)
+// use their min and max. Each pixel picks the nearest of the interpolated values
+// (J.M.P. van Waveren, "Real-Time DXT Compression", 2006).
+//
+void encode_bc1_block(const uint8_t rgba[64], uint8_t block[8]);
+void encode_bc3_block(const uint8_t rgba[64], uint8_t block[16]);
+void encode_bc5_block(const uint8_t rgba[64], uint8_t block[16]);
+
+//
+// Compresses an image, padding partial blocks by repeating the edge pixels
+//
+void compress_image(const decoded_image_t& image, texture_compression_t compression, std::vector<uint8_t>& blocks);
+
+//
+// Writes mips (mips[0] the full image) as a DDS file, recording the content hash of the
+// source image so stale files can be detected
+//
+bool write_dds(	const std::string& filename,
+				const std::vector<decoded_image_t>& mips,
+				texture_compression_t compression,
+				uint64_t source_hash);
+
+//
+// Content hash of the source a DDS file was baked from; false if it has none
+//
+bool read_dds_source_hash(const void* data, size_t size, uint64_t& source_hash);
+
+//
+// The baked file of a texture: texture.png -> texture.png.dds, or texture.png.linear.dds
+// where it holds linear data
+//
+std::string baked_filename(const std::string& texture_file, bool linear);
+
+//
+// Decodes a texture and writes its baked file, with a gamma-correct mip chain unless it
+// holds linear data. Color is BC1 and linear data BC5, or both BC3 if the texture has
+// alpha. Does nothing if the baked file is up to date.
+//
+bool bake_texture(const std::string& texture_file, bool linear);
+
+//
+// Bakes every texture of the materials on up to nbr_threads threads (0 = one per core);
+// map_d and map_bump as linear data. Returns the number of textures that failed.
+//
+size_t bake_textures(const std::vector<material_t>& materials, unsigned nbr_threads = 0);
+
+#endif
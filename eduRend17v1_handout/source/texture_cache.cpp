@@ -0,0 +1,407 @@
+//
+//  texture_cache.cpp
+//
+//	Process-wide cache of device textures loaded from image files
+//
+
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include "texture_cache.h"
+#include "texture_decode.h"
+#include "texture_mips.h"
+#include "texture_bake.h"
+#include "mapped_file.h"
+#include "parseutil.h"
+
+namespace
+{
+	unsigned bits_per_pixel(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+			return 128;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		case DXGI_FORMAT_R16G16B16A16_UNORM:
+			return 64;
+		case DXGI_FORMAT_R16_FLOAT:
+		case DXGI_FORMAT_R16_UNORM:
+		case DXGI_FORMAT_B5G6R5_UNORM:
+		case DXGI_FORMAT_B5G5R5A1_UNORM:
+			return 16;
+		case DXGI_FORMAT_R8_UNORM:
+		case DXGI_FORMAT_A8_UNORM:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC5_UNORM:
+			return 8;
+		case DXGI_FORMAT_BC1_UNORM:
+			return 4;
+		case DXGI_FORMAT_R1_UNORM:
+			return 1;
+		default:
+			// 8-bit RGBA/BGRA and the other 32-bit formats the WIC loader creates
+			return 32;
+		}
+	}
+
+	//
+	// Device memory of a 2D texture, all mip levels
+	//
+	size_t texture_bytes(ID3D11Resource* texture)
+	{
+		ID3D11Texture2D* tex2d = nullptr;
+		if (FAILED(texture->QueryInterface(__uuidof(ID3D11Texture2D), (void**)&tex2d)))
+			return 0;
+		D3D11_TEXTURE2D_DESC desc;
+		tex2d->GetDesc(&desc);
+		tex2d->Release();
+
+		// block-compressed formats take whole 4x4 blocks
+		bool blocks = desc.Format == DXGI_FORMAT_BC1_UNORM || desc.Format == DXGI_FORMAT_BC3_UNORM || desc.Format == DXGI_FORMAT_BC5_UNORM;
+
+		size_t bits = 0;
+		for (UINT mip = 0; mip < desc.MipLevels; mip++)
+		{
+			size_t w = (std::max)(1u, desc.Width >> mip), h = (std::max)(1u, desc.Height >> mip);
+			if (blocks)
+				w = (w + 3) & ~3, h = (h + 3) & ~3;
+			bits += w * h * bits_per_pixel(desc.Format);
+		}
+		return bits / 8 * desc.ArraySize;
+	}
+
+	//
+	// Entries are keyed by content hash and mip mode: a file used both as color and as
+	// linear data is two textures
+	//
+	uint64_t entry_key(uint64_t content_hash, bool srgb)
+	{
+		return srgb ? content_hash : content_hash ^ 0x9e3779b97f4a7c15ull;
+	}
+}
+
+texture_cache_t& texture_cache_t::instance()
+{
+	static texture_cache_t cache;
+	return cache;
+}
+
+void texture_cache_t::acquire(	ID3D11Device* dxdevice,
+								ID3D11DeviceContext* dxdevice_context,
+								const std::string& filename,
+								ID3D11ShaderResourceView** slot)
+{
+	acquire(dxdevice, dxdevice_context, std::vector<std::string>(1, filename), std::vector<ID3D11ShaderResourceView**>(1, slot));
+}
+
+void texture_cache_t::acquire(	ID3D11Device* dxdevice,
+								ID3D11DeviceContext* dxdevice_context,
+								const std::vector<std::string>& filenames,
+								const std::vector<ID3D11ShaderResourceView**>& slots,
+								const std::vector<bool>& linear)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// entry key of each file; files not loaded yet are queued once per key
+	std::vector<uint64_t> keys(filenames.size());
+	std::vector<bool> readable(filenames.size(), true);
+	std::vector<std::string> queued_files;
+	std::vector<uint64_t> queued_hashes, queued_keys;
+	std::vector<bool> queued_srgb;
+
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		std::string path = canonical_path(filenames[i]);
+		uint64_t hash;
+		auto path_hash = path_hashes.find(path);
+		if (path_hash != path_hashes.end())
+			hash = path_hash->second;
+		else
+		{
+			mapped_file_t file(filenames[i]);
+			if (!file.is_open())
+			{
+				readable[i] = false;
+				continue;
+			}
+			hash = path_hashes[path] = file.content_hash();
+		}
+
+		bool srgb = linear.empty() || !linear[i];
+		keys[i] = entry_key(hash, srgb);
+		if (!entries.count(keys[i]) &&
+			std::find(queued_keys.begin(), queued_keys.end(), keys[i]) == queued_keys.end())
+		{
+			queued_files.push_back(filenames[i]);
+			queued_hashes.push_back(hash);
+			queued_keys.push_back(keys[i]);
+			queued_srgb.push_back(srgb);
+		}
+	}
+
+	// DDS files, such as texture atlases (texture_atlas.h), and up-to-date baked files
+	// (texture_bake.h) are loaded as they are, the rest decoded
+	std::vector<std::unique_ptr<mapped_file_t>> baked(queued_files.size());
+	std::vector<std::string> decode_files;
+	size_t nbr_baked = 0;
+	for (size_t q = 0; q < queued_files.size(); q++)
+	{
+		const std::string& file = queued_files[q];
+		bool dds = file.size() > 4 && equals_nocase(file.c_str() + file.size() - 4, ".dds", 4);
+		baked[q].reset(new mapped_file_t(dds ? file : baked_filename(file, !queued_srgb[q])));
+		uint64_t source_hash;
+		if (baked[q]->is_open() && (dds || (read_dds_source_hash(baked[q]->begin(), baked[q]->size(), source_hash) && source_hash == queued_hashes[q])))
+		{
+			decode_files.push_back(std::string());
+			nbr_baked++;
+		}
+		else
+		{
+			baked[q].reset();
+			decode_files.push_back(queued_files[q]);
+		}
+	}
+
+	// decode, build the mips, then upload
+	if (queued_files.size())
+	{
+		auto decode_start = std::chrono::high_resolution_clock::now();
+		std::vector<decoded_image_t> images;
+		if (nbr_baked < queued_files.size())
+			decode_images(decode_files, images, decode_threads);
+		else
+			images.resize(queued_files.size());
+		auto mips_start = std::chrono::high_resolution_clock::now();
+
+		std::vector<std::vector<decoded_image_t>> mips;
+		generate_mips(images, queued_srgb, mips, decode_threads);
+		auto upload_start = std::chrono::high_resolution_clock::now();
+
+		size_t decoded_bytes = 0;
+		for (size_t q = 0; q < queued_files.size(); q++)
+		{
+			entry_t entry;
+			HRESULT hr = E_FAIL;
+			if (baked[q])
+			{
+				hr = DirectX::CreateDDSTextureFromMemory(dxdevice, (const uint8_t*)baked[q]->begin(), baked[q]->size(), &entry.texture, &entry.view);
+				if (SUCCEEDED(hr))
+					entry.bytes = texture_bytes(entry.texture);
+			}
+			else if (mips[q].size() && streaming)
+			{
+				// uploaded from the levels the residency manager picks, below
+				entry.mips = std::move(mips[q]);
+				entry.residency_id = residency.add_texture(entry.mips[0].width, entry.mips[0].height, entry.mips[0].channels * 8);
+				if (residency_keys.size() <= entry.residency_id)
+					residency_keys.resize(entry.residency_id + 1);
+				residency_keys[entry.residency_id] = queued_keys[q];
+				hr = S_OK;
+			}
+			else if (mips[q].size())
+				hr = upload(dxdevice, mips[q], 0, entry);
+			printf("loading texture %s%s - %s\n", queued_files[q].c_str(), baked[q] ? " (baked)" : entry.mips.size() ? " (streamed)" : "", SUCCEEDED(hr) ? "OK" : "FAILED");
+			if (FAILED(hr))
+				continue;
+
+			decoded_bytes += images[q].pixels.size();
+			counters.bytes_resident += entry.bytes;
+			if (entry.view)
+				view_keys[entry.view] = queued_keys[q];
+			entries[queued_keys[q]] = std::move(entry);
+		}
+		// the tails of new streamed textures
+		if (streaming)
+			apply_residency(dxdevice);
+
+		auto upload_end = std::chrono::high_resolution_clock::now();
+		printf("Decoded %d textures (%.1f MB) in %.1f ms, %d baked, mips in %.1f ms, uploaded in %.1f ms\n",
+			(int)(queued_files.size() - nbr_baked), decoded_bytes / (1024.0 * 1024.0),
+			std::chrono::duration<double, std::milli>(mips_start - decode_start).count(), (int)nbr_baked,
+			std::chrono::duration<double, std::milli>(upload_start - mips_start).count(),
+			std::chrono::duration<double, std::milli>(upload_end - upload_start).count());
+	}
+
+	// hand out references; the first reference to a texture uploaded now is its miss
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		*slots[i] = nullptr;
+		auto e = readable[i] ? entries.find(keys[i]) : entries.end();
+		if (e == entries.end() || !e->second.view)
+		{
+			if (!readable[i])
+				printf("loading texture %s - FAILED\n", filenames[i].c_str());
+			counters.failures++;
+			continue;
+		}
+
+		if (e->second.refs++)
+		{
+			counters.hits++;
+			counters.bytes_saved += e->second.bytes;
+		}
+		else
+			counters.misses++;
+		*slots[i] = e->second.view;
+		e->second.slots.push_back(slots[i]);
+	}
+}
+
+//
+// Creates the texture of a decoded image from level top_mip of its mips (mips[0] the
+// image) down
+//
+HRESULT texture_cache_t::upload(	ID3D11Device* dxdevice,
+								const std::vector<decoded_image_t>& mips,
+								unsigned top_mip,
+								entry_t& entry)
+{
+	const decoded_image_t& top = mips[top_mip];
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = top.width;
+	desc.Height = top.height;
+	desc.MipLevels = (UINT)(mips.size() - top_mip);
+	desc.ArraySize = 1;
+	desc.Format = top.channels == 1 ? DXGI_FORMAT_R8_UNORM : DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> levels(desc.MipLevels);
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		levels[i].pSysMem = mips[top_mip + i].pixels.data();
+		levels[i].SysMemPitch = (UINT)mips[top_mip + i].row_pitch();
+	}
+
+	ID3D11Texture2D* texture = nullptr;
+	HRESULT hr = dxdevice->CreateTexture2D(&desc, levels.data(), &texture);
+	if (FAILED(hr))
+		return hr;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC view_desc = {};
+	view_desc.Format = desc.Format;
+	view_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	view_desc.Texture2D.MipLevels = (UINT)-1;
+
+	ID3D11ShaderResourceView* view = nullptr;
+	hr = dxdevice->CreateShaderResourceView(texture, &view_desc, &view);
+	if (FAILED(hr))
+	{
+		texture->Release();
+		return hr;
+	}
+
+	entry.texture = texture;
+	entry.view = view;
+	entry.bytes = texture_bytes(texture);
+	return S_OK;
+}
+
+//
+// Recreates the streamed textures whose resident levels changed
+//
+void texture_cache_t::apply_residency(ID3D11Device* dxdevice)
+{
+	for (auto& change : residency.update())
+	{
+		entry_t& entry = entries[residency_keys[change.texture]];
+		entry_t resized;
+		if (FAILED(upload(dxdevice, entry.mips, change.top_mip, resized)))
+		{
+			printf("streaming texture failed (%ux%u, level %u)\n", entry.mips[0].width, entry.mips[0].height, change.top_mip);
+			continue;
+		}
+
+		if (entry.view)
+			view_keys.erase(entry.view);
+		view_keys[resized.view] = residency_keys[change.texture];
+		for (auto slot : entry.slots)
+			*slot = resized.view;
+
+		SAFE_RELEASE(entry.view);
+		SAFE_RELEASE(entry.texture);
+		counters.bytes_resident += resized.bytes - entry.bytes;
+		entry.texture = resized.texture;
+		entry.view = resized.view;
+		entry.bytes = resized.bytes;
+	}
+}
+
+void texture_cache_t::release(ID3D11ShaderResourceView** slot)
+{
+	if (!slot || !*slot)
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto view_key = view_keys.find(*slot);
+	if (view_key == view_keys.end())
+		return;
+
+	auto e = entries.find(view_key->second);
+	auto& slots = e->second.slots;
+	auto s = std::find(slots.begin(), slots.end(), slot);
+	if (s != slots.end())
+		slots.erase(s);
+	*slot = nullptr;
+	if (--e->second.refs)
+		return;
+
+	if (e->second.residency_id != ~0u)
+		residency.remove_texture(e->second.residency_id);
+	counters.bytes_resident -= e->second.bytes;
+	SAFE_RELEASE(e->second.view);
+	SAFE_RELEASE(e->second.texture);
+	entries.erase(e);
+	view_keys.erase(view_key);
+}
+
+void texture_cache_t::begin_frame()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	residency.begin_frame();
+}
+
+void texture_cache_t::request(ID3D11ShaderResourceView* view, float screen_pixels)
+{
+	if (!view)
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto view_key = view_keys.find(view);
+	if (view_key == view_keys.end())
+		return;
+	const entry_t& entry = entries[view_key->second];
+	if (entry.residency_id != ~0u)
+		residency.request(entry.residency_id, screen_pixels);
+}
+
+void texture_cache_t::stream(ID3D11Device* dxdevice)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	apply_residency(dxdevice);
+}
+
+texture_cache_t::stats_t texture_cache_t::stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return counters;
+}
+
+void texture_cache_t::print_stats() const
+{
+	stats_t s = stats();
+	printf("Texture cache: %u hits, %u misses, %u failed\n\t%.1f MB resident, %.1f MB saved by sharing\n",
+		s.hits, s.misses, s.failures, s.bytes_resident / (1024.0 * 1024.0), s.bytes_saved / (1024.0 * 1024.0));
+
+	if (streaming)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		const texture_residency_t::stats_t& r = residency.stats();
+		printf("\tstreaming: %.1f of %.1f MB budget resident (%.1f MB wanted), %u levels loaded (%.1f MB), %u evicted\n",
+			r.resident_bytes / (1024.0 * 1024.0), residency.budget / (1024.0 * 1024.0), r.wanted_bytes / (1024.0 * 1024.0),
+			r.loads, r.loaded_bytes / (1024.0 * 1024.0), r.evictions);
+	}
+}
@@ -0,0 +1,126 @@
+//
+//  texture_cache.h
+//
+//	Process-wide cache of device textures loaded from image files
+//
+
+#pragma once
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include "stdafx.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "texture_decode.h"
+#include "texture_residency.h"
+
+//
+// Textures are looked up by canonical path, then by the content hash of the file and
+// whether it is color or linear data, so different paths to the same file, and
+// identical copies of a file, share one device texture per use. Each acquire() adds a reference and must be paired with a release(); the
+// texture is freed with its last reference.
+//
+// With streaming on, decoded textures keep their mips in system memory, and only the
+// levels the residency manager (texture_residency.h) picks are on the device. Users
+// request the textures they draw each frame, and stream() recreates the textures whose
+// levels changed, writing the new views to the slots they were acquired to.
+//
+class texture_cache_t
+{
+	struct entry_t
+	{
+		ID3D11Resource* texture = nullptr;
+		ID3D11ShaderResourceView* view = nullptr;
+		unsigned refs = 0;
+		size_t bytes = 0;
+
+		// streamed textures: all levels, the id in residency, and the slots to update
+		std::vector<decoded_image_t> mips;
+		unsigned residency_id = ~0u;
+		std::vector<ID3D11ShaderResourceView**> slots;
+	};
+
+	// canonical path -> content hash, for files seen before
+	std::unordered_map<std::string, uint64_t> path_hashes;
+	// content hash and mip mode -> loaded texture
+	std::unordered_map<uint64_t, entry_t> entries;
+	std::unordered_map<ID3D11ShaderResourceView*, uint64_t> view_keys;
+	// residency id -> entry key, for streamed textures
+	std::vector<uint64_t> residency_keys;
+	mutable std::mutex mutex;
+
+	texture_cache_t() { }
+
+public:
+
+	struct stats_t
+	{
+		unsigned hits = 0, misses = 0, failures = 0;
+		size_t bytes_resident = 0;	// device memory of the textures loaded now
+		size_t bytes_saved = 0;		// device memory hits would have taken as separate copies
+	};
+
+	// threads decoding the files of a batch and building their mips: 0 = one per core,
+	// 1 = the calling thread only
+	unsigned decode_threads = 0;
+
+	// set before the first acquire(); budget and upload limits are in residency
+	bool streaming = false;
+	texture_residency_t residency;
+
+	static texture_cache_t& instance();
+
+	//
+	// Writes the view of the texture in filename, loaded (with mipmaps) on first use, to
+	// *slot; nullptr if the file can not be read or decoded. The slot must stay in place
+	// until released, since streaming may replace the view.
+	//
+	void acquire(	ID3D11Device* dxdevice,
+					ID3D11DeviceContext* dxdevice_context,
+					const std::string& filename,
+					ID3D11ShaderResourceView** slot);
+
+	//
+	// acquire() for several files at once: the files not loaded yet are decoded and get
+	// their mips in parallel (texture_decode.h, texture_mips.h), then are uploaded together
+	// on the calling thread.
+	//
+	// linear: flags files holding linear data, such as bump maps and opacity masks, whose
+	// mips are averaged as they are; the rest are sRGB color, averaged as linear
+	// intensities. All color if empty.
+	//
+	void acquire(	ID3D11Device* dxdevice,
+					ID3D11DeviceContext* dxdevice_context,
+					const std::vector<std::string>& filenames,
+					const std::vector<ID3D11ShaderResourceView**>& slots,
+					const std::vector<bool>& linear = std::vector<bool>());
+
+	void release(ID3D11ShaderResourceView** slot);
+
+	//
+	// Streaming, once per frame: begin_frame(), request() for each texture drawn, with the
+	// pixels it covers on screen (texture_residency_t::request), then stream()
+	//
+	void begin_frame();
+	void request(ID3D11ShaderResourceView* view, float screen_pixels);
+	void stream(ID3D11Device* dxdevice);
+
+	stats_t stats() const;
+	void print_stats() const;
+
+private:
+
+	stats_t counters;
+
+	HRESULT upload(	ID3D11Device* dxdevice,
+					const std::vector<decoded_image_t>& mips,
+					unsigned top_mip,
+					entry_t& entry);
+
+	void apply_residency(ID3D11Device* dxdevice);
+};
+
+#endif
@@ -0,0 +1,74 @@
+//
+//  texture_decode.cpp
+//
+//	CPU-side decoding of image files, independent of the device
+//
+
+#include <windows.h>
+#include <wincodec.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include "texture_decode.h"
+#include "mapped_file.h"
+#include "parallel.h"
+
+#define SAFE_RELEASE(x) if( x ) { (x)->Release(); (x) = nullptr; }
+
+bool decode_image(const void* data, size_t size, decoded_image_t& image)
+{
+	// COM is initialized per call, so callers need not know about it
+	HRESULT com_hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	IWICImagingFactory* factory = nullptr;
+	IWICStream* stream = nullptr;
+	IWICBitmapDecoder* decoder = nullptr;
+	IWICBitmapFrameDecode* frame = nullptr;
+	IWICFormatConverter* converter = nullptr;
+	UINT width = 0, height = 0;
+
+	HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory));
+	if (SUCCEEDED(hr)) hr = factory->CreateStream(&stream);
+	if (SUCCEEDED(hr)) hr = stream->InitializeFromMemory((BYTE*)data, (DWORD)size);
+	if (SUCCEEDED(hr)) hr = factory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder);
+	if (SUCCEEDED(hr)) hr = decoder->GetFrame(0, &frame);
+	if (SUCCEEDED(hr)) hr = frame->GetSize(&width, &height);
+	if (SUCCEEDED(hr)) hr = factory->CreateFormatConverter(&converter);
+	if (SUCCEEDED(hr)) hr = converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+	if (SUCCEEDED(hr))
+	{
+		image.width = width;
+		image.height = height;
+		image.pixels.resize((size_t)width * height * 4);
+		hr = converter->CopyPixels(nullptr, (UINT)image.row_pitch(), (UINT)image.pixels.size(), image.pixels.data());
+	}
+	if (FAILED(hr))
+		image = decoded_image_t();
+
+	SAFE_RELEASE(converter);
+	SAFE_RELEASE(frame);
+	SAFE_RELEASE(decoder);
+	SAFE_RELEASE(stream);
+	SAFE_RELEASE(factory);
+	if (SUCCEEDED(com_hr))
+		CoUninitialize();
+
+	return SUCCEEDED(hr);
+}
+
+size_t decode_images(	const std::vector<std::string>& files,
+						std::vector<decoded_image_t>& images,
+						unsigned nbr_threads)
+{
+	images.assign(files.size(), decoded_image_t());
+
+	// files are handed out one at a time, since their decode times differ a lot
+	std::atomic<size_t> nbr_decoded(0);
+	parallel_for_each(files.size(), nbr_threads, [&](size_t i)
+	{
+		mapped_file_t file(files[i]);
+		if (file.is_open() && decode_image(file.begin(), file.size(), images[i]))
+			nbr_decoded++;
+	});
+	return nbr_decoded;
+}
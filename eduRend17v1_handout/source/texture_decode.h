@@ -0,0 +1,41 @@
+//
+//  texture_decode.h
+//
+//	CPU-side decoding of image files, independent of the device
+//
+
+#pragma once
+#ifndef TEXTURE_DECODE_H
+#define TEXTURE_DECODE_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+//
+// Image of 8-bit channels, rows tightly packed: RGBA (4 channels) as decoded, or R8 (1)
+//
+struct decoded_image_t
+{
+	unsigned width = 0, height = 0;
+	unsigned channels = 4;
+	std::vector<uint8_t> pixels;
+
+	size_t row_pitch() const { return (size_t)width * channels; }
+};
+
+//
+// Decodes an image file (any format WIC reads: png, jpg, bmp, tiff, gif, ...) from memory.
+// Needs no device, and may be called from any thread.
+//
+bool decode_image(const void* data, size_t size, decoded_image_t& image);
+
+//
+// Decodes files[i] to images[i] on up to nbr_threads threads (0 = one per core).
+// Returns the number of files decoded; images of files that fail are left empty.
+//
+size_t decode_images(	const std::vector<std::string>& files,
+						std::vector<decoded_image_t>& images,
+						unsigned nbr_threads = 0);
+
+#endif
@@ -0,0 +1,602 @@
+//
+//  texture_mips.cpp
+//
+//	Mip chains of decoded images
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include "texture_mips.h"
+#include "parallel.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define MIPS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+	double srgb_decode(double c)
+	{
+		return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+	}
+
+	struct srgb_tables_t
+	{
+		float to_linear[256];
+		// to_srgb_threshold[k]: smallest linear value that rounds to k or more, at the
+		// midpoint between k - 1 and k in sRGB
+		float to_srgb_threshold[256];
+
+		srgb_tables_t()
+		{
+			for (int k = 0; k < 256; k++)
+			{
+				to_linear[k] = (float)srgb_decode(k / 255.0);
+				to_srgb_threshold[k] = (float)srgb_decode((k - 0.5) / 255.0);
+			}
+			to_srgb_threshold[0] = -1.0f;
+		}
+	};
+
+	const srgb_tables_t& srgb_tables()
+	{
+		static srgb_tables_t tables;
+		return tables;
+	}
+
+	//
+	// Integer version for the kernels: the four linear values of a 2x2 box are summed in
+	// fixed point, and the sum is mapped back to sRGB through buckets of its top bits.
+	// The buckets are narrower than the smallest step between sRGB values, so each holds
+	// at most one step, and one compare finds the value.
+	//
+	struct srgb_fixed_tables_t
+	{
+		static const int LINEAR_BITS = 24;
+		static const int BUCKET_SHIFT = 14;
+		static const int NBR_BUCKETS = (4 << LINEAR_BITS >> BUCKET_SHIFT) + 1;
+
+		// 8-bit sRGB -> linear, 1.0 = 1 << LINEAR_BITS
+		int32_t to_linear[256];
+		// sRGB value at the start of each bucket, and the sum where the next one starts
+		int32_t bucket_base[NBR_BUCKETS];
+		int32_t bucket_next[NBR_BUCKETS];
+
+		srgb_fixed_tables_t()
+		{
+			const double one = 1 << LINEAR_BITS;
+			// averages exactly at a midpoint, as in the linear part of the curve, round up
+			// even if the rounding of the four table values puts the sum slightly below it
+			int32_t threshold[257];
+			for (int k = 0; k < 256; k++)
+			{
+				to_linear[k] = (int32_t)floor(srgb_decode(k / 255.0) * one + 0.5);
+				threshold[k] = (int32_t)ceil(srgb_decode((k - 0.5) / 255.0) * 4 * one) - 2;
+			}
+			threshold[0] = 0;
+			threshold[256] = INT32_MAX;
+
+			int base = 0;
+			for (int i = 0; i < NBR_BUCKETS; i++)
+			{
+				while (base < 255 && threshold[base + 1] <= i << BUCKET_SHIFT)
+					base++;
+				bucket_base[i] = base;
+				bucket_next[i] = threshold[base + 1];
+			}
+		}
+
+		uint8_t average(uint8_t a, uint8_t b, uint8_t c, uint8_t d) const
+		{
+			int32_t sum = to_linear[a] + to_linear[b] + to_linear[c] + to_linear[d];
+			int bucket = sum >> BUCKET_SHIFT;
+			return (uint8_t)(bucket_base[bucket] + (sum >= bucket_next[bucket]));
+		}
+	};
+
+	const srgb_fixed_tables_t& srgb_fixed_tables()
+	{
+		static srgb_fixed_tables_t tables;
+		return tables;
+	}
+
+	//
+	// Row kernels: n pixels of out from 2n pixels of each of two source rows
+	//
+	typedef void(*row_kernel_t)(const uint8_t* row0, const uint8_t* row1, uint8_t* out, unsigned n);
+
+	struct kernel_set_t
+	{
+		const char* name;
+		row_kernel_t linear_rgba, linear_r8, srgb_rgba, srgb_r8;
+	};
+
+	template<int CHANNELS>
+	void linear_scalar(const uint8_t* row0, const uint8_t* row1, uint8_t* out, unsigned n)
+	{
+		for (unsigned i = 0; i < n * CHANNELS; i++)
+		{
+			unsigned s = i / CHANNELS * CHANNELS * 2 + i % CHANNELS;
+			out[i] = (uint8_t)((row0[s] + row0[s + CHANNELS] + row1[s] + row1[s + CHANNELS] + 2) >> 2);
+		}
+	}
+
+	template<int CHANNELS>
+	void srgb_scalar(const uint8_t* row0, const uint8_t* row1, uint8_t* out, unsigned n)
+	{
+		const srgb_fixed_tables_t& t = srgb_fixed_tables();
+		for (unsigned i = 0; i < n * CHANNELS; i++)
+		{
+			unsigned s = i / CHANNELS * CHANNELS * 2 + i % CHANNELS;
+			if (CHANNELS == 4 && i % 4 == 3)
+				out[i] = (uint8_t)((row0[s] + row0[s + CHANNELS] + row1[s] + row1[s + CHANNELS] + 2) >> 2);
+			else
+				out[i] = t.average(row0[s], row0[s + CHANNELS], row1[s], row1[s + CHANNELS]);
+		}
+	}
+
+	const kernel_set_t scalar_kernels = { "scalar", linear_scalar<4>, linear_scalar<1>, srgb_scalar<4>, srgb_scalar<1> };
+
+#ifdef MIPS_X86
+	//
+	// SSE2: the 16-bit sums of 4 pixels of two rows, pairs of RGBA pixels added by
+	// swapping 64-bit halves, or pairs of R8 pixels by splitting odd and even bytes
+	//
+	__m128i box_rgba_sse2(__m128i a, __m128i b)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+		__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+		__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+		return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+	}
+
+	__m128i box_r8_sse2(__m128i a, __m128i b)
+	{
+		const __m128i even = _mm_set1_epi16(0x00ff);
+		__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, even), _mm_srli_epi16(a, 8)),
+			_mm_add_epi16(_mm_and_si128(b, even), _mm_srli_epi16(b, 8)));
+		return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+	}
+
+	void linear_rgba_sse2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, unsigned n)
+	{
+		unsigned x = 0;
+		for (; x + 4 <= n; x += 4)
+		{
+			const uint8_t *a = row0 + x * 8, *b = row1 + x * 8;
+			__m128i lo = box_rgba_sse2(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b));
+			__m128i hi = box_rgba_sse2(_mm_loadu_si128((const __m128i*)(a + 16)), _mm_loadu_si128((const __m128i*)(b + 16)));
+			_mm_storeu_si128((__m128i*)(out + x * 4), _mm_packus_epi16(lo, hi));
+		}
+		linear_scalar<4>(row0 + x * 8, row1 + x * 8, out + x * 4, n - x);
+	}
+
+	void linear_r8_sse2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, unsigned n)
+	{
+		unsigned x = 0;
+		for (; x + 16 <= n; x += 16)
+		{
+			const uint8_t *a = row0 + x * 2, *b = row1 + x * 2;
+			__m128i lo = box_r8_sse2(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b));
+			__m128i hi = box_r8_sse2(_mm_loadu_si128((const __m128i*)(a + 16)), _mm_loadu_si128((const __m128i*)(b + 16)));
+			_mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(lo, hi));
+		}
+		linear_scalar<1>(row0 + x * 2, row1 + x * 2, out + x, n - x);
+	}
+
+	// SSE2 has no gathers, so sRGB rows go through the table lookups one value at a time
+	const kernel_set_t sse2_kernels = { "SSE2", linear_rgba_sse2, linear_r8_sse2, srgb_scalar<4>, srgb_scalar<1> };
+
+	//
+	// AVX2: as SSE2 on two 128-bit lanes, reordered with a 64-bit permute; sRGB values are
+	// looked up with gathers, a channel per 32-bit lane
+	//
+	TARGET_AVX2 __m256i box_rgba_avx2(__m256i a, __m256i b)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+		__m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+		__m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+		return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+	}
+
+	TARGET_AVX2 __m256i box_r8_avx2(__m256i a, __m256i b)
+	{
+		const __m256i even = _mm256_set1_epi16(0x00ff);
+		__m256i sum = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(a, even), _mm256_srli_epi16(a, 8)),
+			_mm256_add_epi16(_mm256_and_si256(b, even), _mm256_srli_epi16(b, 8)));
+		return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+	}
+
+	TARGET_AVX2 void linear_rgba_avx2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, unsigned n)
+	{
+		unsigned x = 0;
+		for (; x + 8 <= n; x += 8)
+		{
+			const uint8_t *a = row0 + x * 8, *b = row1 + x * 8;
+			__m256i lo = box_rgba_avx2(_mm256_loadu_si256((const __m256i*)a), _mm256_loadu_si256((const __m256i*)b));
+			__m256i hi = box_rgba_avx2(_mm256_loadu_si256((const __m256i*)(a + 32)), _mm256_loadu_si256((const __m256i*)(b + 32)));
+			_mm256_storeu_si256((__m256i*)(out + x * 4), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xd8));
+		}
+		linear_rgba_sse2(row0 + x * 8, row1 + x * 8, out + x * 4, n - x);
+	}
+
+	TARGET_AVX2 void linear_r8_avx2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, unsigned n)
+	{
+		unsigned x = 0;
+		for (; x + 32 <= n; x += 32)
+		{
+			const uint8_t *a = row0 + x * 2, *b = row1 + x * 2;
+			__m256i lo = box_r8_avx2(_mm256_loadu_si256((const __m256i*)a), _mm256_loadu_si256((const __m256i*)b));
+			__m256i hi = box_r8_avx2(_mm256_loadu_si256((const __m256i*)(a + 32)), _mm256_loadu_si256((const __m256i*)(b + 32)));
+			_mm256_storeu_si256((__m256i*)(out + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xd8));
+		}
+		linear_r8_sse2(row0 + x * 2, row1 + x * 2, out + x, n - x);
+	}
+
+	// sums of 32-bit lanes [v0.lo + v0.hi, v1.lo + v1.hi], for adjacent RGBA pixels
+	TARGET_AVX2 __m256i pair_sums_avx2(__m256i v0, __m256i v1)
+	{
+		return _mm256_add_epi32(_mm256_permute2x128_si256(v0, v1, 0x20), _mm256_permute2x128_si256(v0, v1, 0x31));
+	}
+
+	TARGET_AVX2 __m256i gather_linear_avx2(__m256i v)
+	{
+		return _mm256_i32gather_epi32(srgb_fixed_tables().to_linear, v, 4);
+	}
+
+	// sum of four linear values in each lane -> sRGB
+	TARGET_AVX2 __m256i to_srgb_avx2(__m256i sum)
+	{
+		const srgb_fixed_tables_t& t = srgb_fixed_tables();
+		__m256i bucket = _mm256_srli_epi32(sum, srgb_fixed_tables_t::BUCKET_SHIFT);
+		__m256i base = _mm256_i32gather_epi32(t.bucket_base, bucket, 4);
+		__m256i next = _mm256_i32gather_epi32(t.bucket_next, bucket, 4);
+		// base + (sum >= next)
+		return _mm256_add_epi32(_mm256_add_epi32(base, _mm256_set1_epi32(1)), _mm256_cmpgt_epi32(next, sum));
+	}
+
+	// the bytes of 4 32-bit lanes in each half -> 8 bytes
+	TARGET_AVX2 void store_bytes_avx2(uint8_t* out, __m256i v)
+	{
+		v = _mm256_packus_epi32(v, v);
+		v = _mm256_packus_epi16(v, v);
+		int lo = _mm_cvtsi128_si32(_mm256_castsi256_si128(v)), hi = _mm_cvtsi128_si32(_mm256_extracti128_si256(v, 1));
+		memcpy(out, &lo, 4);
+		memcpy(out + 4, &hi, 4);
+	}
+
+	TARGET_AVX2 void srgb_rgba_avx2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, unsigned n)
+	{
+		const __m256i alpha = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+		unsigned x = 0;
+		for (; x + 2 <= n; x += 2)
+		{
+			// 4 pixels of each row, a channel per lane
+			__m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+			__m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+			__m256i a0 = _mm256_cvtepu8_epi32(a), a1 = _mm256_cvtepu8_epi32(_mm_srli_si128(a, 8));
+			__m256i b0 = _mm256_cvtepu8_epi32(b), b1 = _mm256_cvtepu8_epi32(_mm_srli_si128(b, 8));
+
+			__m256i linear = _mm256_add_epi32(
+				pair_sums_avx2(gather_linear_avx2(a0), gather_linear_avx2(a1)),
+				pair_sums_avx2(gather_linear_avx2(b0), gather_linear_avx2(b1)));
+			__m256i raw = _mm256_add_epi32(pair_sums_avx2(a0, a1), pair_sums_avx2(b0, b1));
+			raw = _mm256_srli_epi32(_mm256_add_epi32(raw, _mm256_set1_epi32(2)), 2);
+
+			store_bytes_avx2(out + x * 4, _mm256_blendv_epi8(to_srgb_avx2(linear), raw, alpha));
+		}
+		srgb_scalar<4>(row0 + x * 8, row1 + x * 8, out + x * 4, n - x);
+	}
+
+	TARGET_AVX2 void srgb_r8_avx2(const uint8_t* row0, const uint8_t* row1, uint8_t* out, unsigned n)
+	{
+		unsigned x = 0;
+		for (; x + 8 <= n; x += 8)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 2));
+			__m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 2));
+			__m256i a0 = gather_linear_avx2(_mm256_cvtepu8_epi32(a)), a1 = gather_linear_avx2(_mm256_cvtepu8_epi32(_mm_srli_si128(a, 8)));
+			__m256i b0 = gather_linear_avx2(_mm256_cvtepu8_epi32(b)), b1 = gather_linear_avx2(_mm256_cvtepu8_epi32(_mm_srli_si128(b, 8)));
+
+			// adjacent pairs, in the order 0 1 4 5 | 2 3 6 7
+			__m256i linear = _mm256_add_epi32(_mm256_hadd_epi32(a0, a1), _mm256_hadd_epi32(b0, b1));
+			store_bytes_avx2(out + x, _mm256_permute4x64_epi64(to_srgb_avx2(linear), 0xd8));
+		}
+		srgb_scalar<1>(row0 + x * 2, row1 + x * 2, out + x, n - x);
+	}
+
+	const kernel_set_t avx2_kernels = { "AVX2", linear_rgba_avx2, linear_r8_avx2, srgb_rgba_avx2, srgb_r8_avx2 };
+
+	bool cpu_has_avx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		// AVX enabled by the OS (XMM and YMM state saved), then AVX2
+		__cpuid(info, 1);
+		if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+#endif
+
+	const kernel_set_t& kernel_set(mip_kernels_t kernels)
+	{
+#ifdef MIPS_X86
+		static const bool has_avx2 = cpu_has_avx2();
+		if (kernels == MIP_KERNELS_SCALAR)
+			return scalar_kernels;
+		if (kernels == MIP_KERNELS_SSE2 || !has_avx2)
+			return sse2_kernels;
+		return avx2_kernels;
+#else
+		return scalar_kernels;
+#endif
+	}
+
+	//
+	// Rows [y0, y1) of the level below src
+	//
+	void downsample_rows(	const decoded_image_t& src,
+							decoded_image_t& dst,
+							row_kernel_t kernel,
+							unsigned y0,
+							unsigned y1)
+	{
+		uint8_t column[2][8];
+		for (unsigned y = y0; y < y1; y++)
+		{
+			const uint8_t* row0 = src.pixels.data() + (size_t)std::min(y * 2, src.height - 1) * src.row_pitch();
+			const uint8_t* row1 = src.pixels.data() + (size_t)std::min(y * 2 + 1, src.height - 1) * src.row_pitch();
+			uint8_t* out = dst.pixels.data() + (size_t)y * dst.row_pitch();
+
+			// the kernels take pixel pairs, which a single column repeats
+			if (src.width == 1)
+			{
+				memcpy(column[0], row0, src.channels);
+				memcpy(column[0] + src.channels, row0, src.channels);
+				memcpy(column[1], row1, src.channels);
+				memcpy(column[1] + src.channels, row1, src.channels);
+				row0 = column[0];
+				row1 = column[1];
+			}
+			kernel(row0, row1, out, dst.width);
+		}
+	}
+
+	unsigned nbr_mip_levels(unsigned width, unsigned height)
+	{
+		unsigned levels = 1;
+		while (width > 1 || height > 1)
+		{
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+			levels++;
+		}
+		return levels;
+	}
+}
+
+float srgb_to_linear(uint8_t c)
+{
+	return srgb_tables().to_linear[c];
+}
+
+uint8_t linear_to_srgb(float l)
+{
+	// largest k with threshold[k] <= l
+	const float* t = srgb_tables().to_srgb_threshold;
+	int k = 0;
+	for (int step = 128; step; step >>= 1)
+		if (t[k + step] <= l)
+			k += step;
+	return (uint8_t)k;
+}
+
+void generate_mips(	const decoded_image_t& image,
+					bool srgb,
+					std::vector<decoded_image_t>& mips,
+					unsigned nbr_threads,
+					mip_kernels_t kernels)
+{
+	const kernel_set_t& set = kernel_set(kernels);
+	row_kernel_t kernel = image.channels == 4 ? (srgb ? set.srgb_rgba : set.linear_rgba) : (srgb ? set.srgb_r8 : set.linear_r8);
+
+	// all levels up front, so they stay in place while the next is built
+	mips.resize(nbr_mip_levels(image.width, image.height));
+	mips[0] = image;
+	for (size_t level = 1; level < mips.size(); level++)
+	{
+		const decoded_image_t& src = mips[level - 1];
+		decoded_image_t& dst = mips[level];
+		dst.width = std::max(1u, src.width / 2);
+		dst.height = std::max(1u, src.height / 2);
+		dst.channels = src.channels;
+		dst.pixels.resize(dst.row_pitch() * dst.height);
+
+		// threads only for levels big enough to pay for them
+		const size_t min_bytes_per_thread = 256 * 1024;
+		size_t min_rows_per_thread = (min_bytes_per_thread + dst.row_pitch() - 1) / dst.row_pitch();
+		parallel_for(dst.height, nbr_threads, min_rows_per_thread, [&](size_t y0, size_t y1)
+		{
+			downsample_rows(src, dst, kernel, (unsigned)y0, (unsigned)y1);
+		});
+	}
+}
+
+void generate_mips(	const std::vector<decoded_image_t>& images,
+					const std::vector<bool>& srgb,
+					std::vector<std::vector<decoded_image_t>>& mips,
+					unsigned nbr_threads)
+{
+	mips.assign(images.size(), std::vector<decoded_image_t>());
+	nbr_threads = thread_count(nbr_threads);
+
+	// largest first, so the big images do not end up last on one thread
+	std::vector<size_t> order;
+	for (size_t i = 0; i < images.size(); i++)
+		if (images[i].pixels.size())
+			order.push_back(i);
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return images[a].pixels.size() > images[b].pixels.size(); });
+
+	// with fewer images than threads, the rest of the threads split the rows of each level
+	unsigned nbr_workers = (unsigned)std::min<size_t>(nbr_threads, order.size());
+	unsigned threads_per_image = nbr_workers ? std::max(1u, nbr_threads / nbr_workers) : 1;
+
+	parallel_for_each(order.size(), nbr_workers, [&](size_t i)
+	{
+		generate_mips(images[order[i]], srgb[order[i]], mips[order[i]], threads_per_image);
+	});
+}
+
+void generate_mips_reference(const decoded_image_t& image, bool srgb, std::vector<decoded_image_t>& mips)
+{
+	mips.assign(1, image);
+	const float* to_linear = srgb_tables().to_linear;
+	const unsigned channels = image.channels;
+
+	while (mips.back().width > 1 || mips.back().height > 1)
+	{
+		const decoded_image_t& src = mips.back();
+		decoded_image_t dst;
+		dst.width = std::max(1u, src.width / 2);
+		dst.height = std::max(1u, src.height / 2);
+		dst.channels = channels;
+		dst.pixels.resize(dst.row_pitch() * dst.height);
+
+		for (unsigned y = 0; y < dst.height; y++)
+		{
+			const uint8_t* row0 = src.pixels.data() + (size_t)std::min(y * 2, src.height - 1) * src.row_pitch();
+			const uint8_t* row1 = src.pixels.data() + (size_t)std::min(y * 2 + 1, src.height - 1) * src.row_pitch();
+			uint8_t* out = dst.pixels.data() + (size_t)y * dst.row_pitch();
+
+			for (unsigned x = 0; x < dst.width; x++, out += channels)
+			{
+				size_t x0 = std::min(x * 2, src.width - 1) * channels, x1 = std::min(x * 2 + 1, src.width - 1) * channels;
+				for (unsigned c = 0; c < channels; c++)
+				{
+					if (srgb && (channels != 4 || c < 3))
+					{
+						float l = (to_linear[row0[x0 + c]] + to_linear[row0[x1 + c]] + to_linear[row1[x0 + c]] + to_linear[row1[x1 + c]]) * 0.25f;
+						out[c] = linear_to_srgb(l);
+					}
+					else
+						out[c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+				}
+			}
+		}
+		// src is invalidated by the push
+		mips.push_back(std::move(dst));
+	}
+}
+
+void benchmark_mips(const std::vector<std::string>& files, unsigned nbr_threads)
+{
+	typedef std::chrono::high_resolution_clock clock;
+	auto ms_since = [](clock::time_point start) { return std::chrono::duration<double, std::milli>(clock::now() - start).count(); };
+
+	std::vector<decoded_image_t> rgba;
+	decode_images(files, rgba, nbr_threads);
+	rgba.erase(std::remove_if(rgba.begin(), rgba.end(), [](const decoded_image_t& image) { return image.pixels.empty(); }), rgba.end());
+
+	// R8 images from the red channels
+	std::vector<decoded_image_t> r8(rgba.size());
+	size_t nbr_pixels = 0;
+	for (size_t i = 0; i < rgba.size(); i++)
+	{
+		r8[i].width = rgba[i].width;
+		r8[i].height = rgba[i].height;
+		r8[i].channels = 1;
+		r8[i].pixels.resize(rgba[i].pixels.size() / 4);
+		for (size_t p = 0; p < r8[i].pixels.size(); p++)
+			r8[i].pixels[p] = rgba[i].pixels[p * 4];
+		nbr_pixels += r8[i].pixels.size();
+	}
+	printf("Mip generation, %d of %d images decoded (%.1f Mpixels)\n", (int)rgba.size(), (int)files.size(), nbr_pixels / 1e6);
+	if (rgba.empty())
+		return;
+
+	// best of a few runs, single-threaded
+	const int nbr_runs = 3;
+	auto time_mips = [&](const decoded_image_t& image, bool srgb, int kernels, std::vector<decoded_image_t>& mips)
+	{
+		double best = 0;
+		for (int run = 0; run < nbr_runs; run++)
+		{
+			// into new memory every run, as when loading
+			std::vector<decoded_image_t> run_mips;
+			auto start = clock::now();
+			if (kernels < 0)
+				generate_mips_reference(image, srgb, run_mips);
+			else
+				generate_mips(image, srgb, run_mips, 1, (mip_kernels_t)kernels);
+			double ms = ms_since(start);
+			mips.swap(run_mips);
+			best = run ? std::min(best, ms) : ms;
+		}
+		return best;
+	};
+
+	struct format_t { const char* name; std::vector<decoded_image_t>& images; bool srgb; };
+	format_t formats[] = { { "RGBA sRGB", rgba, true }, { "RGBA linear", rgba, false }, { "R8 linear", r8, false } };
+	int kernel_sets[] = { MIP_KERNELS_SCALAR, MIP_KERNELS_SSE2, MIP_KERNELS_AVX2 };
+
+	for (auto& format : formats)
+	{
+		std::vector<std::vector<decoded_image_t>> reference(format.images.size());
+		double reference_ms = 0;
+		for (size_t i = 0; i < format.images.size(); i++)
+			reference_ms += time_mips(format.images[i], format.srgb, -1, reference[i]);
+		printf("%s:\n\t%-10s %8.1f ms %8.1f Mpixels/s\n", format.name, "reference", reference_ms, nbr_pixels / (reference_ms * 1000.0));
+
+		for (int kernels : kernel_sets)
+		{
+			double ms = 0;
+			size_t nbr_different = 0, nbr_bytes = 0;
+			int max_difference = 0;
+			std::vector<decoded_image_t> mips;
+			for (size_t i = 0; i < format.images.size(); i++)
+			{
+				ms += time_mips(format.images[i], format.srgb, kernels, mips);
+				for (size_t level = 1; level < mips.size(); level++)
+					for (size_t b = 0; b < mips[level].pixels.size(); b++)
+					{
+						int difference = abs(mips[level].pixels[b] - reference[i][level].pixels[b]);
+						max_difference = std::max(max_difference, difference);
+						nbr_different += difference != 0;
+						nbr_bytes++;
+					}
+			}
+			printf("\t%-10s %8.1f ms %8.1f Mpixels/s  x%-5.1f max difference %d (%.4f%% of values)\n",
+				kernel_set((mip_kernels_t)kernels).name, ms, nbr_pixels / (ms * 1000.0), reference_ms / ms,
+				max_difference, nbr_bytes ? 100.0 * nbr_different / nbr_bytes : 0.0);
+		}
+
+		// all images at once, best kernels
+		std::vector<std::vector<decoded_image_t>> mips;
+		auto start = clock::now();
+		generate_mips(format.images, std::vector<bool>(format.images.size(), format.srgb), mips, nbr_threads);
+		double ms = ms_since(start);
+		printf("\t%-10s %8.1f ms %8.1f Mpixels/s  x%-5.1f (%u threads)\n", "batch", ms, nbr_pixels / (ms * 1000.0), reference_ms / ms,
+			thread_count(nbr_threads));
+	}
+}
@@ -0,0 +1,70 @@
+//
+//  texture_mips.h
+//
+//	Mip chains of decoded images
+//
+
+#pragma once
+#ifndef TEXTURE_MIPS_H
+#define TEXTURE_MIPS_H
+
+#include <vector>
+#include <string>
+#include "texture_decode.h"
+
+//
+// Row kernels used by generate_mips; MIP_KERNELS_BEST picks the widest the CPU supports,
+// and the others fall back to the next narrower set if unsupported
+//
+enum mip_kernels_t
+{
+	MIP_KERNELS_SCALAR,
+	MIP_KERNELS_SSE2,
+	MIP_KERNELS_AVX2,
+	MIP_KERNELS_BEST
+};
+
+//
+// Full mip chain of an RGBA8 or R8 image, down to 1x1: mips[0] is the image itself, and
+// each level is a 2x2 box filter of the one above, halving odd sizes downwards.
+//
+// srgb: the color channels (all but alpha) hold sRGB-encoded values, which are averaged
+// as linear intensities; alpha is always averaged as it is.
+//
+// Levels are built in order, each from the one above, with the rows of a level split
+// between up to nbr_threads threads (0 = one per core).
+//
+void generate_mips(	const decoded_image_t& image,
+					bool srgb,
+					std::vector<decoded_image_t>& mips,
+					unsigned nbr_threads = 1,
+					mip_kernels_t kernels = MIP_KERNELS_BEST);
+
+//
+// generate_mips for several images, spread over up to nbr_threads threads (0 = one per
+// core); mips[i] is the chain of images[i], empty if the image is
+//
+void generate_mips(	const std::vector<decoded_image_t>& images,
+					const std::vector<bool>& srgb,
+					std::vector<std::vector<decoded_image_t>>& mips,
+					unsigned nbr_threads = 0);
+
+//
+// Straightforward float version of generate_mips, which the kernels are checked against
+//
+void generate_mips_reference(const decoded_image_t& image, bool srgb, std::vector<decoded_image_t>& mips);
+
+//
+// Times generate_mips with each kernel set against generate_mips_reference on the
+// images in files, as RGBA with sRGB color and as R8 (their red channel), and prints
+// the throughput and the largest difference from the reference
+//
+void benchmark_mips(const std::vector<std::string>& files, unsigned nbr_threads = 0);
+
+//
+// sRGB <-> linear intensity in [0, 1], for 8-bit values
+//
+float srgb_to_linear(uint8_t c);
+uint8_t linear_to_srgb(float l);
+
+#endif
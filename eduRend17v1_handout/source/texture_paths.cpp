@@ -0,0 +1,25 @@
+//
+//  texture_paths.cpp
+//
+
+#include "texture_paths.h"
+#include "parseutil.h"
+
+unsigned texture_path_cache_t::resolve(const std::string& dir, const char* s, const char* e)
+{
+	uint64_t key = (uint64_t)dirs.intern(dir) << 32 | references.intern(s, e);
+	auto it = resolved.find(key);
+	if (it != resolved.end())
+	{
+		hits++;
+		return it->second;
+	}
+	misses++;
+
+	std::string filename;
+	unsigned id = npos;
+	if (find_filename_from_suffixes(s, e, suffixes, filename))
+		id = paths.intern(dir + filename);
+	resolved[key] = id;
+	return id;
+}
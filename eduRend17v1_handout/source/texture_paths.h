@@ -0,0 +1,51 @@
+//
+//  texture_paths.h
+//	resolution of texture references in MTL files to file paths
+//
+
+#pragma once
+#ifndef TEXTURE_PATHS_H
+#define TEXTURE_PATHS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "string_interner.h"
+
+//
+// Resolves the argument of a map_* record, e.g. "-bm 0.5 textures/wall.png", to the path
+// of the file it names, and interns the result. Each distinct argument (per directory) is
+// scanned once; repeats are looked up. Materials sharing a texture get the same path id.
+//
+class texture_path_cache_t
+{
+	std::vector<std::string> suffixes;
+
+	string_interner_t dirs, references, paths;
+	// (dir id, reference id) -> path id
+	std::unordered_map<uint64_t, unsigned> resolved;
+
+public:
+
+	static const unsigned npos = string_interner_t::npos;
+
+	unsigned hits = 0, misses = 0;
+
+	//
+	// suffixes: allowed file name extensions, in order of precedence
+	//
+	explicit texture_path_cache_t(std::vector<std::string> suffixes) : suffixes(std::move(suffixes)) { }
+
+	//
+	// Path id of dir + the file name with an allowed suffix in [s, e), or npos if there is none
+	//
+	unsigned resolve(const std::string& dir, const char* s, const char* e);
+
+	const std::string& path(unsigned id) const { return paths.name(id); }
+
+	// number of distinct paths
+	size_t size() const { return paths.size() - 1; }
+};
+
+#endif
@@ -0,0 +1,302 @@
+//
+//  texture_residency.cpp
+//
+//	Which mip levels of streamed textures to keep in device memory
+//
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <queue>
+#include "texture_residency.h"
+
+namespace
+{
+	// resident levels are worth this much more than new ones of the same priority, so
+	// textures near the budget limit do not swap back and forth as the camera moves
+	const float resident_bonus = 2.0f;
+}
+
+unsigned texture_residency_t::add_texture(unsigned width, unsigned height, unsigned bits_per_pixel, bool block_compressed)
+{
+	unsigned id;
+	if (free_ids.size())
+	{
+		id = free_ids.back();
+		free_ids.pop_back();
+	}
+	else
+	{
+		id = (unsigned)textures.size();
+		textures.push_back(texture_t());
+	}
+
+	texture_t& t = textures[id];
+	t = texture_t();
+	t.width = width;
+	t.height = height;
+	t.tail_mip = ~0u;
+	for (unsigned mip = 0;; mip++)
+	{
+		size_t w = std::max(1u, width >> mip), h = std::max(1u, height >> mip);
+		if (std::max(w, h) <= tail_size)
+			t.tail_mip = std::min(t.tail_mip, mip);
+		if (block_compressed)
+			w = (w + 3) & ~3, h = (h + 3) & ~3;
+		t.level_bytes.push_back(w * h * bits_per_pixel / 8);
+		if (w <= 1 && h <= 1)
+			break;
+	}
+	t.tail_mip = std::min(t.tail_mip, nbr_levels(id) - 1);
+
+	t.top_mip = nbr_levels(id);
+	t.wanted_mip = t.tail_mip;
+	t.used = true;
+	return id;
+}
+
+void texture_residency_t::remove_texture(unsigned texture)
+{
+	texture_t& t = textures[texture];
+	counters.resident_bytes -= bytes_from(t, t.top_mip);
+	t = texture_t();
+	free_ids.push_back(texture);
+}
+
+size_t texture_residency_t::bytes_from(const texture_t& t, unsigned mip) const
+{
+	size_t bytes = 0;
+	for (unsigned m = mip; m < t.level_bytes.size(); m++)
+		bytes += t.level_bytes[m];
+	return bytes;
+}
+
+void texture_residency_t::begin_frame()
+{
+	for (auto& t : textures)
+	{
+		t.priority = 0;
+		t.wanted_mip = t.tail_mip;
+	}
+}
+
+void texture_residency_t::request(unsigned texture, float screen_pixels)
+{
+	texture_t& t = textures[texture];
+	if (!t.used || screen_pixels <= 0)
+		return;
+
+	// about as many texels across as pixels
+	float texels = (float)std::max(t.width, t.height);
+	unsigned mip = texels > screen_pixels ? (unsigned)log2f(texels / screen_pixels) : 0;
+	t.wanted_mip = std::min(t.wanted_mip, std::min(mip, t.tail_mip));
+	t.priority = std::max(t.priority, screen_pixels);
+}
+
+const std::vector<texture_residency_t::change_t>& texture_residency_t::update()
+{
+	changes.clear();
+	const size_t n = textures.size();
+
+	// tails first, then the best improvement per byte while the budget lasts; each level
+	// taken is recorded, so loads below can follow the same order
+	std::vector<unsigned> target(n);
+	std::vector<std::pair<unsigned, unsigned>> steps;
+	std::priority_queue<std::pair<float, unsigned>> candidates;
+	size_t bytes = 0;
+
+	auto key = [&](unsigned i)
+	{
+		const texture_t& t = textures[i];
+		unsigned mip = target[i] - 1;
+		return t.priority / t.level_bytes[mip] * (mip >= t.top_mip ? resident_bonus : 1.0f);
+	};
+
+	for (unsigned i = 0; i < n; i++)
+	{
+		const texture_t& t = textures[i];
+		if (!t.used)
+			continue;
+		target[i] = t.tail_mip;
+		bytes += bytes_from(t, t.tail_mip);
+		if (target[i] > t.wanted_mip)
+			candidates.push({ key(i), i });
+	}
+
+	while (candidates.size())
+	{
+		unsigned i = candidates.top().second;
+		candidates.pop();
+		const texture_t& t = textures[i];
+
+		size_t cost = t.level_bytes[target[i] - 1];
+		if (bytes + cost > budget)
+			continue;
+		bytes += cost;
+		target[i]--;
+		steps.push_back({ i, target[i] });
+		if (target[i] > t.wanted_mip)
+			candidates.push({ key(i), i });
+	}
+
+	// levels no longer wanted stay while there is room, those of the most recently
+	// important textures first
+	std::vector<unsigned> order;
+	for (unsigned i = 0; i < n; i++)
+		if (textures[i].used && textures[i].top_mip < target[i])
+			order.push_back(i);
+	std::sort(order.begin(), order.end(), [&](unsigned a, unsigned b) { return textures[a].priority > textures[b].priority; });
+	for (unsigned i : order)
+		while (target[i] > textures[i].top_mip && bytes + textures[i].level_bytes[target[i] - 1] <= budget)
+		{
+			target[i]--;
+			bytes += textures[i].level_bytes[target[i]];
+		}
+
+	// evictions take effect at once, tails are loaded whole, and the other loads in the
+	// order they were picked until max_upload_bytes
+	std::vector<unsigned> top(n);
+	size_t uploaded = 0;
+	for (unsigned i = 0; i < n; i++)
+	{
+		texture_t& t = textures[i];
+		if (!t.used)
+			continue;
+		top[i] = t.top_mip;
+		if (top[i] < target[i])
+		{
+			counters.evictions += target[i] - top[i];
+			top[i] = target[i];
+		}
+		if (top[i] > t.tail_mip)
+		{
+			counters.loads += top[i] - t.tail_mip;
+			counters.loaded_bytes += bytes_from(t, t.tail_mip) - bytes_from(t, top[i]);
+			top[i] = t.tail_mip;
+		}
+	}
+	for (auto& step : steps)
+	{
+		unsigned i = step.first, mip = step.second;
+		if (mip >= top[i])
+			continue;
+		size_t cost = textures[i].level_bytes[mip];
+		if (uploaded && uploaded + cost > max_upload_bytes)
+			break;
+		uploaded += cost;
+		top[i] = mip;
+		counters.loads++;
+		counters.loaded_bytes += cost;
+	}
+
+	counters.resident_bytes = counters.wanted_bytes = 0;
+	for (unsigned i = 0; i < n; i++)
+	{
+		texture_t& t = textures[i];
+		if (!t.used)
+			continue;
+		if (top[i] != t.top_mip)
+		{
+			t.top_mip = top[i];
+			changes.push_back({ i, top[i] });
+		}
+		counters.resident_bytes += bytes_from(t, t.top_mip);
+		counters.wanted_bytes += bytes_from(t, t.wanted_mip);
+	}
+	return changes;
+}
+
+float screen_size(	const linalg::vec3f& center,
+					float radius,
+					const linalg::vec3f& eye,
+					float vfov,
+					float viewport_height)
+{
+	// from inside, as if from the surface
+	float distance = std::max((center - eye).norm2(), radius);
+	if (distance <= 0)
+		return 0;
+	return radius * viewport_height / (distance * tanf(vfov * 0.5f));
+}
+
+bool benchmark_residency(unsigned nbr_textures, size_t budget, size_t max_upload_bytes)
+{
+	typedef std::chrono::high_resolution_clock clock;
+	const float vfov = 0.785f, viewport_height = 1080;
+	const unsigned nbr_moving = 40, nbr_still = 20, max_settle = 4;
+
+	texture_residency_t residency;
+	residency.budget = budget;
+	residency.max_upload_bytes = max_upload_bytes;
+
+	// a mix of 2048x1024 and 1024x1024 RGBA textures, one per unit along x
+	std::vector<unsigned> ids;
+	for (unsigned i = 0; i < nbr_textures; i++)
+		ids.push_back(residency.add_texture(i % 3 ? 1024 : 2048, 1024, 32));
+
+	bool ok = true;
+	size_t max_resident = 0, max_loaded = 0;
+	double update_ms = 0;
+	unsigned nbr_updates = 0;
+
+	auto frame = [&](float camera_x)
+	{
+		residency.begin_frame();
+		for (unsigned i = 0; i < nbr_textures; i++)
+			residency.request(ids[i], screen_size(linalg::vec3f((float)i, 0, 0), 0.5f, linalg::vec3f(camera_x, 0, 1), vfov, viewport_height));
+
+		texture_residency_t::stats_t before = residency.stats();
+		auto start = clock::now();
+		size_t nbr_changes = residency.update().size();
+		update_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+		const texture_residency_t::stats_t& after = residency.stats();
+
+		// the first update loads the tails whole
+		size_t loaded = after.loaded_bytes - before.loaded_bytes;
+		if (nbr_updates++ && loaded > max_upload_bytes && after.loads - before.loads > 1)
+		{
+			printf("\tupdate %u loaded %.2f MB, over the upload limit\n", nbr_updates, loaded / (1024.0 * 1024.0));
+			ok = false;
+		}
+		if (after.resident_bytes > budget)
+		{
+			printf("\tupdate %u: %.2f MB resident, over the budget\n", nbr_updates, after.resident_bytes / (1024.0 * 1024.0));
+			ok = false;
+		}
+		if (nbr_updates > 1)
+			max_loaded = std::max(max_loaded, loaded);
+		max_resident = std::max(max_resident, after.resident_bytes);
+		return nbr_changes;
+	};
+
+	frame(0);
+	for (unsigned f = 0; f < nbr_moving; f++)
+		frame(f * nbr_textures * 0.5f / nbr_moving);
+
+	// once the camera stops, levels may still be catching up, then nothing should change
+	const float still_x = nbr_textures * 0.5f;
+	unsigned settled_after = 0, late_changes = 0;
+	for (unsigned f = 0; f < nbr_still; f++)
+		if (frame(still_x))
+		{
+			if (f < max_settle)
+				settled_after = f + 1;
+			else
+				late_changes++;
+		}
+	if (late_changes)
+	{
+		printf("\t%u updates changed levels more than %u updates after the camera stopped\n", late_changes, max_settle);
+		ok = false;
+	}
+
+	const texture_residency_t::stats_t& s = residency.stats();
+	printf("Texture residency, %u textures, %.1f MB budget, %.1f MB upload limit:\n", nbr_textures, budget / (1024.0 * 1024.0), max_upload_bytes / (1024.0 * 1024.0));
+	printf("\t%u updates, %.3f ms each\n", nbr_updates, update_ms / nbr_updates);
+	printf("\tmost resident %.2f MB, most loaded in an update %.2f MB\n", max_resident / (1024.0 * 1024.0), max_loaded / (1024.0 * 1024.0));
+	printf("\t%u levels loaded (%.1f MB), %u evicted; last change %u updates after the camera stopped\n",
+		s.loads, s.loaded_bytes / (1024.0 * 1024.0), s.evictions, settled_after);
+	printf("\t%s\n", ok ? "OK" : "FAILED");
+	return ok;
+}
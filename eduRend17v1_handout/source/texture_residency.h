@@ -0,0 +1,123 @@
+//
+//  texture_residency.h
+//
+//	Which mip levels of streamed textures to keep in device memory
+//
+
+#pragma once
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include <vector>
+#include <cstddef>
+#include "vec/vec.h"
+
+//
+// A streamed texture is resident from some mip level down to 1x1. Its small levels, up
+// to tail_size, are loaded as soon as it is added and never evicted; finer levels are
+// added one at a time as the texture is requested at higher resolution, and dropped
+// again when they are no longer wanted and the memory is needed.
+//
+// Each frame the user requests textures with the size in pixels they cover on screen,
+// which gives the level each one wants; update() then picks the resident levels under
+// the budget, cheapest improvement per byte first, and returns the textures whose
+// resident level changed. Loading is limited to max_upload_bytes per update, so a
+// texture is sharpened over several frames rather than all at once.
+//
+// Only bookkeeping is done here, no device objects, so it can run without a GPU.
+//
+class texture_residency_t
+{
+public:
+
+	struct change_t
+	{
+		unsigned texture;
+		unsigned top_mip;		// new most detailed resident level
+	};
+
+	struct stats_t
+	{
+		size_t resident_bytes = 0;
+		size_t wanted_bytes = 0;	// with every texture at its wanted level
+		unsigned loads = 0, evictions = 0;		// levels, since the start
+		size_t loaded_bytes = 0;
+	};
+
+	size_t budget = 256 << 20;
+	size_t max_upload_bytes = 16 << 20;
+	unsigned tail_size = 64;
+
+	//
+	// Texture of width x height with a full mip chain; block_compressed rounds levels up
+	// to whole 4x4 blocks. Returns its id, which stays valid until remove_texture().
+	//
+	unsigned add_texture(unsigned width, unsigned height, unsigned bits_per_pixel, bool block_compressed = false);
+	void remove_texture(unsigned texture);
+
+	//
+	// Forgets the requests of the previous frame
+	//
+	void begin_frame();
+
+	//
+	// Texture seen over screen_pixels pixels this frame; it wants the level that has about
+	// as many texels across. The largest request of a frame counts.
+	//
+	void request(unsigned texture, float screen_pixels);
+
+	//
+	// Picks the resident levels after this frame's requests, returning the textures whose
+	// level changed. The first update after add_texture() loads its tail.
+	//
+	const std::vector<change_t>& update();
+
+	unsigned top_mip(unsigned texture) const { return textures[texture].top_mip; }
+	unsigned wanted_mip(unsigned texture) const { return textures[texture].wanted_mip; }
+	unsigned nbr_levels(unsigned texture) const { return (unsigned)textures[texture].level_bytes.size(); }
+	size_t level_bytes(unsigned texture, unsigned mip) const { return textures[texture].level_bytes[mip]; }
+
+	const stats_t& stats() const { return counters; }
+
+private:
+
+	struct texture_t
+	{
+		std::vector<size_t> level_bytes;
+		unsigned width = 0, height = 0;
+		unsigned tail_mip = 0;		// coarsest level kept always
+		unsigned top_mip = 0;		// resident levels are [top_mip, nbr_levels); nbr_levels if none yet
+		unsigned wanted_mip = 0;
+		float priority = 0;			// screen pixels of the largest request this frame
+		bool used = false;
+	};
+
+	std::vector<texture_t> textures;
+	std::vector<unsigned> free_ids;
+	std::vector<change_t> changes;
+	stats_t counters;
+
+	size_t bytes_from(const texture_t& t, unsigned mip) const;
+};
+
+//
+// Pixels across the screen projection of a sphere, for a camera at eye with a vertical
+// field of view vfov (radians) and a viewport viewport_height pixels high. Inside the
+// sphere, the camera counts as being on its surface.
+//
+float screen_size(	const linalg::vec3f& center,
+					float radius,
+					const linalg::vec3f& eye,
+					float vfov,
+					float viewport_height);
+
+//
+// Drives a texture_residency_t without a GPU: nbr_textures in a row, with a camera
+// moving past them and then standing still. Checks that resident memory stays within
+// budget, that loads after the tails stay within max_upload_bytes per update (or one
+// level, if that is larger), and that the resident levels settle once the camera
+// stops; prints the results and the time per update, and returns whether all held.
+//
+bool benchmark_residency(unsigned nbr_textures = 20, size_t budget = 24 << 20, size_t max_upload_bytes = 8 << 20);
+
+#endif
@@ -10,14 +10,6 @@
 
 namespace linalg
 {
-    template <class T>
-    vec2<T> mat2<T>::operator*(const vec2<T>& rhs) const
-    {
-        return vec2<T>(m11*rhs.x + m12*rhs.y, m21*rhs.x + m22*rhs.y);
-    }
-    // explicit template specialisation for <float>
-    template vec2<float> mat2<float>::operator*(const vec2<float>& rhs) const;
-    
     template <class T>
     void mat3<T>::normalize()
     {
@@ -32,20 +24,55 @@ namespace linalg
     }
     // explicit template specialisation for <float>
     template void mat3<float>::normalize();
-    
-    template <class T>
-    vec3<T> mat3<T>::operator*(const vec3<T> &v) const
-    {
-        return col[0]*v.x + col[1]*v.y + col[2]*v.z;
-    }
-    // explicit template specialisation for <float>
-    template vec3<float> mat3<float>::operator*(const vec3<float> &v) const;
-    
-    template <class T>
-    vec4<T> mat4<T>::operator *(const vec4<T> &v) const
+
+    //
+    // Compile-time checks of the constexpr parts of vec.h, mat.h and quat.h. For float,
+    // products go through multiply_scalar, as the SIMD operators are not constexpr; double
+    // has no SIMD versions and checks the operators themselves.
+    //
+    namespace
     {
-        return col[0]*v.x + col[1]*v.y + col[2]*v.z + col[3]*v.w;
+        constexpr vec3f a = vec3f(1, 2, 3), b = vec3f(4, -5, 6);
+        static_assert(a + b == vec3f(5, -3, 9) && a - b == vec3f(-3, 7, -3), "vec3 + -");
+        static_assert(a * 2.0f == vec3f(2, 4, 6) && a * b == vec3f(4, -10, 18) && -a == vec3f(-1, -2, -3), "vec3 *");
+        static_assert(vec3f(2, 4, 8) / 2.0f == vec3f(1, 2, 4), "vec3 /");
+        static_assert(dot(a, b) == 12 && a.dot(b) == 12 && a.norm2squared() == 14, "dot");
+        static_assert(a % b == vec3f(27, 6, -13) && dot(a % b, a) == 0, "cross product");
+        static_assert(vec4f(a, 1).xyz() == a && a.xyz1().w == 1 && a.xyz0().w == 0, "swizzles");
+        static_assert(vec3f().x == 0 && vec4f_zero.w == 0 && vec2f(3, 4) % vec2f(1, 2) == 2, "vec2, vec4");
+        
+        constexpr mat3f R = mat3f(0, -1, 0,
+                                  1,  0, 0,
+                                  0,  0, 1);
+        static_assert(R * vec3f(1, 0, 0) == vec3f(0, 1, 0) && vec3f(0, 1, 0) * R == vec3f(1, 0, 0), "mat3 * vec3");
+        static_assert(R.determinant() == 1 && (R * R).m11 == -1 && (R * R).m22 == -1, "mat3 product");
+        static_assert(mat3f(a, b, a % b).m32 == 6 && mat3f_identity.m22 == 1 && mat3f_zero.m22 == 0, "mat3 constructors");
+        
+        constexpr mat4f T = mat4f::translation(1, 2, 3), S = mat4f::scaling(2, 3, 4);
+        constexpr mat4f TS = mat4f::multiply_scalar(T, S);
+        static_assert(TS.m11 == 2 && TS.m22 == 3 && TS.m33 == 4 && TS.m14 == 1 && TS.m34 == 3 && TS.m44 == 1, "mat4 product");
+        static_assert(mat4f::multiply_scalar(TS, vec4f(1, 1, 1, 1)).xyz() == vec3f(3, 5, 7), "mat4 * vec4");
+        static_assert(mat4f::multiply_scalar(mat4f_identity, T).m24 == 2 && mat4f_zero.m44 == 0, "identity");
+        static_assert(TS.determinant() == 24 && mat4f(R).get_3x3().m12 == -1 && mat4f(R).m44 == 1, "mat4 from mat3");
+        static_assert((T + S).m11 == 3 && (T * 2.0f).m14 == 2, "mat4 + *");
+        static_assert(mat4f::GL_symmetric_projection(1, 1, 1, 3).m34 == -3, "projection");
+        
+        constexpr mat4<double> Td = mat4<double>::translation(1, 2, 3), Sd = mat4<double>::scaling(2.0);
+        static_assert((Td * Sd * vec4<double>(1, 1, 1, 1)).z == 5, "mat4<double> operators");
+        
+        constexpr affine3x4f A = affine3x4f::multiply_scalar(affine3x4f::translation(a), affine3x4f::scaling(2));
+        static_assert(A.transform_vector(vec3f(1, 1, 1)) == vec3f(2, 2, 2) && A.m14 == 1 && A.m34 == 3, "affine");
+        static_assert(A.get_translation() == a && A.get_3x3().m33 == 2 && affine3x4f(TS).m24 == 2, "affine parts");
+        static_assert(A.to_mat4().m44 == 1 && affine3x4f_identity.m22 == 1 && affine3x4f_identity.m14 == 0, "affine to mat4");
+        constexpr affine3x4<double> Ad = affine3x4<double>::translation(1, 2, 3) * affine3x4<double>::scaling(2.0);
+        static_assert(Ad.transform_point(vec3<double>(1, 1, 1)) == vec3<double>(3, 4, 5) && (Ad * vec4<double>(1, 1, 1, 0)).z == 2, "affine<double> operators");
+        
+        static_assert((mat2f_identity * vec2f(3, 4)).y == 4 && mat2f_zero.m22 == 0, "mat2 constants");
+        
+        constexpr quatf Q = quatf(0.5f, 0.5f, 0.5f, 0.5f);	// 120 degrees around (1, 1, 1)
+        static_assert(Q.rotate(vec3f(1, 0, 0)) == vec3f(0, 1, 0) && Q.to_mat3() * vec3f(0, 1, 0) == vec3f(0, 0, 1), "quat rotation");
+        static_assert((Q * Q * Q).w == -1 && (Q * Q.conjugate()).w == 1 && Q.norm2squared() == 1, "quat product");
+        static_assert(affine3x4f(Q, a).transform_vector(vec3f(0, 0, 1)) == vec3f(1, 0, 0) && affine3x4f(Q, a).m24 == 2, "affine from quat");
+        static_assert(Q.to_mat4().m21 == 1 && Q.to_mat4().m44 == 1 && quatf_identity.to_mat3().m11 == 1, "quat to mat4");
     }
-    // explicit template specialisation for <float>
-    template vec4<float> mat4<float>::operator *(const vec4<float> &v) const;
 }
\ No newline at end of file
@@ -13,6 +13,11 @@
 #include "math.h"
 #include "vec.h"
 
+//
+// As in vec.h, constructors, products and the fixed transforms are constexpr and build
+// the m11..m44 elements; array, mat and col are for run time. The static_asserts in
+// mat.cpp check them.
+//
 namespace linalg
 {
     
@@ -40,7 +45,7 @@ namespace linalg
         //
         // constructor: from elements
         //
-        mat2(const T& m11, const T& m12, const T& m21, const T& m22) : m11(m11), m12(m12), m21(m21), m22(m22)
+        constexpr mat2(const T& m11, const T& m12, const T& m21, const T& m22) : m11(m11), m21(m21), m12(m12), m22(m22)
         {
             
         }
@@ -59,30 +64,30 @@ namespace linalg
         //
         // constructor: scaling matrix
         //
-        mat2(const T& scale_x, const T& scale_y)
+        constexpr mat2(const T& scale_x, const T& scale_y) : mat2(scale_x, 0, 0, scale_y)
         {
-            m11 = scale_x;	m12 = 0.0;
-            m21 = 0.0;		m22 = scale_y;
+            
         }
         
-        mat2<T> invert() const
+        constexpr mat2<T> invert() const
         {
-            T det = m11 * m22 - m12 * m21;
-            
-            return mat2<T>(m22, -m21, -m12, m11) * (1.0/det);
+            return mat2<T>(m22, -m21, -m12, m11) * (1.0/(m11 * m22 - m12 * m21));
         }
         
-        mat2<T> operator - ()
+        constexpr mat2<T> operator - () const
         {
             return mat2<T>(-m11, -m12, -m21, -m22);
         }
         
-        mat2<T> operator * (const T& s) const
+        constexpr mat2<T> operator * (const T& s) const
         {
             return mat2<T>(m11*s, m12*s, m21*s, m22*s);
         }
         
-        vec2<T> operator * (const vec2<T> &rhs) const;
+        constexpr vec2<T> operator * (const vec2<T> &rhs) const
+        {
+            return vec2<T>(m11*rhs.x + m12*rhs.y, m21*rhs.x + m22*rhs.y);
+        }
         
     };
     
@@ -105,39 +110,38 @@ namespace linalg
 		//
 		// row-major per-element constructor
 		//
-		mat3(const T& _m11, const T& _m12, const T& _m13,
+		constexpr mat3(const T& _m11, const T& _m12, const T& _m13,
 			const T& _m21, const T& _m22, const T& _m23,
 			const T& _m31, const T& _m32, const T& _m33)
+			: m11(_m11), m21(_m21), m31(_m31),
+			  m12(_m12), m22(_m22), m32(_m32),
+			  m13(_m13), m23(_m23), m33(_m33)
 		{
-			m11 = _m11; m12 = _m12; m13 = _m13;
-			m21 = _m21; m22 = _m22; m23 = _m23;
-			m31 = _m31; m32 = _m32; m33 = _m33;
 		}
         
 		//
         // constructor: equal diagonal elements
         //
-        mat3(const T& d) : mat3(d,d,d) { }
+        constexpr mat3(const T& d) : mat3(d,d,d) { }
         
 		//
         // constructor: diagonal elements (scaling matrix)
         //
-        mat3(const T& d0, const T& d1, const T& d2)
+        constexpr mat3(const T& d0, const T& d1, const T& d2)
+            : mat3(d0, 0, 0,
+                   0, d1, 0,
+                   0, 0, d2)
         {
-            m11 = d0;
-            m22 = d1;
-            m33 = d2;
-            m12 = m13 = m21 = m23 = m31 = m32 = 0.0;
         }
         
         //
         // from basis vectors
         //
-        mat3(const vec3<T>& e0, const vec3<T>& e1, const vec3<T>& e2)
+        constexpr mat3(const vec3<T>& e0, const vec3<T>& e1, const vec3<T>& e2)
+            : mat3(e0.x, e1.x, e2.x,
+                   e0.y, e1.y, e2.y,
+                   e0.z, e1.z, e2.z)
         {
-            col[0] = e0;
-            col[1] = e1;
-            col[2] = e2;
         }
         
         vec3<T> column(int i)
@@ -211,7 +215,7 @@ namespace linalg
             col[2] = m.col[2];
         }
         
-        T determinant() const
+        constexpr T determinant() const
         {
             return m11*m22*m33 + m12*m23*m31 + m13*m21*m32 - m11*m23*m32 - m12*m21*m33 - m13*m22*m31;
         }
@@ -221,21 +225,21 @@ namespace linalg
         //
         void normalize();
         
-        mat3<T> operator * (const T& s) const
+        constexpr mat3<T> operator * (const T& s) const
         {
             return mat3<T>(m11*s, m12*s, m13*s,
                            m21*s, m22*s, m23*s,
                            m31*s, m32*s, m33*s);
         }
         
-        mat3<T> operator +(const mat3<T>& m) const
+        constexpr mat3<T> operator +(const mat3<T>& m) const
         {
             return mat3<T>(m11+m.m11, m12+m.m12, m13+m.m13,
                            m21+m.m21, m22+m.m22, m23+m.m23,
                            m31+m.m31, m32+m.m32, m33+m.m33);
         }
         
-        mat3<T> operator -(const mat3<T>& m) const
+        constexpr mat3<T> operator -(const mat3<T>& m) const
         {
             return mat3(m11-m.m11, m12-m.m12, m13-m.m13,
                         m21-m.m21, m22-m.m22, m23-m.m23,
@@ -260,14 +264,19 @@ namespace linalg
             return *this;
         }
         
-        mat3<T> operator *(const mat3<T>& m) const
+        constexpr mat3<T> operator *(const mat3<T>& m) const
         {
             return mat3<T>(m11*m.m11+m12*m.m21+m13*m.m31, m11*m.m12+m12*m.m22+m13*m.m32, m11*m.m13+m12*m.m23+m13*m.m33,
                            m21*m.m11+m22*m.m21+m23*m.m31, m21*m.m12+m22*m.m22+m23*m.m32, m21*m.m13+m22*m.m23+m23*m.m33,
                            m31*m.m11+m32*m.m21+m33*m.m31, m31*m.m12+m32*m.m22+m33*m.m32, m31*m.m13+m32*m.m23+m33*m.m33);
         }
         
-        vec3<T> operator *(const vec3<T> &v) const;
+        constexpr vec3<T> operator *(const vec3<T> &v) const
+        {
+            return vec3<T>(m11*v.x + m12*v.y + m13*v.z,
+                           m21*v.x + m22*v.y + m23*v.z,
+                           m31*v.x + m32*v.y + m33*v.z);
+        }
         
         //
         // thread safe debug print
@@ -279,6 +288,17 @@ namespace linalg
         }
     };
     
+    //
+    // row vector * matrix = row vector
+    //
+    template<class T>
+    constexpr vec3<T> vec3<T>::operator *(const mat3<T> &m) const
+    {
+        return vec3<T>(x*m.m11 + y*m.m21 + z*m.m31,
+                       x*m.m12 + y*m.m22 + z*m.m32,
+                       x*m.m13 + y*m.m23 + z*m.m33);
+    }
+    
 	//
 	// thread unsafe debug print
 	//
@@ -307,61 +327,79 @@ namespace linalg
         
         mat4() { }
         
-        mat4(T d) : mat4(d,d,d,d) { }
+        constexpr mat4(T d) : mat4(d,d,d,d) { }
         
-        mat4(const T& d0, const T& d1, const T& d2, const T& d3)
+        constexpr mat4(const T& d0, const T& d1, const T& d2, const T& d3)
+            : mat4(d0, 0,  0,  0,
+                   0,  d1, 0,  0,
+                   0,  0,  d2, 0,
+                   0,  0,  0,  d3)
         {
-            m11 = d0;  m12 = 0.0; m13 = 0.0; m14 = 0.0;
-            m21 = 0.0; m22 = d1;  m23 = 0.0; m24 = 0.0;
-            m31 = 0.0; m32 = 0.0; m33 = d2;  m34 = 0.0;
-            m41 = 0.0; m42 = 0.0; m43 = 0.0; m44 = d3;
         }
         
-        mat4(const mat3<T> &m)
+        constexpr mat4(const mat3<T> &m)
+            : mat4(m.m11, m.m12, m.m13, 0,
+                   m.m21, m.m22, m.m23, 0,
+                   m.m31, m.m32, m.m33, 0,
+                   0,     0,     0,     1)
         {
-            m11 = m.m11; m12 = m.m12; m13 = m.m13; m14 = 0.0;
-            m21 = m.m21; m22 = m.m22; m23 = m.m23; m24 = 0.0;
-            m31 = m.m31; m32 = m.m32; m33 = m.m33; m34 = 0.0;
-            m41 = 0.0;   m42 = 0.0;   m43 = 0.0;   m44 = 1.0;
         }
         
         /**
          * row-major per-element constructor
          */
-        mat4(const T& _m11, const T& _m12, const T& _m13, const T& _m14,
+        constexpr mat4(const T& _m11, const T& _m12, const T& _m13, const T& _m14,
              const T& _m21, const T& _m22, const T& _m23, const T& _m24,
              const T& _m31, const T& _m32, const T& _m33, const T& _m34,
              const T& _m41, const T& _m42, const T& _m43, const T& _m44)
-        { 
-			m11 = _m11; m12 = _m12; m13 = _m13; m14 = _m14;
-			m21 = _m21; m22 = _m22; m23 = _m23; m24 = _m24;
-			m31 = _m31; m32 = _m32; m33 = _m33; m34 = _m34;
-			m41 = _m41; m42 = _m42; m43 = _m43; m44 = _m44;
+			: m11(_m11), m21(_m21), m31(_m31), m41(_m41),
+			  m12(_m12), m22(_m22), m32(_m32), m42(_m42),
+			  m13(_m13), m23(_m23), m33(_m33), m43(_m43),
+			  m14(_m14), m24(_m24), m34(_m34), m44(_m44)
+		{
 		}
         
 		//
 		// get the upper-left submatrix
 		//
-        mat3<T> get_3x3() const
+        constexpr mat3<T> get_3x3() const
         {
             return mat3<T>(m11, m12, m13, m21, m22, m23, m31, m32, m33);
         }
         
         void transpose()
         {
-            std::swap(m21, m12);
-            std::swap(m31, m13);
-            std::swap(m32, m23);
-            std::swap(m41, m14);
-            std::swap(m42, m24);
-            std::swap(m43, m34);
+            transpose_scalar(*this);
         }
         
         mat4<T> inverse() const
         {
-            T det = determinant();
-            assert(abs(det) > 1e-8);
-            T idet = 1.0/det;
+            return inverse_scalar(*this);
+        }
+        
+        //
+        // Plain versions of the operations mat_simd.h specializes for float, which the SIMD
+        // code is checked against
+        //
+        static void transpose_scalar(mat4<T>& m)
+        {
+            std::swap(m.m21, m.m12);
+            std::swap(m.m31, m.m13);
+            std::swap(m.m32, m.m23);
+            std::swap(m.m41, m.m14);
+            std::swap(m.m42, m.m24);
+            std::swap(m.m43, m.m34);
+        }
+        
+        //
+        // adjugate, with the determinant from its first column
+        //
+        static mat4<T> inverse_scalar(const mat4<T>& m)
+        {
+            const T &m11 = m.m11, &m12 = m.m12, &m13 = m.m13, &m14 = m.m14;
+            const T &m21 = m.m21, &m22 = m.m22, &m23 = m.m23, &m24 = m.m24;
+            const T &m31 = m.m31, &m32 = m.m32, &m33 = m.m33, &m34 = m.m34;
+            const T &m41 = m.m41, &m42 = m.m42, &m43 = m.m43, &m44 = m.m44;
             
             mat4<T> M = mat4<T>(m23 * m34 * m42 - m24 * m33 * m42 + m24 * m32 * m43 - m22 * m34 * m43 - m23 * m32 * m44 + m22 * m33 * m44,
                                 m14 * m33 * m42 - m13 * m34 * m42 - m14 * m32 * m43 + m12 * m34 * m43 + m13 * m32 * m44 - m12 * m33 * m44,
@@ -380,10 +418,13 @@ namespace linalg
                                 m13 * m22 * m41 - m12 * m23 * m41 - m13 * m21 * m42 + m11 * m23 * m42 + m12 * m21 * m43 - m11 * m22 * m43,
                                 m12 * m23 * m31 - m13 * m22 * m31 + m13 * m21 * m32 - m11 * m23 * m32 - m12 * m21 * m33 + m11 * m22 * m33);
             
-            return M*idet;
+            T det = m11 * M.m11 + m12 * M.m21 + m13 * M.m31 + m14 * M.m41;
+            assert(std::abs(det) > 1e-8);
+            
+            return M*(T(1.0)/det);
         }
         
-        T determinant() const
+        constexpr T determinant() const
         {
             return
             m14 * m23 * m32 * m41 - m13 * m24 * m32 * m41 - m14 * m22 * m33 * m41 + m12 * m24 * m33 * m41 +
@@ -418,7 +459,7 @@ namespace linalg
             return array[i];
         }
         
-        mat4<T> operator *(const T& s) const
+        constexpr mat4<T> operator *(const T& s) const
         {
             return mat4<T>(m11*s, m12*s, m13*s, m14*s,
                            m21*s, m22*s, m23*s, m24*s,
@@ -436,69 +477,86 @@ namespace linalg
             return *this;
         }
         
-        mat4<T> operator + (const mat4<T>& m) const
+        constexpr mat4<T> operator + (const mat4<T>& m) const
         {
-            mat4<T> n = *this;
-            n.col[0] += m.col[0];
-            n.col[1] += m.col[1];
-            n.col[2] += m.col[2];
-            n.col[3] += m.col[3];
-            
-            return n;
+            return mat4<T>(m11+m.m11, m12+m.m12, m13+m.m13, m14+m.m14,
+                           m21+m.m21, m22+m.m22, m23+m.m23, m24+m.m24,
+                           m31+m.m31, m32+m.m32, m33+m.m33, m34+m.m34,
+                           m41+m.m41, m42+m.m42, m43+m.m43, m44+m.m44);
+        }
+        
+        //
+        // For float these two are specialized in mat_simd.h, and the SIMD versions are not
+        // constexpr; constant expressions can use multiply_scalar
+        //
+        constexpr mat4<T> operator *(const mat4<T>& m) const
+        {
+            return multiply_scalar(*this, m);
+        }
+        
+        constexpr vec4<T> operator *(const vec4<T> &v) const
+        {
+            return multiply_scalar(*this, v);
+        }
+        
+        //
+        // the columns scaled by the elements of v and summed
+        //
+        static constexpr vec4<T> multiply_scalar(const mat4<T>& m, const vec4<T>& v)
+        {
+            return vec4<T>(m.m11*v.x + m.m12*v.y + m.m13*v.z + m.m14*v.w,
+                           m.m21*v.x + m.m22*v.y + m.m23*v.z + m.m24*v.w,
+                           m.m31*v.x + m.m32*v.y + m.m33*v.z + m.m34*v.w,
+                           m.m41*v.x + m.m42*v.y + m.m43*v.z + m.m44*v.w);
         }
         
-        mat4<T> operator *(const mat4<T>& m) const
+        static constexpr mat4<T> multiply_scalar(const mat4<T>& a, const mat4<T>& m)
         {
-            return mat4<T>(m11 * m.m11 + m12 * m.m21 + m13 * m.m31 + m14 * m.m41,
-                           m11 * m.m12 + m12 * m.m22 + m13 * m.m32 + m14 * m.m42,
-                           m11 * m.m13 + m12 * m.m23 + m13 * m.m33 + m14 * m.m43,
-                           m11 * m.m14 + m12 * m.m24 + m13 * m.m34 + m14 * m.m44,
+            return mat4<T>(a.m11 * m.m11 + a.m12 * m.m21 + a.m13 * m.m31 + a.m14 * m.m41,
+                           a.m11 * m.m12 + a.m12 * m.m22 + a.m13 * m.m32 + a.m14 * m.m42,
+                           a.m11 * m.m13 + a.m12 * m.m23 + a.m13 * m.m33 + a.m14 * m.m43,
+                           a.m11 * m.m14 + a.m12 * m.m24 + a.m13 * m.m34 + a.m14 * m.m44,
                            
-                           m21 * m.m11 + m22 * m.m21 + m23 * m.m31 + m24 * m.m41,
-                           m21 * m.m12 + m22 * m.m22 + m23 * m.m32 + m24 * m.m42,
-                           m21 * m.m13 + m22 * m.m23 + m23 * m.m33 + m24 * m.m43,
-                           m21 * m.m14 + m22 * m.m24 + m23 * m.m34 + m24 * m.m44,
+                           a.m21 * m.m11 + a.m22 * m.m21 + a.m23 * m.m31 + a.m24 * m.m41,
+                           a.m21 * m.m12 + a.m22 * m.m22 + a.m23 * m.m32 + a.m24 * m.m42,
+                           a.m21 * m.m13 + a.m22 * m.m23 + a.m23 * m.m33 + a.m24 * m.m43,
+                           a.m21 * m.m14 + a.m22 * m.m24 + a.m23 * m.m34 + a.m24 * m.m44,
                            
-                           m31 * m.m11 + m32 * m.m21 + m33 * m.m31 + m34 * m.m41,
-                           m31 * m.m12 + m32 * m.m22 + m33 * m.m32 + m34 * m.m42,
-                           m31 * m.m13 + m32 * m.m23 + m33 * m.m33 + m34 * m.m43,
-                           m31 * m.m14 + m32 * m.m24 + m33 * m.m34 + m34 * m.m44,
+                           a.m31 * m.m11 + a.m32 * m.m21 + a.m33 * m.m31 + a.m34 * m.m41,
+                           a.m31 * m.m12 + a.m32 * m.m22 + a.m33 * m.m32 + a.m34 * m.m42,
+                           a.m31 * m.m13 + a.m32 * m.m23 + a.m33 * m.m33 + a.m34 * m.m43,
+                           a.m31 * m.m14 + a.m32 * m.m24 + a.m33 * m.m34 + a.m34 * m.m44,
                            
-                           m41 * m.m11 + m42 * m.m21 + m43 * m.m31 + m44 * m.m41,
-                           m41 * m.m12 + m42 * m.m22 + m43 * m.m32 + m44 * m.m42,
-                           m41 * m.m13 + m42 * m.m23 + m43 * m.m33 + m44 * m.m43,
-                           m41 * m.m14 + m42 * m.m24 + m43 * m.m34 + m44 * m.m44);
+                           a.m41 * m.m11 + a.m42 * m.m21 + a.m43 * m.m31 + a.m44 * m.m41,
+                           a.m41 * m.m12 + a.m42 * m.m22 + a.m43 * m.m32 + a.m44 * m.m42,
+                           a.m41 * m.m13 + a.m42 * m.m23 + a.m43 * m.m33 + a.m44 * m.m43,
+                           a.m41 * m.m14 + a.m42 * m.m24 + a.m43 * m.m34 + a.m44 * m.m44);
         }
         
-        vec4<T> operator *(const vec4<T> &v) const;
-        
-        static mat4<T> translation(const vec3<T>& p)
+        static constexpr mat4<T> translation(const vec3<T>& p)
         {
             return translation(p.x, p.y, p.z);
         }
         
-        static mat4<T> translation(const T& x, const T& y, const T& z)
+        static constexpr mat4<T> translation(const T& x, const T& y, const T& z)
         {
-            mat4<T> M;
-            M.m11 = 1.0; M.m12 = 0.0; M.m13 = 0; M.m14 = x;
-            M.m21 = 0.0; M.m22 = 1.0; M.m23 = 0; M.m24 = y;
-            M.m31 = 0.0; M.m32 = 0.0; M.m33 = 1; M.m34 = z;
-            M.m41 = 0.0; M.m42 = 0.0; M.m43 = 0; M.m44 = 1.0;
-            
-            return M;
+            return mat4<T>(1, 0, 0, x,
+                           0, 1, 0, y,
+                           0, 0, 1, z,
+                           0, 0, 0, 1);
         }
         
-        static mat4<T> scaling(const T& s)
+        static constexpr mat4<T> scaling(const T& s)
         {
             return scaling({s,s,s});
         }
         
-        static mat4<T> scaling(float sx, float sy, float sz)
+        static constexpr mat4<T> scaling(float sx, float sy, float sz)
         {
             return mat4<T>(sx, sy, sz, 1.0);
         }
         
-        static mat4<T> scaling(const vec3<T> &sv)
+        static constexpr mat4<T> scaling(const vec3<T> &sv)
         {
             return mat4<T>(sv.x, sv.y, sv.z, 1.0);
         }
@@ -564,7 +622,7 @@ namespace linalg
             return translation(vt) * rotation(theta, rotv) * scaling(sv);
         }
         
-        static mat4<T> viewport_matrix(const T& w, const T& h)
+        static constexpr mat4<T> viewport_matrix(const T& w, const T& h)
         {
             return mat4f(w*0.5f,0.0f,   0.0f, w*0.5f,
                          0.0f,  h*0.5f, 0.0f, h*0.5f,
@@ -577,17 +635,12 @@ namespace linalg
         // 
         // frustum planes not necessarily symmetric in the y=0 and x=0 planes of the view frame
         //
-        static mat4<T> GL_asymmetric_projection(const T& l, const T& r, const T& b, const T& t, const T& n, const T& f)
+        static constexpr mat4<T> GL_asymmetric_projection(const T& l, const T& r, const T& b, const T& t, const T& n, const T& f)
         {
-            T n2 = 2.0f*n;
-            T rl = r - l;
-            T tb = t - b;
-            T fn = f - n;
-            
-            return mat4<T>(n2/rl,   0.0f,   (r+l)/rl,   0.0f,
-                           0.0f,    n2/tb,  (t+b)/tb,   0.0f,
-                           0.0f,    0.0f,   (-f- n)/fn, (-n2*f)/fn,
-                           0.0f,    0.0f,   -1.0f,      0.0f);
+            return mat4<T>(T(2.0f*n)/(r-l), 0.0f,            (r+l)/(r-l),    0.0f,
+                           0.0f,            T(2.0f*n)/(t-b), (t+b)/(t-b),    0.0f,
+                           0.0f,            0.0f,            (-f- n)/(f-n),  (-T(2.0f*n)*f)/(f-n),
+                           0.0f,            0.0f,            -1.0f,          0.0f);
         }
         
         //
@@ -595,15 +648,12 @@ namespace linalg
         // 
         // frustum planes are symmetric in the y=0 and x=0 planes of the view frame
         //
-        static mat4<T> GL_symmetric_projection(const T& r, const T& t, const T& n, const T& f)
+        static constexpr mat4<T> GL_symmetric_projection(const T& r, const T& t, const T& n, const T& f)
         {
-            T n2 = 2.0f*n;
-            T fn = f - n;
-
-            return mat4<T>(n/r,   0.0f, 0.0f,       0.0f,
-                           0.0f,  n/t,  0.0f,       0.0f,
-                           0.0f,  0.0f, (-f- n)/fn, (-n2*f)/fn,
-                           0.0f,  0.0f, -1.0f,      0.0f);
+            return mat4<T>(n/r,   0.0f, 0.0f,          0.0f,
+                           0.0f,  n/t,  0.0f,          0.0f,
+                           0.0f,  0.0f, (-f- n)/(f-n), (-T(2.0f*n)*f)/(f-n),
+                           0.0f,  0.0f, -1.0f,         0.0f);
         }
         
         //
@@ -646,6 +696,265 @@ namespace linalg
         return out;
     }
 
+    //
+    // 3D affine transform, column-major: a 3x3 linear part and a translation, the top
+    // three rows of a mat4 whose bottom row is (0, 0, 0, 1)
+    //
+    // | m11 m12 m13 m14 |
+    // | m21 m22 m23 m24 |
+    // | m31 m32 m33 m34 |
+    //
+    // Composing two costs 36 multiplies to the 64 of a mat4 product, and the inverse needs
+    // only the 3x3 part inverted; for rotation and uniform scale that is a transpose.
+    //
+    template<class T> class quat;
+    
+    template<class T> class affine3x4
+    {
+    public:
+        union
+        {
+            T array[12];
+            struct { T m11, m21, m31, m12, m22, m32, m13, m23, m33, m14, m24, m34; };
+            struct { vec3<T> col[4]; };		// col[3] is the translation
+        };
+        
+        affine3x4() { }
+        
+        //
+        // row-major per-element constructor
+        //
+        constexpr affine3x4(const T& _m11, const T& _m12, const T& _m13, const T& _m14,
+                            const T& _m21, const T& _m22, const T& _m23, const T& _m24,
+                            const T& _m31, const T& _m32, const T& _m33, const T& _m34)
+            : m11(_m11), m21(_m21), m31(_m31),
+              m12(_m12), m22(_m22), m32(_m32),
+              m13(_m13), m23(_m23), m33(_m33),
+              m14(_m14), m24(_m24), m34(_m34)
+        {
+        }
+        
+        constexpr affine3x4(const mat3<T>& linear, const vec3<T>& t)
+            : affine3x4(linear.m11, linear.m12, linear.m13, t.x,
+                        linear.m21, linear.m22, linear.m23, t.y,
+                        linear.m31, linear.m32, linear.m33, t.z)
+        {
+        }
+        
+        //
+        // rotation r, then translation t; defined in quat.h
+        //
+        constexpr explicit affine3x4(const quat<T>& r, const vec3<T>& t = vec3<T>(0, 0, 0));
+        
+        //
+        // from the top three rows of m, which should be affine
+        //
+        constexpr explicit affine3x4(const mat4<T>& m)
+            : affine3x4(m.m11, m.m12, m.m13, m.m14,
+                        m.m21, m.m22, m.m23, m.m24,
+                        m.m31, m.m32, m.m33, m.m34)
+        {
+        }
+        
+        constexpr mat4<T> to_mat4() const
+        {
+            return mat4<T>(m11, m12, m13, m14,
+                           m21, m22, m23, m24,
+                           m31, m32, m33, m34,
+                           0,   0,   0,   1);
+        }
+        
+        constexpr mat3<T> get_3x3() const
+        {
+            return mat3<T>(m11, m12, m13, m21, m22, m23, m31, m32, m33);
+        }
+        
+        constexpr vec3<T> get_translation() const
+        {
+            return vec3<T>(m14, m24, m34);
+        }
+        
+        static constexpr affine3x4<T> identity()
+        {
+            return affine3x4<T>(mat3<T>(1), vec3<T>(0, 0, 0));
+        }
+        
+        static constexpr affine3x4<T> translation(const T& x, const T& y, const T& z)
+        {
+            return affine3x4<T>(mat3<T>(1), vec3<T>(x, y, z));
+        }
+        
+        static constexpr affine3x4<T> translation(const vec3<T>& p)
+        {
+            return affine3x4<T>(mat3<T>(1), p);
+        }
+        
+        static constexpr affine3x4<T> scaling(const T& s)
+        {
+            return affine3x4<T>(mat3<T>(s), vec3<T>(0, 0, 0));
+        }
+        
+        static constexpr affine3x4<T> scaling(const T& sx, const T& sy, const T& sz)
+        {
+            return affine3x4<T>(mat3<T>(sx, sy, sz), vec3<T>(0, 0, 0));
+        }
+        
+        static constexpr affine3x4<T> scaling(const vec3<T>& sv)
+        {
+            return scaling(sv.x, sv.y, sv.z);
+        }
+        
+        //
+        // Rotation theta around the normalized vector (x, y, z), see mat3::rotation
+        //
+        static affine3x4<T> rotation(const T& theta, const T& x, const T& y, const T& z)
+        {
+            return affine3x4<T>(mat3<T>::rotation(theta, x, y, z), vec3<T>(0, 0, 0));
+        }
+        
+        static affine3x4<T> rotation(const T& theta, const vec3<T>& v)
+        {
+            return rotation(theta, v.x, v.y, v.z);
+        }
+        
+        //
+        // translation(vt) * rotation(theta, rotv) * scaling(sv), without the products
+        //
+        static affine3x4<T> TRS(const vec3<T>& vt, const T& theta, const vec3<T>& rotv, const vec3<T>& sv)
+        {
+            affine3x4<T> M = rotation(theta, rotv);
+            M.col[0] *= sv.x;
+            M.col[1] *= sv.y;
+            M.col[2] *= sv.z;
+            M.col[3] = vt;
+            return M;
+        }
+        
+        //
+        // translation(vt) * rotation r * scaling(sv); defined in quat.h
+        //
+        static affine3x4<T> TRS(const vec3<T>& vt, const quat<T>& r, const vec3<T>& sv);
+        
+        //
+        // For float, compose, transform_point and * vec4 are specialized in mat_simd.h, and
+        // the SIMD versions are not constexpr; constant expressions can use multiply_scalar
+        //
+        constexpr affine3x4<T> operator *(const affine3x4<T>& m) const
+        {
+            return multiply_scalar(*this, m);
+        }
+        
+        //
+        // The 3x3 parts multiplied, and a's applied to m's translation plus a's own
+        //
+        static constexpr affine3x4<T> multiply_scalar(const affine3x4<T>& a, const affine3x4<T>& m)
+        {
+            return affine3x4<T>(a.m11*m.m11 + a.m12*m.m21 + a.m13*m.m31,
+                                a.m11*m.m12 + a.m12*m.m22 + a.m13*m.m32,
+                                a.m11*m.m13 + a.m12*m.m23 + a.m13*m.m33,
+                                a.m11*m.m14 + a.m12*m.m24 + a.m13*m.m34 + a.m14,
+                                
+                                a.m21*m.m11 + a.m22*m.m21 + a.m23*m.m31,
+                                a.m21*m.m12 + a.m22*m.m22 + a.m23*m.m32,
+                                a.m21*m.m13 + a.m22*m.m23 + a.m23*m.m33,
+                                a.m21*m.m14 + a.m22*m.m24 + a.m23*m.m34 + a.m24,
+                                
+                                a.m31*m.m11 + a.m32*m.m21 + a.m33*m.m31,
+                                a.m31*m.m12 + a.m32*m.m22 + a.m33*m.m32,
+                                a.m31*m.m13 + a.m32*m.m23 + a.m33*m.m33,
+                                a.m31*m.m14 + a.m32*m.m24 + a.m33*m.m34 + a.m34);
+        }
+        
+        //
+        // with the implied bottom row, (x, y, z, w) -> (M (x, y, z) + w t, w)
+        //
+        constexpr vec4<T> operator *(const vec4<T>& v) const
+        {
+            return vec4<T>(m11*v.x + m12*v.y + m13*v.z + m14*v.w,
+                           m21*v.x + m22*v.y + m23*v.z + m24*v.w,
+                           m31*v.x + m32*v.y + m33*v.z + m34*v.w,
+                           v.w);
+        }
+        
+        constexpr vec3<T> transform_point(const vec3<T>& p) const
+        {
+            return vec3<T>(m11*p.x + m12*p.y + m13*p.z + m14,
+                           m21*p.x + m22*p.y + m23*p.z + m24,
+                           m31*p.x + m32*p.y + m33*p.z + m34);
+        }
+        
+        constexpr vec3<T> transform_vector(const vec3<T>& v) const
+        {
+            return vec3<T>(m11*v.x + m12*v.y + m13*v.z,
+                           m21*v.x + m22*v.y + m23*v.z,
+                           m31*v.x + m32*v.y + m33*v.z);
+        }
+        
+        //
+        // General inverse: the rows of the inverted 3x3 part are cross products of its
+        // columns over the determinant, and the translation is moved back through it
+        //
+        affine3x4<T> inverse() const
+        {
+            vec3<T> r0 = col[1] % col[2], r1 = col[2] % col[0], r2 = col[0] % col[1];
+            T det = dot(col[0], r0);
+            assert(std::abs(det) > 1e-8);
+            T idet = T(1.0)/det;
+            
+            affine3x4<T> M;
+            M.m11 = r0.x*idet; M.m12 = r0.y*idet; M.m13 = r0.z*idet;
+            M.m21 = r1.x*idet; M.m22 = r1.y*idet; M.m23 = r1.z*idet;
+            M.m31 = r2.x*idet; M.m32 = r2.y*idet; M.m33 = r2.z*idet;
+            M.col[3] = -M.transform_vector(col[3]);
+            return M;
+        }
+        
+        //
+        // Inverse of rotation, uniform scale s and translation only: the 3x3 part is
+        // s R, whose inverse is its transpose over s^2
+        //
+        affine3x4<T> inverse_similarity() const
+        {
+            T is2 = T(1.0)/col[0].norm2squared();
+            
+            affine3x4<T> M;
+            M.m11 = m11*is2; M.m12 = m21*is2; M.m13 = m31*is2;
+            M.m21 = m12*is2; M.m22 = m22*is2; M.m23 = m32*is2;
+            M.m31 = m13*is2; M.m32 = m23*is2; M.m33 = m33*is2;
+            M.col[3] = -M.transform_vector(col[3]);
+            return M;
+        }
+        
+        //
+        // For transforming normals: the inverse transpose of the 3x3 part, whose columns
+        // are the cross products of its columns over the determinant
+        //
+        mat3<T> normal_matrix() const
+        {
+            T det = dot(col[0], col[1] % col[2]);
+            assert(std::abs(det) > 1e-8);
+            T idet = T(1.0)/det;
+            return mat3<T>((col[1] % col[2])*idet, (col[2] % col[0])*idet, (col[0] % col[1])*idet);
+        }
+    };
+    
+    //
+    // normal_matrix of n transforms
+    //
+    template<class T>
+    void normal_matrices(const affine3x4<T>* transforms, mat3<T>* normal, size_t n)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            const vec3<T> &c0 = transforms[i].col[0], &c1 = transforms[i].col[1], &c2 = transforms[i].col[2];
+            vec3<T> n0 = c1 % c2, n1 = c2 % c0, n2 = c0 % c1;
+            T idet = T(1.0)/dot(c0, n0);
+            normal[i].col[0] = n0*idet;
+            normal[i].col[1] = n1*idet;
+            normal[i].col[2] = n2*idet;
+        }
+    }
+    
     template<class T>
     inline mat4<T> transpose(const mat4<T>& m)
     {
@@ -657,16 +966,21 @@ namespace linalg
     typedef mat2<float> mat2f;
     typedef mat3<float> mat3f;
     typedef mat4<float> mat4f;
+    typedef affine3x4<float> affine3x4f;
     
     //
     // compile-time instances
     //
-    const mat2f mat2f_zero = mat2f(0.0f);
-    const mat3f mat3f_zero = mat3f(0.0f);
-    const mat4f mat4f_zero = mat4f(0.0f);
-    const mat2f mat2f_identity = mat2f(1.0f);
-    const mat3f mat3f_identity = mat3f(1.0f);
-    const mat4f mat4f_identity = mat4f(1.0f);
+    constexpr mat2f mat2f_zero = mat2f(0.0f, 0.0f);
+    constexpr mat3f mat3f_zero = mat3f(0.0f);
+    constexpr mat4f mat4f_zero = mat4f(0.0f);
+    constexpr mat2f mat2f_identity = mat2f(1.0f, 1.0f);
+    constexpr mat3f mat3f_identity = mat3f(1.0f);
+    constexpr mat4f mat4f_identity = mat4f(1.0f);
+    constexpr affine3x4f affine3x4f_identity = affine3x4f::identity();
 }
 
+#include "mat_simd.h"
+#include "quat.h"
+
 #endif /* MAT_H */
@@ -0,0 +1,306 @@
+//
+//	mat_simd.cpp
+//
+//	Benchmarks of the mat4<float> SIMD operations and of affine3x4<float>
+//
+
+#include <chrono>
+#include <vector>
+#include <random>
+#include "mat.h"
+
+namespace linalg
+{
+	namespace
+	{
+		typedef std::chrono::high_resolution_clock bench_clock;
+
+		double ns_per_op(bench_clock::time_point start, size_t ops)
+		{
+			return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / ops;
+		}
+
+		float max_diff(const mat4f& a, const mat4f& b)
+		{
+			float d = 0;
+			for (int i = 0; i < 16; i++)
+				d = std::max(d, std::abs(a.array[i] - b.array[i]));
+			return d;
+		}
+
+		float max_diff(const vec4f& a, const vec4f& b)
+		{
+			return std::max(std::max(std::abs(a.x - b.x), std::abs(a.y - b.y)), std::max(std::abs(a.z - b.z), std::abs(a.w - b.w)));
+		}
+
+		//
+		// Random rotation, scaling and translation, with some shear, so the matrices are
+		// invertible and products of them stay in range
+		//
+		mat4f random_matrix(std::mt19937& rng)
+		{
+			std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+			vec3f axis = normalize(vec3f(u(rng), u(rng), u(rng)));
+			mat4f M = mat4f::translation(u(rng) * 10, u(rng) * 10, u(rng) * 10) *
+				mat4f::rotation(u(rng) * fPI, axis) *
+				mat4f::scaling(1.5f + u(rng) * 0.5f, 1.5f + u(rng) * 0.5f, 1.5f + u(rng) * 0.5f);
+			for (int i = 0; i < 12; i++)
+				M.array[i] += u(rng) * 0.1f;
+			return M;
+		}
+
+		float max_diff(const mat3f& a, const mat3f& b)
+		{
+			float d = 0;
+			for (int i = 0; i < 9; i++)
+				d = std::max(d, std::abs(a.array[i] - b.array[i]));
+			return d;
+		}
+
+		void print_result(const char* op, double scalar_ns, double simd_ns, float diff)
+		{
+			printf("\t%-16s scalar %6.2f ns, simd %6.2f ns (%.2fx), max diff %g\n",
+				op, scalar_ns, simd_ns, scalar_ns / simd_ns, diff);
+		}
+	}
+
+	void benchmark_mat4(unsigned nbr_matrices, unsigned rounds)
+	{
+#if defined(LINALG_AVX)
+		const char* isa = "AVX";
+#elif defined(LINALG_SSE)
+		const char* isa = "SSE2";
+#elif defined(LINALG_NEON)
+		const char* isa = "NEON";
+#else
+		const char* isa = "none, scalar only";
+#endif
+		printf("mat4f benchmark (SIMD: %s), %u matrices x %u rounds\n", isa, nbr_matrices, rounds);
+
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+		std::vector<mat4f> a(nbr_matrices), b(nbr_matrices), out_scalar(nbr_matrices), out_simd(nbr_matrices);
+		std::vector<vec4f> v(nbr_matrices), vout_scalar(nbr_matrices), vout_simd(nbr_matrices);
+		for (unsigned i = 0; i < nbr_matrices; i++)
+		{
+			a[i] = random_matrix(rng);
+			b[i] = random_matrix(rng);
+			v[i] = vec4f(u(rng), u(rng), u(rng), 1.0f);
+		}
+		const size_t ops = (size_t)nbr_matrices * rounds;
+		float diff;
+
+		// independent products
+		auto start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				out_scalar[i] = mat4f::multiply_scalar(a[i], b[(i + r) % nbr_matrices]);
+		double scalar_ns = ns_per_op(start, ops);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				out_simd[i] = a[i] * b[(i + r) % nbr_matrices];
+		double simd_ns = ns_per_op(start, ops);
+		diff = 0;
+		for (unsigned i = 0; i < nbr_matrices; i++)
+			diff = std::max(diff, max_diff(out_scalar[i], out_simd[i]));
+		print_result("multiply", scalar_ns, simd_ns, diff);
+
+		// chains of dependent products, as down a transform hierarchy eight levels deep
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				out_scalar[i] = i & 7 ? mat4f::multiply_scalar(out_scalar[i - 1], a[(i + r) % nbr_matrices]) : a[(i + r) % nbr_matrices];
+		scalar_ns = ns_per_op(start, ops);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				out_simd[i] = i & 7 ? out_simd[i - 1] * a[(i + r) % nbr_matrices] : a[(i + r) % nbr_matrices];
+		simd_ns = ns_per_op(start, ops);
+		diff = 0;
+		for (unsigned i = 0; i < nbr_matrices; i++)
+			diff = std::max(diff, max_diff(out_scalar[i], out_simd[i]));
+		print_result("multiply chain", scalar_ns, simd_ns, diff);
+
+		// mat4 * vec4
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				vout_scalar[i] = mat4f::multiply_scalar(a[(i + r) % nbr_matrices], v[i]);
+		scalar_ns = ns_per_op(start, ops);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				vout_simd[i] = a[(i + r) % nbr_matrices] * v[i];
+		simd_ns = ns_per_op(start, ops);
+		diff = 0;
+		for (unsigned i = 0; i < nbr_matrices; i++)
+			diff = std::max(diff, max_diff(vout_scalar[i], vout_simd[i]));
+		print_result("mat4 * vec4", scalar_ns, simd_ns, diff);
+
+		// transpose, twice per round so the matrices end up as they were
+		out_scalar = a;
+		out_simd = a;
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds * 2; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				mat4f::transpose_scalar(out_scalar[i]);
+		scalar_ns = ns_per_op(start, ops * 2);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds * 2; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				out_simd[i].transpose();
+		simd_ns = ns_per_op(start, ops * 2);
+		diff = 0;
+		for (unsigned i = 0; i < nbr_matrices; i++)
+		{
+			mat4f t = a[i], t_scalar = a[i];
+			t.transpose();
+			mat4f::transpose_scalar(t_scalar);
+			diff = std::max(diff, std::max(max_diff(out_scalar[i], out_simd[i]), max_diff(t, t_scalar)));
+		}
+		print_result("transpose", scalar_ns, simd_ns, diff);
+
+		// inverse; the differences are relative to the largest element of the scalar
+		// inverse, and A * inverse(A) - I shows how far each is from exact
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				out_scalar[i] = mat4f::inverse_scalar(a[(i + r) % nbr_matrices]);
+		scalar_ns = ns_per_op(start, ops);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_matrices; i++)
+				out_simd[i] = a[(i + r) % nbr_matrices].inverse();
+		simd_ns = ns_per_op(start, ops);
+		diff = 0;
+		float residual_scalar = 0, residual_simd = 0;
+		for (unsigned i = 0; i < nbr_matrices; i++)
+		{
+			const mat4f& A = a[(i + rounds - 1) % nbr_matrices];
+			float scale = 0;
+			for (int k = 0; k < 16; k++)
+				scale = std::max(scale, std::abs(out_scalar[i].array[k]));
+			diff = std::max(diff, max_diff(out_scalar[i], out_simd[i]) / scale);
+			residual_scalar = std::max(residual_scalar, max_diff(mat4f::multiply_scalar(A, out_scalar[i]), mat4f_identity));
+			residual_simd = std::max(residual_simd, max_diff(mat4f::multiply_scalar(A, out_simd[i]), mat4f_identity));
+		}
+		print_result("inverse", scalar_ns, simd_ns, diff);
+		printf("\t%-16s scalar %g, simd %g\n", "|A*inv(A) - I|", residual_scalar, residual_simd);
+	}
+
+	void benchmark_affine(unsigned nbr_transforms, unsigned rounds)
+	{
+		printf("affine3x4f vs mat4f benchmark, %u transforms x %u rounds\n", nbr_transforms, rounds);
+
+		// translation, rotation and uniform scale, like the model transforms in Main.cpp
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+		std::vector<vec3f> t(nbr_transforms), axis(nbr_transforms), s(nbr_transforms);
+		std::vector<float> theta(nbr_transforms);
+		std::vector<vec4f> p(nbr_transforms);
+		for (unsigned i = 0; i < nbr_transforms; i++)
+		{
+			t[i] = vec3f(u(rng), u(rng), u(rng)) * 10.0f;
+			axis[i] = normalize(vec3f(u(rng), u(rng), u(rng)));
+			theta[i] = u(rng) * fPI;
+			float scale = 1.5f + u(rng) * 0.5f;
+			s[i] = vec3f(scale, scale, scale);
+			p[i] = vec4f(u(rng), u(rng), u(rng), 1.0f);
+		}
+		std::vector<mat4f> m(nbr_transforms), m_out(nbr_transforms);
+		std::vector<affine3x4f> a(nbr_transforms), a_out(nbr_transforms);
+		std::vector<vec4f> pm(nbr_transforms), pa(nbr_transforms);
+		std::vector<mat3f> nm(nbr_transforms), na(nbr_transforms);
+		const size_t ops = (size_t)nbr_transforms * rounds;
+		float diff;
+
+		// T * R * S, then parent * local, eight levels deep
+		auto start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+			{
+				mat4f local = mat4f::translation(t[i]) * mat4f::rotation(theta[i] + r, axis[i]) * mat4f::scaling(s[i]);
+				m[i] = i & 7 ? m[i - 1] * local : local;
+			}
+		double mat4_ns = ns_per_op(start, ops);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+			{
+				affine3x4f local = affine3x4f::TRS(t[i], theta[i] + r, axis[i], s[i]);
+				a[i] = i & 7 ? a[i - 1] * local : local;
+			}
+		double affine_ns = ns_per_op(start, ops);
+		diff = 0;
+		for (unsigned i = 0; i < nbr_transforms; i++)
+			diff = std::max(diff, max_diff(m[i], a[i].to_mat4()) / std::max(1.0f, a[i].col[3].norm2()));
+		printf("\t%-20s mat4f %6.2f ns, affine %6.2f ns (%.2fx), max rel diff %g\n", "TRS + compose", mat4_ns, affine_ns, mat4_ns / affine_ns, diff);
+
+		// compose alone
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+				m_out[i] = m[i] * m[(i + r) % nbr_transforms];
+		mat4_ns = ns_per_op(start, ops);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+				a_out[i] = a[i] * a[(i + r) % nbr_transforms];
+		affine_ns = ns_per_op(start, ops);
+		printf("\t%-20s mat4f %6.2f ns, affine %6.2f ns (%.2fx)\n", "compose", mat4_ns, affine_ns, mat4_ns / affine_ns);
+
+		// inverses: mat4f, general affine, similarity
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+				m_out[i] = m[(i + r) % nbr_transforms].inverse();
+		mat4_ns = ns_per_op(start, ops);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+				a_out[i] = a[(i + r) % nbr_transforms].inverse();
+		affine_ns = ns_per_op(start, ops);
+		diff = 0;
+		for (unsigned i = 0; i < nbr_transforms; i++)
+			diff = std::max(diff, max_diff(m_out[i], a_out[i].to_mat4()));
+		printf("\t%-20s mat4f %6.2f ns, affine %6.2f ns (%.2fx), max diff %g\n", "inverse", mat4_ns, affine_ns, mat4_ns / affine_ns, diff);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+				a_out[i] = a[(i + r) % nbr_transforms].inverse_similarity();
+		affine_ns = ns_per_op(start, ops);
+		diff = 0;
+		for (unsigned i = 0; i < nbr_transforms; i++)
+			diff = std::max(diff, max_diff(m_out[i], a_out[i].to_mat4()));
+		printf("\t%-20s mat4f %6.2f ns, affine %6.2f ns (%.2fx), max diff %g\n", "inverse_similarity", mat4_ns, affine_ns, mat4_ns / affine_ns, diff);
+
+		// points
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+				pm[i] = m[(i + r) % nbr_transforms] * p[i];
+		mat4_ns = ns_per_op(start, ops);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+				pa[i] = a[(i + r) % nbr_transforms] * p[i];
+		affine_ns = ns_per_op(start, ops);
+		printf("\t%-20s mat4f %6.2f ns, affine %6.2f ns (%.2fx)\n", "transform point", mat4_ns, affine_ns, mat4_ns / affine_ns);
+
+		// normal matrices: transpose(inverse(M)) of the mat4f, or the batch from the affines
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (unsigned i = 0; i < nbr_transforms; i++)
+				nm[i] = transpose(m[i].inverse()).get_3x3();
+		mat4_ns = ns_per_op(start, ops);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			normal_matrices(a.data(), na.data(), nbr_transforms);
+		affine_ns = ns_per_op(start, ops);
+		diff = 0;
+		for (unsigned i = 0; i < nbr_transforms; i++)
+			diff = std::max(diff, max_diff(nm[i], na[i]));
+		printf("\t%-20s mat4f %6.2f ns, affine %6.2f ns (%.2fx), max diff %g\n", "normal matrices", mat4_ns, affine_ns, mat4_ns / affine_ns, diff);
+	}
+}
@@ -0,0 +1,348 @@
+//
+//	mat_simd.h
+//
+//	SSE/AVX and NEON versions of the mat4<float> and affine3x4<float> operations
+//
+
+#pragma once
+#ifndef MAT_SIMD_H
+#define MAT_SIMD_H
+
+#include "mat.h"
+
+//
+// Picked at compile time: SSE2 on any x86-64 (and 32-bit builds with /arch:SSE2), AVX on
+// top of it when the compiler targets it (/arch:AVX, -mavx), NEON on ARM. Define
+// LINALG_NO_SIMD to use the scalar code everywhere.
+//
+#ifndef LINALG_NO_SIMD
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define LINALG_SIMD
+#define LINALG_SSE
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define LINALG_AVX
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define LINALG_SIMD
+#define LINALG_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace linalg
+{
+#ifdef LINALG_SIMD
+
+	//
+	// Multiply, transpose and mat4 * vec4 do the same float operations in the same order
+	// as the scalar code, and so give the same bits (as long as the compiler does not fuse
+	// multiply-adds in either). The SSE inverse works on 2x2 blocks and agrees with
+	// inverse_scalar to within rounding; NEON uses inverse_scalar. affine3x4 compose and
+	// point transforms have SSE versions, also bit-exact.
+	//
+
+#if defined(LINALG_SSE)
+
+	template<>
+	inline vec4<float> mat4<float>::operator *(const vec4<float>& v) const
+	{
+		__m128 r = _mm_mul_ps(_mm_loadu_ps(col[0].vec), _mm_set1_ps(v.x));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[1].vec), _mm_set1_ps(v.y)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[2].vec), _mm_set1_ps(v.z)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[3].vec), _mm_set1_ps(v.w)));
+
+		vec4<float> res;
+		_mm_storeu_ps(res.vec, r);
+		return res;
+	}
+
+	template<>
+	inline mat4<float> mat4<float>::operator *(const mat4<float>& m) const
+	{
+		mat4<float> res;
+#if defined(LINALG_AVX)
+		// two result columns at a time, one per 128-bit lane
+		const __m256 c0 = _mm256_broadcast_ps((const __m128*)col[0].vec);
+		const __m256 c1 = _mm256_broadcast_ps((const __m128*)col[1].vec);
+		const __m256 c2 = _mm256_broadcast_ps((const __m128*)col[2].vec);
+		const __m256 c3 = _mm256_broadcast_ps((const __m128*)col[3].vec);
+		for (int j = 0; j < 4; j += 2)
+		{
+			__m256 b = _mm256_loadu_ps(m.col[j].vec);
+			__m256 r = _mm256_mul_ps(c0, _mm256_shuffle_ps(b, b, 0x00));
+			r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_shuffle_ps(b, b, 0x55)));
+			r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_shuffle_ps(b, b, 0xaa)));
+			r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_shuffle_ps(b, b, 0xff)));
+			_mm256_storeu_ps(res.col[j].vec, r);
+		}
+#else
+		const __m128 c0 = _mm_loadu_ps(col[0].vec);
+		const __m128 c1 = _mm_loadu_ps(col[1].vec);
+		const __m128 c2 = _mm_loadu_ps(col[2].vec);
+		const __m128 c3 = _mm_loadu_ps(col[3].vec);
+		for (int j = 0; j < 4; j++)
+		{
+			__m128 b = _mm_loadu_ps(m.col[j].vec);
+			__m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(b, b, 0x00));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(b, b, 0x55)));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(b, b, 0xaa)));
+			r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(b, b, 0xff)));
+			_mm_storeu_ps(res.col[j].vec, r);
+		}
+#endif
+		return res;
+	}
+
+	template<>
+	inline void mat4<float>::transpose()
+	{
+		__m128 c0 = _mm_loadu_ps(col[0].vec);
+		__m128 c1 = _mm_loadu_ps(col[1].vec);
+		__m128 c2 = _mm_loadu_ps(col[2].vec);
+		__m128 c3 = _mm_loadu_ps(col[3].vec);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		_mm_storeu_ps(col[0].vec, c0);
+		_mm_storeu_ps(col[1].vec, c1);
+		_mm_storeu_ps(col[2].vec, c2);
+		_mm_storeu_ps(col[3].vec, c3);
+	}
+
+	namespace simd
+	{
+		// 2x2 matrices packed as (m11, m12, m21, m22)
+
+		inline __m128 mat2_mul(__m128 a, __m128 b)
+		{
+			return _mm_add_ps(	_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+								_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+		}
+
+		// adjugate(a) * b
+		inline __m128 mat2_adj_mul(__m128 a, __m128 b)
+		{
+			return _mm_sub_ps(	_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+								_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+		}
+
+		// a * adjugate(b)
+		inline __m128 mat2_mul_adj(__m128 a, __m128 b)
+		{
+			return _mm_sub_ps(	_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+								_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+		}
+
+		// the 3 floats at p, with 0 in the fourth lane, without reading past them
+		inline __m128 load3(const float* p)
+		{
+			return _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((const double*)p)), _mm_load_ss(p + 2));
+		}
+
+		inline void store3(float* p, __m128 v)
+		{
+			_mm_storel_pi((__m64*)p, v);
+			_mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+		}
+
+		inline __m128 splat(__m128 v, int i)
+		{
+			switch (i)
+			{
+			case 0: return _mm_shuffle_ps(v, v, 0x00);
+			case 1: return _mm_shuffle_ps(v, v, 0x55);
+			case 2: return _mm_shuffle_ps(v, v, 0xaa);
+			default: return _mm_shuffle_ps(v, v, 0xff);
+			}
+		}
+	}
+
+	//
+	// Block inverse: with M = | A B |, the blocks of the inverse are adjugates of
+	//                         | C D |
+	//   X# = |D|A - B(D#C),  W# = |A|D - C(A#B),  Y# = |B|C - D(A#B)#,  Z# = |C|B - A(D#C)#
+	// scaled by 1/|M|, where |M| = |A||D| + |B||C| - tr((A#B)(D#C)).
+	// (Eric Zhang, "Fast 4x4 Matrix Inverse with SSE SIMD, Explained", 2019)
+	//
+	// Written for row-major storage; run on the column-major array it inverts the
+	// transpose, which is the transpose of the inverse, so the result comes out right.
+	//
+	template<>
+	inline mat4<float> mat4<float>::inverse() const
+	{
+		using namespace simd;
+		const __m128 r0 = _mm_loadu_ps(col[0].vec);
+		const __m128 r1 = _mm_loadu_ps(col[1].vec);
+		const __m128 r2 = _mm_loadu_ps(col[2].vec);
+		const __m128 r3 = _mm_loadu_ps(col[3].vec);
+
+		__m128 A = _mm_movelh_ps(r0, r1);
+		__m128 B = _mm_movehl_ps(r1, r0);
+		__m128 C = _mm_movelh_ps(r2, r3);
+		__m128 D = _mm_movehl_ps(r3, r2);
+
+		// (|A|, |B|, |C|, |D|)
+		__m128 det_sub = _mm_sub_ps(
+			_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+			_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+		__m128 det_A = splat(det_sub, 0), det_B = splat(det_sub, 1);
+		__m128 det_C = splat(det_sub, 2), det_D = splat(det_sub, 3);
+
+		__m128 D_C = mat2_adj_mul(D, C);
+		__m128 A_B = mat2_adj_mul(A, B);
+		__m128 X_ = _mm_sub_ps(_mm_mul_ps(det_D, A), mat2_mul(B, D_C));
+		__m128 W_ = _mm_sub_ps(_mm_mul_ps(det_A, D), mat2_mul(C, A_B));
+		__m128 Y_ = _mm_sub_ps(_mm_mul_ps(det_B, C), mat2_mul_adj(D, A_B));
+		__m128 Z_ = _mm_sub_ps(_mm_mul_ps(det_C, B), mat2_mul_adj(A, D_C));
+
+		// tr((A#B)(D#C)), summed into every lane
+		__m128 tr = _mm_mul_ps(A_B, _mm_shuffle_ps(D_C, D_C, _MM_SHUFFLE(3, 1, 2, 0)));
+		tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(2, 3, 0, 1)));
+		tr = _mm_add_ps(tr, _mm_shuffle_ps(tr, tr, _MM_SHUFFLE(1, 0, 3, 2)));
+
+		__m128 det_M = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_A, det_D), _mm_mul_ps(det_B, det_C)), tr);
+		assert(std::abs(_mm_cvtss_f32(det_M)) > 1e-8);
+
+		// 1/|M| with the signs of the adjugate
+		__m128 rdet_M = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det_M);
+		X_ = _mm_mul_ps(X_, rdet_M);
+		Y_ = _mm_mul_ps(Y_, rdet_M);
+		Z_ = _mm_mul_ps(Z_, rdet_M);
+		W_ = _mm_mul_ps(W_, rdet_M);
+
+		// the adjugates, as rows
+		mat4<float> res;
+		_mm_storeu_ps(res.col[0].vec, _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(1, 3, 1, 3)));
+		_mm_storeu_ps(res.col[1].vec, _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(0, 2, 0, 2)));
+		_mm_storeu_ps(res.col[2].vec, _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(1, 3, 1, 3)));
+		_mm_storeu_ps(res.col[3].vec, _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(0, 2, 0, 2)));
+		return res;
+	}
+
+	//
+	// The columns of an affine3x4 are 3 floats apart; 4-float loads of the first three
+	// pick up the next column's x in the last lane, which is never stored
+	//
+	template<>
+	inline affine3x4<float> affine3x4<float>::operator *(const affine3x4<float>& m) const
+	{
+		using namespace simd;
+		const __m128 c0 = _mm_loadu_ps(col[0].vec);
+		const __m128 c1 = _mm_loadu_ps(col[1].vec);
+		const __m128 c2 = _mm_loadu_ps(col[2].vec);
+		const __m128 c3 = load3(col[3].vec);
+
+		auto column = [&](__m128 b)
+		{
+			__m128 r = _mm_mul_ps(c0, splat(b, 0));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, splat(b, 1)));
+			return _mm_add_ps(r, _mm_mul_ps(c2, splat(b, 2)));
+		};
+		__m128 r0 = column(_mm_loadu_ps(m.col[0].vec));
+		__m128 r1 = column(_mm_loadu_ps(m.col[1].vec));
+		__m128 r2 = column(_mm_loadu_ps(m.col[2].vec));
+		__m128 r3 = _mm_add_ps(column(load3(m.col[3].vec)), c3);
+
+		// packed into three registers: (r0.xyz, r1.x), (r1.yz, r2.xy), (r2.z, r3.xyz)
+		affine3x4<float> res;
+		_mm_storeu_ps(res.array, _mm_shuffle_ps(r0, _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(0, 0, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0)));
+		_mm_storeu_ps(res.array + 4, _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(1, 0, 2, 1)));
+		_mm_storeu_ps(res.array + 8, _mm_shuffle_ps(_mm_shuffle_ps(r2, r3, _MM_SHUFFLE(0, 0, 2, 2)), r3, _MM_SHUFFLE(2, 1, 2, 0)));
+		return res;
+	}
+
+	template<>
+	inline vec4<float> affine3x4<float>::operator *(const vec4<float>& v) const
+	{
+		__m128 r = _mm_mul_ps(_mm_loadu_ps(col[0].vec), _mm_set1_ps(v.x));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[1].vec), _mm_set1_ps(v.y)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[2].vec), _mm_set1_ps(v.z)));
+		r = _mm_add_ps(r, _mm_mul_ps(simd::load3(col[3].vec), _mm_set1_ps(v.w)));
+
+		// (r.x, r.y, r.z, v.w)
+		__m128 zw = _mm_shuffle_ps(r, _mm_loadu_ps(v.vec), _MM_SHUFFLE(3, 3, 2, 2));
+		vec4<float> res;
+		_mm_storeu_ps(res.vec, _mm_shuffle_ps(r, zw, _MM_SHUFFLE(2, 0, 1, 0)));
+		return res;
+	}
+
+	template<>
+	inline vec3<float> affine3x4<float>::transform_point(const vec3<float>& p) const
+	{
+		__m128 r = _mm_mul_ps(_mm_loadu_ps(col[0].vec), _mm_set1_ps(p.x));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[1].vec), _mm_set1_ps(p.y)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(col[2].vec), _mm_set1_ps(p.z)));
+		r = _mm_add_ps(r, simd::load3(col[3].vec));
+
+		vec3<float> res;
+		simd::store3(res.vec, r);
+		return res;
+	}
+
+#elif defined(LINALG_NEON)
+
+	template<>
+	inline vec4<float> mat4<float>::operator *(const vec4<float>& v) const
+	{
+		float32x4_t r = vmulq_n_f32(vld1q_f32(col[0].vec), v.x);
+		r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(col[1].vec), v.y));
+		r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(col[2].vec), v.z));
+		r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(col[3].vec), v.w));
+
+		vec4<float> res;
+		vst1q_f32(res.vec, r);
+		return res;
+	}
+
+	template<>
+	inline mat4<float> mat4<float>::operator *(const mat4<float>& m) const
+	{
+		const float32x4_t c0 = vld1q_f32(col[0].vec);
+		const float32x4_t c1 = vld1q_f32(col[1].vec);
+		const float32x4_t c2 = vld1q_f32(col[2].vec);
+		const float32x4_t c3 = vld1q_f32(col[3].vec);
+
+		// separate multiplies and adds (not vmlaq/vfmaq), like the scalar code
+		mat4<float> res;
+		for (int j = 0; j < 4; j++)
+		{
+			float32x4_t b = vld1q_f32(m.col[j].vec);
+			float32x4_t r = vmulq_lane_f32(c0, vget_low_f32(b), 0);
+			r = vaddq_f32(r, vmulq_lane_f32(c1, vget_low_f32(b), 1));
+			r = vaddq_f32(r, vmulq_lane_f32(c2, vget_high_f32(b), 0));
+			r = vaddq_f32(r, vmulq_lane_f32(c3, vget_high_f32(b), 1));
+			vst1q_f32(res.col[j].vec, r);
+		}
+		return res;
+	}
+
+	template<>
+	inline void mat4<float>::transpose()
+	{
+		// de-interleaving load: lane i of val[k] is element k of column i
+		float32x4x4_t rows = vld4q_f32(array);
+		vst1q_f32(col[0].vec, rows.val[0]);
+		vst1q_f32(col[1].vec, rows.val[1]);
+		vst1q_f32(col[2].vec, rows.val[2]);
+		vst1q_f32(col[3].vec, rows.val[3]);
+	}
+
+#endif
+
+#endif /* LINALG_SIMD */
+
+	//
+	// Times multiply, mat4 * vec4, transpose and inverse of mat4f against their scalar
+	// versions over arrays of random matrices, plus a chain of dependent multiplies like
+	// a transform hierarchy, and prints ns per operation and the largest differences
+	//
+	void benchmark_mat4(unsigned nbr_matrices = 4096, unsigned rounds = 200);
+
+	//
+	// Times building, composing, inverting and applying affine3x4f transforms, and
+	// deriving their normal matrices, against doing the same with mat4f
+	//
+	void benchmark_affine(unsigned nbr_transforms = 4096, unsigned rounds = 200);
+}
+
+#endif /* MAT_SIMD_H */
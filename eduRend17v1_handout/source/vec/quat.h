@@ -0,0 +1,296 @@
+//
+//	quat.h
+//
+//	Unit quaternions for rotations
+//
+
+#pragma once
+#ifndef QUAT_H
+#define QUAT_H
+
+#include <cmath>
+#include "vec.h"
+#include "mat.h"
+
+//
+// q = (x, y, z, w) = (u sin(theta/2), cos(theta/2)) rotates by theta around the unit
+// vector u, counterclockwise as mat3::rotation does. q and -q are the same rotation.
+// Products compose like matrices: (a * b).rotate(v) == a.rotate(b.rotate(v)), and
+// to_mat3(a * b) == to_mat3(a) * to_mat3(b).
+//
+// Four numbers instead of nine, two sin/cos per axis rotation instead of three pairs for
+// the Euler matrix, and interpolation that stays a rotation; convert to a matrix once
+// per object (or per 3x3 part of an affine3x4) before transforming vertices.
+//
+namespace linalg
+{
+    template<class T> class quat
+    {
+    public:
+        union
+        {
+            T vec[4];
+            struct { T x, y, z, w; };
+        };
+
+        //
+        // constructor: identity
+        //
+        constexpr quat() : x(0), y(0), z(0), w(1) { }
+
+        constexpr quat(const T& x, const T& y, const T& z, const T& w) : x(x), y(y), z(z), w(w) { }
+
+        constexpr quat(const vec3<T>& v, const T& w) : x(v.x), y(v.y), z(v.z), w(w) { }
+
+        static constexpr quat<T> identity()
+        {
+            return quat<T>();
+        }
+
+        //
+        // Rotation theta around the normalized vector (x, y, z), as mat3::rotation
+        //
+        static quat<T> rotation(const T& theta, const T& x, const T& y, const T& z)
+        {
+            T s = std::sin(theta * T(0.5));
+            return quat<T>(x*s, y*s, z*s, std::cos(theta * T(0.5)));
+        }
+
+        static quat<T> rotation(const T& theta, const vec3<T>& v)
+        {
+            return rotation(theta, v.x, v.y, v.z);
+        }
+
+        //
+        // Rz(roll) * Ry(yaw) * Rx(pitch), the rotation mat4::rotation(roll, yaw, pitch) builds
+        // (that one has m13 sign-flipped when roll is not zero)
+        //
+        static quat<T> rotation(const T& roll, const T& yaw, const T& pitch)
+        {
+            T sr = std::sin(roll * T(0.5)), cr = std::cos(roll * T(0.5));
+            T sy = std::sin(yaw * T(0.5)), cy = std::cos(yaw * T(0.5));
+            T sp = std::sin(pitch * T(0.5)), cp = std::cos(pitch * T(0.5));
+
+            return quat<T>(cr*cy*sp - sr*sy*cp,
+                           cr*sy*cp + sr*cy*sp,
+                           sr*cy*cp - cr*sy*sp,
+                           cr*cy*cp + sr*sy*sp);
+        }
+
+        constexpr vec3<T> xyz() const
+        {
+            return vec3<T>(x, y, z);
+        }
+
+        //
+        // Hamilton product: b first, then this
+        //
+        constexpr quat<T> operator *(const quat<T>& b) const
+        {
+            return quat<T>(w*b.x + x*b.w + y*b.z - z*b.y,
+                           w*b.y - x*b.z + y*b.w + z*b.x,
+                           w*b.z + x*b.y - y*b.x + z*b.w,
+                           w*b.w - x*b.x - y*b.y - z*b.z);
+        }
+
+        quat<T>& operator *=(const quat<T>& b)
+        {
+            return *this = *this * b;
+        }
+
+        constexpr quat<T> operator -() const
+        {
+            return quat<T>(-x, -y, -z, -w);
+        }
+
+        constexpr T dot(const quat<T>& b) const
+        {
+            return x*b.x + y*b.y + z*b.z + w*b.w;
+        }
+
+        constexpr T norm2squared() const
+        {
+            return x*x + y*y + z*z + w*w;
+        }
+
+        //
+        // The inverse rotation, for unit quaternions
+        //
+        constexpr quat<T> conjugate() const
+        {
+            return quat<T>(-x, -y, -z, w);
+        }
+
+        //
+        // Inverse of any non-zero quaternion
+        //
+        quat<T> inverse() const
+        {
+            T in2 = T(1.0) / norm2squared();
+            return quat<T>(-x*in2, -y*in2, -z*in2, w*in2);
+        }
+
+        //
+        // Scale to unit length; products of unit quaternions drift away from it slowly,
+        // so renormalize those that are updated incrementally every now and then
+        //
+        quat<T>& normalize()
+        {
+            T n2 = norm2squared();
+
+            if (n2 < 1e-8)
+                *this = quat<T>();
+            else
+            {
+                T in = T(1.0) / std::sqrt(n2);
+                x *= in; y *= in; z *= in; w *= in;
+            }
+            return *this;
+        }
+
+        //
+        // v rotated by this unit quaternion: v + w t + u x t, with t = 2 u x v
+        // (15 multiplies, to the 9 of a matrix, but without building one)
+        //
+        constexpr vec3<T> rotate(const vec3<T>& v) const
+        {
+            return rotate(v, vec3<T>(T(2) * (y*v.z - z*v.y), T(2) * (z*v.x - x*v.z), T(2) * (x*v.y - y*v.x)));
+        }
+
+        //
+        // Rotation matrix of this unit quaternion
+        //
+        constexpr mat3<T> to_mat3() const
+        {
+            return mat3<T>(1 - 2*(y*y + z*z), 2*(x*y - w*z), 2*(x*z + w*y),
+                           2*(x*y + w*z), 1 - 2*(x*x + z*z), 2*(y*z - w*x),
+                           2*(x*z - w*y), 2*(y*z + w*x), 1 - 2*(x*x + y*y));
+        }
+
+        constexpr mat4<T> to_mat4() const
+        {
+            return mat4<T>(1 - 2*(y*y + z*z), 2*(x*y - w*z), 2*(x*z + w*y), 0,
+                           2*(x*y + w*z), 1 - 2*(x*x + z*z), 2*(y*z - w*x), 0,
+                           2*(x*z - w*y), 2*(y*z + w*x), 1 - 2*(x*x + y*y), 0,
+                           0, 0, 0, 1);
+        }
+
+        //
+        // Unit quaternion of the rotation matrix R (Shepperd: from the largest of the
+        // trace and the diagonal elements, for precision)
+        //
+        static quat<T> from_mat3(const mat3<T>& R)
+        {
+            T tr = R.m11 + R.m22 + R.m33;
+            quat<T> q;
+            if (tr > 0)
+            {
+                T s = T(0.5) / std::sqrt(tr + 1);
+                q = quat<T>((R.m32 - R.m23)*s, (R.m13 - R.m31)*s, (R.m21 - R.m12)*s, T(0.25) / s);
+            }
+            else if (R.m11 > R.m22 && R.m11 > R.m33)
+            {
+                T s = T(0.5) / std::sqrt(1 + R.m11 - R.m22 - R.m33);
+                q = quat<T>(T(0.25) / s, (R.m12 + R.m21)*s, (R.m13 + R.m31)*s, (R.m32 - R.m23)*s);
+            }
+            else if (R.m22 > R.m33)
+            {
+                T s = T(0.5) / std::sqrt(1 + R.m22 - R.m11 - R.m33);
+                q = quat<T>((R.m12 + R.m21)*s, T(0.25) / s, (R.m23 + R.m32)*s, (R.m13 - R.m31)*s);
+            }
+            else
+            {
+                T s = T(0.5) / std::sqrt(1 + R.m33 - R.m11 - R.m22);
+                q = quat<T>((R.m13 + R.m31)*s, (R.m23 + R.m32)*s, T(0.25) / s, (R.m21 - R.m12)*s);
+            }
+            return q.normalize();
+        }
+
+    private:
+        constexpr vec3<T> rotate(const vec3<T>& v, const vec3<T>& t) const
+        {
+            return vec3<T>(v.x + w*t.x + (y*t.z - z*t.y),
+                           v.y + w*t.y + (z*t.x - x*t.z),
+                           v.z + w*t.z + (x*t.y - y*t.x));
+        }
+    };
+
+    //
+    // Normalized linear interpolation along the shorter arc: a and b at t = 0 and 1, but
+    // not at constant angular speed (up to about 8 degrees off slerp halfway between
+    // opposite rotations). Enough for small steps, e.g. between animation keys.
+    //
+    template<class T>
+    inline quat<T> nlerp(const quat<T>& a, const quat<T>& b, const T& t)
+    {
+        T d = a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w;
+        T tb = d < 0 ? -t : t, ta = 1 - t;
+        quat<T> r(a.x*ta + b.x*tb, a.y*ta + b.y*tb, a.z*ta + b.z*tb, a.w*ta + b.w*tb);
+        T in = T(1.0) / std::sqrt(r.x*r.x + r.y*r.y + r.z*r.z + r.w*r.w);
+        return quat<T>(r.x*in, r.y*in, r.z*in, r.w*in);
+    }
+
+    //
+    // Spherical linear interpolation along the shorter arc, at constant angular speed;
+    // nlerp where a and b are so close that sin(angle) loses precision
+    //
+    template<class T>
+    inline quat<T> slerp(const quat<T>& a, const quat<T>& b, const T& t)
+    {
+        T d = a.dot(b);
+        T sign = d < 0 ? T(-1) : T(1);
+        d *= sign;
+        if (d > T(0.9995))
+            return nlerp(a, b, t);
+
+        T theta = std::acos(d), is = T(1.0) / std::sin(theta);
+        T ta = std::sin((1 - t)*theta) * is, tb = std::sin(t*theta) * is * sign;
+        return quat<T>(a.x*ta + b.x*tb, a.y*ta + b.y*tb, a.z*ta + b.z*tb, a.w*ta + b.w*tb);
+    }
+
+    //
+    // nlerp with t bent by a polynomial in |a.b| so the speed is close to constant:
+    // within a tenth of a degree of slerp, at about the cost of nlerp (no acos or sin).
+    // Fit by A. Kapoulkine, "Approximating slerp", 2015.
+    //
+    template<class T>
+    inline T fast_slerp_t(const T& d, const T& t)
+    {
+        T ad = std::abs(d);
+        T ca = T(1.0904) + ad * (T(-3.2452) + ad * (T(3.55645) - ad * T(1.43519)));
+        T cb = T(0.848013) + ad * (T(-1.06021) + ad * T(0.215638));
+        T k = ca * (t - T(0.5)) * (t - T(0.5)) + cb;
+        return t + t * (t - T(0.5)) * (t - 1) * k;
+    }
+
+    template<class T>
+    inline quat<T> fast_slerp(const quat<T>& a, const quat<T>& b, const T& t)
+    {
+        return nlerp(a, b, fast_slerp_t(a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w, t));
+    }
+
+    //
+    // affine3x4 members that need quat
+    //
+    template<class T>
+    constexpr affine3x4<T>::affine3x4(const quat<T>& r, const vec3<T>& t)
+        : affine3x4(r.to_mat3(), t)
+    {
+    }
+
+    template<class T>
+    affine3x4<T> affine3x4<T>::TRS(const vec3<T>& vt, const quat<T>& r, const vec3<T>& sv)
+    {
+        affine3x4<T> M(r, vt);
+        M.col[0] *= sv.x;
+        M.col[1] *= sv.y;
+        M.col[2] *= sv.z;
+        return M;
+    }
+
+    typedef quat<float> quatf;
+
+    constexpr quatf quatf_identity = quatf();
+}
+
+#endif /* QUAT_H */
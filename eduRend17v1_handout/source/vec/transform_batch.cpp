@@ -0,0 +1,982 @@
+//
+//	transform_batch.cpp
+//
+//	Transforming arrays of points, vectors, normals and boxes by one matrix, and
+//	interpolating arrays of rotations
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <vector>
+#include "transform_batch.h"
+#include "../parallel.h"
+
+#if defined(LINALG_SSE)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX
+#else
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+// vdivq, vsqrtq and the across-vector min/max are AArch64 only
+#if defined(LINALG_NEON) && (defined(__aarch64__) || defined(_M_ARM64))
+#define TRANSFORM_BATCH_NEON
+#endif
+
+namespace linalg
+{
+	namespace
+	{
+		enum
+		{
+			TRANSLATE = 1,		// points, otherwise directions
+			RENORMALIZE = 2
+		};
+
+		// below this many elements per thread, starting threads costs more than it saves
+		const size_t min_elements_per_thread = 1 << 15;
+
+		//
+		// parallel_for (parallel.h) on boundaries that are multiples of 16 elements, so no
+		// two threads write the same cache line
+		//
+		template<class F>
+		void parallel_for(size_t n, unsigned nbr_threads, F fn)
+		{
+			::parallel_for(n, nbr_threads, min_elements_per_thread, fn, 16);
+		}
+
+		//
+		// Scalar versions, for the tails and for builds without SIMD. The SIMD code does
+		// the same operations in the same order.
+		//
+		inline vec3f renormalized(const vec3f& v)
+		{
+			float n2 = v.x*v.x + v.y*v.y + v.z*v.z;
+			float s = n2 > 0 ? 1.0f / sqrtf(n2) : 0.0f;
+			return vec3f(v.x * s, v.y * s, v.z * s);
+		}
+
+		inline vec3f map(const affine3x4f& M, unsigned flags, const vec3f& v)
+		{
+			vec3f r = flags & TRANSLATE ? M.transform_point(v) : M.transform_vector(v);
+			return flags & RENORMALIZE ? renormalized(r) : r;
+		}
+
+		struct soa_t
+		{
+			const float* in[3];
+			float* out[3];
+		};
+
+		void map_soa_scalar(const affine3x4f& M, unsigned flags, const soa_t& s, size_t i, size_t end)
+		{
+			for (; i < end; i++)
+			{
+				vec3f r = map(M, flags, vec3f(s.in[0][i], s.in[1][i], s.in[2][i]));
+				s.out[0][i] = r.x;
+				s.out[1][i] = r.y;
+				s.out[2][i] = r.z;
+			}
+		}
+
+		void bounds_soa_scalar(const affine3x4f& M, const soa_t& s, size_t i, size_t end, aabb3f& box)
+		{
+			for (; i < end; i++)
+			{
+				vec3f r = M.transform_point(vec3f(s.in[0][i], s.in[1][i], s.in[2][i]));
+				box.lo = vec3f(std::min(box.lo.x, r.x), std::min(box.lo.y, r.y), std::min(box.lo.z, r.z));
+				box.hi = vec3f(std::max(box.hi.x, r.x), std::max(box.hi.y, r.y), std::max(box.hi.z, r.z));
+			}
+		}
+
+		aabb3f transform_aabb(const affine3x4f& M, const aabb3f& b)
+		{
+			aabb3f r;
+			if (b.lo.x > b.hi.x || b.lo.y > b.hi.y || b.lo.z > b.hi.z)
+			{
+				r.lo = vec3f(FLT_MAX, FLT_MAX, FLT_MAX);
+				r.hi = vec3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				return r;
+			}
+			vec3f c = (b.lo + b.hi) * 0.5f, e = (b.hi - b.lo) * 0.5f;
+			vec3f a0(std::abs(M.m11), std::abs(M.m21), std::abs(M.m31));
+			vec3f a1(std::abs(M.m12), std::abs(M.m22), std::abs(M.m32));
+			vec3f a2(std::abs(M.m13), std::abs(M.m23), std::abs(M.m33));
+			c = M.transform_point(c);
+			e = a0*e.x + a1*e.y + a2*e.z;
+			r.lo = c - e;
+			r.hi = c + e;
+			return r;
+		}
+
+		aabb3f empty_aabb()
+		{
+			aabb3f b;
+			b.lo = vec3f(FLT_MAX, FLT_MAX, FLT_MAX);
+			b.hi = vec3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			return b;
+		}
+
+		inline quatf lerp_quat(const quatf& a, const quatf& b, float t, bool fast)
+		{
+			return fast ? fast_slerp(a, b, t) : nlerp(a, b, t);
+		}
+
+#if defined(LINALG_SSE)
+
+		bool cpu_has_avx()
+		{
+#if defined(LINALG_AVX)
+			return true;
+#elif defined(_MSC_VER)
+			// AVX, and enabled by the OS (XMM and YMM state saved)
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+#else
+			return __builtin_cpu_supports("avx") != 0;
+#endif
+		}
+
+		bool use_avx()
+		{
+			static const bool has_avx = cpu_has_avx();
+			return has_avx;
+		}
+
+		//
+		// The 3x4 matrix with each element in all lanes, column-major like affine3x4f
+		//
+		struct splat_sse_t
+		{
+			__m128 m[12];
+
+			explicit splat_sse_t(const affine3x4f& M)
+			{
+				for (int k = 0; k < 12; k++)
+					m[k] = _mm_set1_ps(M.array[k]);
+			}
+		};
+
+		inline void map_sse(const splat_sse_t& M, unsigned flags, __m128& x, __m128& y, __m128& z)
+		{
+			__m128 r[3];
+			for (int c = 0; c < 3; c++)
+			{
+				r[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(M.m[c], x), _mm_mul_ps(M.m[3 + c], y)), _mm_mul_ps(M.m[6 + c], z));
+				if (flags & TRANSLATE)
+					r[c] = _mm_add_ps(r[c], M.m[9 + c]);
+			}
+			if (flags & RENORMALIZE)
+			{
+				__m128 n2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], r[0]), _mm_mul_ps(r[1], r[1])), _mm_mul_ps(r[2], r[2]));
+				__m128 s = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(n2));
+				s = _mm_and_ps(s, _mm_cmpgt_ps(n2, _mm_setzero_ps()));
+				for (int c = 0; c < 3; c++)
+					r[c] = _mm_mul_ps(r[c], s);
+			}
+			x = r[0];
+			y = r[1];
+			z = r[2];
+		}
+
+		size_t map_soa_sse(const affine3x4f& M, unsigned flags, const soa_t& s, size_t i, size_t end)
+		{
+			splat_sse_t m(M);
+			for (; i + 4 <= end; i += 4)
+			{
+				__m128 x = _mm_loadu_ps(s.in[0] + i), y = _mm_loadu_ps(s.in[1] + i), z = _mm_loadu_ps(s.in[2] + i);
+				map_sse(m, flags, x, y, z);
+				_mm_storeu_ps(s.out[0] + i, x);
+				_mm_storeu_ps(s.out[1] + i, y);
+				_mm_storeu_ps(s.out[2] + i, z);
+			}
+			return i;
+		}
+
+		//
+		// Four vec3f, as (x0 y0 z0 x1) (y1 z1 x2 y2) (z2 x3 y3 z3), to and from x, y and z
+		// of each in a register
+		//
+		inline void deinterleave_sse(const float* p, __m128& x, __m128& y, __m128& z)
+		{
+			__m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+			x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+			y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), c, _MM_SHUFFLE(3, 0, 2, 0));
+		}
+
+		inline void interleave_sse(float* p, __m128 x, __m128 y, __m128 z)
+		{
+			__m128 a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 0, 1, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			_mm_storeu_ps(p, a);
+			_mm_storeu_ps(p + 4, b);
+			_mm_storeu_ps(p + 8, c);
+		}
+
+		size_t map_aos_sse(const affine3x4f& M, unsigned flags, const vec3f* in, vec3f* out, size_t i, size_t end)
+		{
+			splat_sse_t m(M);
+			for (; i + 4 <= end; i += 4)
+			{
+				__m128 x, y, z;
+				deinterleave_sse(in[i].vec, x, y, z);
+				map_sse(m, flags, x, y, z);
+				interleave_sse(out[i].vec, x, y, z);
+			}
+			return i;
+		}
+
+		size_t bounds_soa_sse(const affine3x4f& M, const soa_t& s, size_t i, size_t end, aabb3f& box)
+		{
+			splat_sse_t m(M);
+			__m128 lo[3], hi[3];
+			for (int c = 0; c < 3; c++)
+			{
+				lo[c] = _mm_set1_ps(box.lo.vec[c]);
+				hi[c] = _mm_set1_ps(box.hi.vec[c]);
+			}
+			for (; i + 4 <= end; i += 4)
+			{
+				__m128 r[3] = { _mm_loadu_ps(s.in[0] + i), _mm_loadu_ps(s.in[1] + i), _mm_loadu_ps(s.in[2] + i) };
+				map_sse(m, TRANSLATE, r[0], r[1], r[2]);
+				for (int c = 0; c < 3; c++)
+				{
+					lo[c] = _mm_min_ps(lo[c], r[c]);
+					hi[c] = _mm_max_ps(hi[c], r[c]);
+				}
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				float l[4], h[4];
+				_mm_storeu_ps(l, lo[c]);
+				_mm_storeu_ps(h, hi[c]);
+				box.lo.vec[c] = std::min(std::min(l[0], l[1]), std::min(l[2], l[3]));
+				box.hi.vec[c] = std::max(std::max(h[0], h[1]), std::max(h[2], h[3]));
+			}
+			return i;
+		}
+
+		//
+		// mat4f * vec4f as in mat_simd.h, with the columns loaded once
+		//
+		size_t map_vec4_sse(const mat4f& M, const vec4f* in, vec4f* out, size_t i, size_t end)
+		{
+			__m128 c0 = _mm_loadu_ps(M.col[0].vec), c1 = _mm_loadu_ps(M.col[1].vec);
+			__m128 c2 = _mm_loadu_ps(M.col[2].vec), c3 = _mm_loadu_ps(M.col[3].vec);
+			for (; i < end; i++)
+			{
+				__m128 v = _mm_loadu_ps(in[i].vec);
+				__m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+				r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+				r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+				r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+				_mm_storeu_ps(out[i].vec, r);
+			}
+			return i;
+		}
+
+		//
+		// Two boxes' worth of loads per box: (lo, hi.x) and (lo.z, hi), which stay inside it
+		//
+		size_t map_aabbs_sse(const affine3x4f& M, const aabb3f* in, aabb3f* out, size_t i, size_t end)
+		{
+			const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+			__m128 col[4], abs_col[3];
+			for (int k = 0; k < 4; k++)
+				col[k] = _mm_setr_ps(M.col[k].x, M.col[k].y, M.col[k].z, 0.0f);
+			for (int k = 0; k < 3; k++)
+				abs_col[k] = _mm_and_ps(col[k], abs_mask);
+			const __m128 half = _mm_set1_ps(0.5f);
+
+			for (; i < end; i++)
+			{
+				__m128 lo = _mm_loadu_ps(&in[i].lo.x), hi = _mm_loadu_ps(&in[i].lo.z);
+				hi = _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(3, 3, 2, 1));
+				if (_mm_movemask_ps(_mm_cmpgt_ps(lo, hi)) & 7)
+				{
+					out[i] = empty_aabb();
+					continue;
+				}
+				__m128 c = _mm_mul_ps(_mm_add_ps(lo, hi), half), e = _mm_mul_ps(_mm_sub_ps(hi, lo), half);
+
+				__m128 rc = _mm_mul_ps(col[0], _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)));
+				rc = _mm_add_ps(rc, _mm_mul_ps(col[1], _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1))));
+				rc = _mm_add_ps(rc, _mm_mul_ps(col[2], _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2))));
+				rc = _mm_add_ps(rc, col[3]);
+				__m128 re = _mm_mul_ps(abs_col[0], _mm_shuffle_ps(e, e, _MM_SHUFFLE(0, 0, 0, 0)));
+				re = _mm_add_ps(re, _mm_mul_ps(abs_col[1], _mm_shuffle_ps(e, e, _MM_SHUFFLE(1, 1, 1, 1))));
+				re = _mm_add_ps(re, _mm_mul_ps(abs_col[2], _mm_shuffle_ps(e, e, _MM_SHUFFLE(2, 2, 2, 2))));
+
+				// the 4-float store spills into hi.x, which store3 then writes
+				_mm_storeu_ps(&out[i].lo.x, _mm_sub_ps(rc, re));
+				simd::store3(&out[i].hi.x, _mm_add_ps(rc, re));
+			}
+			return i;
+		}
+
+		//
+		// fast_slerp_t in each lane
+		//
+		inline __m128 fast_slerp_t_sse(__m128 d, __m128 t)
+		{
+			const __m128 half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.0f);
+			__m128 ad = _mm_andnot_ps(_mm_set1_ps(-0.0f), d);
+			__m128 ca = _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(ad, _mm_set1_ps(1.43519f)));
+			ca = _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(ad, ca));
+			ca = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(ad, ca));
+			__m128 cb = _mm_add_ps(_mm_set1_ps(-1.06021f), _mm_mul_ps(ad, _mm_set1_ps(0.215638f)));
+			cb = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(ad, cb));
+			__m128 th = _mm_sub_ps(t, half);
+			__m128 k = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ca, th), th), cb);
+			return _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, th), _mm_sub_ps(t, one)), k));
+		}
+
+		//
+		// Four quaternions transposed to x, y, z and w registers, interpolated as nlerp does
+		//
+		size_t lerp_quats_sse(const quatf* a, const quatf* b, float t, bool fast, quatf* out, size_t i, size_t end)
+		{
+			const __m128 vt = _mm_set1_ps(t), one = _mm_set1_ps(1.0f), sign = _mm_set1_ps(-0.0f);
+			for (; i + 4 <= end; i += 4)
+			{
+				__m128 ax = _mm_loadu_ps(a[i].vec), ay = _mm_loadu_ps(a[i + 1].vec), az = _mm_loadu_ps(a[i + 2].vec), aw = _mm_loadu_ps(a[i + 3].vec);
+				__m128 bx = _mm_loadu_ps(b[i].vec), by = _mm_loadu_ps(b[i + 1].vec), bz = _mm_loadu_ps(b[i + 2].vec), bw = _mm_loadu_ps(b[i + 3].vec);
+				_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+				_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz)), _mm_mul_ps(aw, bw));
+				__m128 tq = fast ? fast_slerp_t_sse(d, vt) : vt;
+				__m128 ta = _mm_sub_ps(one, tq);
+				__m128 tb = _mm_xor_ps(tq, _mm_and_ps(_mm_cmplt_ps(d, _mm_setzero_ps()), sign));
+				__m128 rx = _mm_add_ps(_mm_mul_ps(ax, ta), _mm_mul_ps(bx, tb));
+				__m128 ry = _mm_add_ps(_mm_mul_ps(ay, ta), _mm_mul_ps(by, tb));
+				__m128 rz = _mm_add_ps(_mm_mul_ps(az, ta), _mm_mul_ps(bz, tb));
+				__m128 rw = _mm_add_ps(_mm_mul_ps(aw, ta), _mm_mul_ps(bw, tb));
+				__m128 n2 = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz)), _mm_mul_ps(rw, rw));
+				__m128 in = _mm_div_ps(one, _mm_sqrt_ps(n2));
+				rx = _mm_mul_ps(rx, in);
+				ry = _mm_mul_ps(ry, in);
+				rz = _mm_mul_ps(rz, in);
+				rw = _mm_mul_ps(rw, in);
+
+				_MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+				_mm_storeu_ps(out[i].vec, rx);
+				_mm_storeu_ps(out[i + 1].vec, ry);
+				_mm_storeu_ps(out[i + 2].vec, rz);
+				_mm_storeu_ps(out[i + 3].vec, rw);
+			}
+			return i;
+		}
+
+		//
+		// Eight at a time over SoA; the functions are compiled for AVX and only called
+		// when the CPU has it
+		//
+		struct splat_avx_t
+		{
+			__m256 m[12];
+		};
+
+		TARGET_AVX inline void map_avx(const splat_avx_t& M, unsigned flags, __m256& x, __m256& y, __m256& z)
+		{
+			__m256 r[3];
+			for (int c = 0; c < 3; c++)
+			{
+				r[c] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(M.m[c], x), _mm256_mul_ps(M.m[3 + c], y)), _mm256_mul_ps(M.m[6 + c], z));
+				if (flags & TRANSLATE)
+					r[c] = _mm256_add_ps(r[c], M.m[9 + c]);
+			}
+			if (flags & RENORMALIZE)
+			{
+				__m256 n2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r[0], r[0]), _mm256_mul_ps(r[1], r[1])), _mm256_mul_ps(r[2], r[2]));
+				__m256 s = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(n2));
+				s = _mm256_and_ps(s, _mm256_cmp_ps(n2, _mm256_setzero_ps(), _CMP_GT_OQ));
+				for (int c = 0; c < 3; c++)
+					r[c] = _mm256_mul_ps(r[c], s);
+			}
+			x = r[0];
+			y = r[1];
+			z = r[2];
+		}
+
+		TARGET_AVX size_t map_soa_avx(const affine3x4f& M, unsigned flags, const soa_t& s, size_t i, size_t end)
+		{
+			splat_avx_t m;
+			for (int k = 0; k < 12; k++)
+				m.m[k] = _mm256_set1_ps(M.array[k]);
+			for (; i + 8 <= end; i += 8)
+			{
+				__m256 x = _mm256_loadu_ps(s.in[0] + i), y = _mm256_loadu_ps(s.in[1] + i), z = _mm256_loadu_ps(s.in[2] + i);
+				map_avx(m, flags, x, y, z);
+				_mm256_storeu_ps(s.out[0] + i, x);
+				_mm256_storeu_ps(s.out[1] + i, y);
+				_mm256_storeu_ps(s.out[2] + i, z);
+			}
+			_mm256_zeroupper();
+			return i;
+		}
+
+		TARGET_AVX size_t bounds_soa_avx(const affine3x4f& M, const soa_t& s, size_t i, size_t end, aabb3f& box)
+		{
+			splat_avx_t m;
+			for (int k = 0; k < 12; k++)
+				m.m[k] = _mm256_set1_ps(M.array[k]);
+			__m256 lo[3], hi[3];
+			for (int c = 0; c < 3; c++)
+			{
+				lo[c] = _mm256_set1_ps(box.lo.vec[c]);
+				hi[c] = _mm256_set1_ps(box.hi.vec[c]);
+			}
+			for (; i + 8 <= end; i += 8)
+			{
+				__m256 r[3] = { _mm256_loadu_ps(s.in[0] + i), _mm256_loadu_ps(s.in[1] + i), _mm256_loadu_ps(s.in[2] + i) };
+				map_avx(m, TRANSLATE, r[0], r[1], r[2]);
+				for (int c = 0; c < 3; c++)
+				{
+					lo[c] = _mm256_min_ps(lo[c], r[c]);
+					hi[c] = _mm256_max_ps(hi[c], r[c]);
+				}
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				float l[8], h[8];
+				_mm256_storeu_ps(l, lo[c]);
+				_mm256_storeu_ps(h, hi[c]);
+				box.lo.vec[c] = *std::min_element(l, l + 8);
+				box.hi.vec[c] = *std::max_element(h, h + 8);
+			}
+			_mm256_zeroupper();
+			return i;
+		}
+
+#elif defined(TRANSFORM_BATCH_NEON)
+
+		struct splat_neon_t
+		{
+			float32x4_t m[12];
+
+			explicit splat_neon_t(const affine3x4f& M)
+			{
+				for (int k = 0; k < 12; k++)
+					m[k] = vdupq_n_f32(M.array[k]);
+			}
+		};
+
+		// separate multiplies and adds, not vmlaq, which may be fused
+		inline float32x4x3_t map_neon(const splat_neon_t& M, unsigned flags, float32x4x3_t v)
+		{
+			float32x4x3_t r;
+			for (int c = 0; c < 3; c++)
+			{
+				r.val[c] = vaddq_f32(vaddq_f32(vmulq_f32(M.m[c], v.val[0]), vmulq_f32(M.m[3 + c], v.val[1])), vmulq_f32(M.m[6 + c], v.val[2]));
+				if (flags & TRANSLATE)
+					r.val[c] = vaddq_f32(r.val[c], M.m[9 + c]);
+			}
+			if (flags & RENORMALIZE)
+			{
+				float32x4_t n2 = vaddq_f32(vaddq_f32(vmulq_f32(r.val[0], r.val[0]), vmulq_f32(r.val[1], r.val[1])), vmulq_f32(r.val[2], r.val[2]));
+				float32x4_t s = vdivq_f32(vdupq_n_f32(1.0f), vsqrtq_f32(n2));
+				s = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(s), vcgtq_f32(n2, vdupq_n_f32(0.0f))));
+				for (int c = 0; c < 3; c++)
+					r.val[c] = vmulq_f32(r.val[c], s);
+			}
+			return r;
+		}
+
+		size_t map_soa_neon(const affine3x4f& M, unsigned flags, const soa_t& s, size_t i, size_t end)
+		{
+			splat_neon_t m(M);
+			for (; i + 4 <= end; i += 4)
+			{
+				float32x4x3_t v;
+				for (int c = 0; c < 3; c++)
+					v.val[c] = vld1q_f32(s.in[c] + i);
+				v = map_neon(m, flags, v);
+				for (int c = 0; c < 3; c++)
+					vst1q_f32(s.out[c] + i, v.val[c]);
+			}
+			return i;
+		}
+
+		// vld3q and vst3q deinterleave and interleave four vec3f
+		size_t map_aos_neon(const affine3x4f& M, unsigned flags, const vec3f* in, vec3f* out, size_t i, size_t end)
+		{
+			splat_neon_t m(M);
+			for (; i + 4 <= end; i += 4)
+				vst3q_f32(out[i].vec, map_neon(m, flags, vld3q_f32(in[i].vec)));
+			return i;
+		}
+
+		size_t bounds_soa_neon(const affine3x4f& M, const soa_t& s, size_t i, size_t end, aabb3f& box)
+		{
+			splat_neon_t m(M);
+			float32x4_t lo[3], hi[3];
+			for (int c = 0; c < 3; c++)
+			{
+				lo[c] = vdupq_n_f32(box.lo.vec[c]);
+				hi[c] = vdupq_n_f32(box.hi.vec[c]);
+			}
+			for (; i + 4 <= end; i += 4)
+			{
+				float32x4x3_t v;
+				for (int c = 0; c < 3; c++)
+					v.val[c] = vld1q_f32(s.in[c] + i);
+				v = map_neon(m, TRANSLATE, v);
+				for (int c = 0; c < 3; c++)
+				{
+					lo[c] = vminq_f32(lo[c], v.val[c]);
+					hi[c] = vmaxq_f32(hi[c], v.val[c]);
+				}
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				box.lo.vec[c] = vminvq_f32(lo[c]);
+				box.hi.vec[c] = vmaxvq_f32(hi[c]);
+			}
+			return i;
+		}
+
+		inline float32x4_t fast_slerp_t_neon(float32x4_t d, float32x4_t t)
+		{
+			const float32x4_t half = vdupq_n_f32(0.5f), one = vdupq_n_f32(1.0f);
+			float32x4_t ad = vabsq_f32(d);
+			float32x4_t ca = vsubq_f32(vdupq_n_f32(3.55645f), vmulq_f32(ad, vdupq_n_f32(1.43519f)));
+			ca = vaddq_f32(vdupq_n_f32(-3.2452f), vmulq_f32(ad, ca));
+			ca = vaddq_f32(vdupq_n_f32(1.0904f), vmulq_f32(ad, ca));
+			float32x4_t cb = vaddq_f32(vdupq_n_f32(-1.06021f), vmulq_f32(ad, vdupq_n_f32(0.215638f)));
+			cb = vaddq_f32(vdupq_n_f32(0.848013f), vmulq_f32(ad, cb));
+			float32x4_t th = vsubq_f32(t, half);
+			float32x4_t k = vaddq_f32(vmulq_f32(vmulq_f32(ca, th), th), cb);
+			return vaddq_f32(t, vmulq_f32(vmulq_f32(vmulq_f32(t, th), vsubq_f32(t, one)), k));
+		}
+
+		// vld4q and vst4q transpose four quaternions
+		size_t lerp_quats_neon(const quatf* a, const quatf* b, float t, bool fast, quatf* out, size_t i, size_t end)
+		{
+			const float32x4_t vt = vdupq_n_f32(t), one = vdupq_n_f32(1.0f);
+			for (; i + 4 <= end; i += 4)
+			{
+				float32x4x4_t qa = vld4q_f32(a[i].vec), qb = vld4q_f32(b[i].vec), r;
+				float32x4_t d = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(qa.val[0], qb.val[0]), vmulq_f32(qa.val[1], qb.val[1])), vmulq_f32(qa.val[2], qb.val[2])), vmulq_f32(qa.val[3], qb.val[3]));
+				float32x4_t tq = fast ? fast_slerp_t_neon(d, vt) : vt;
+				float32x4_t ta = vsubq_f32(one, tq);
+				float32x4_t tb = vbslq_f32(vcltq_f32(d, vdupq_n_f32(0.0f)), vnegq_f32(tq), tq);
+				for (int k = 0; k < 4; k++)
+					r.val[k] = vaddq_f32(vmulq_f32(qa.val[k], ta), vmulq_f32(qb.val[k], tb));
+				float32x4_t n2 = vaddq_f32(vaddq_f32(vaddq_f32(vmulq_f32(r.val[0], r.val[0]), vmulq_f32(r.val[1], r.val[1])), vmulq_f32(r.val[2], r.val[2])), vmulq_f32(r.val[3], r.val[3]));
+				float32x4_t in = vdivq_f32(one, vsqrtq_f32(n2));
+				for (int k = 0; k < 4; k++)
+					r.val[k] = vmulq_f32(r.val[k], in);
+				vst4q_f32(out[i].vec, r);
+			}
+			return i;
+		}
+
+#endif
+
+		//
+		// [begin, end) with the widest kernel there is, then the scalar tail
+		//
+		void map_soa(const affine3x4f& M, unsigned flags, const soa_t& s, size_t begin, size_t end)
+		{
+#if defined(LINALG_SSE)
+			if (use_avx())
+				begin = map_soa_avx(M, flags, s, begin, end);
+			begin = map_soa_sse(M, flags, s, begin, end);
+#elif defined(TRANSFORM_BATCH_NEON)
+			begin = map_soa_neon(M, flags, s, begin, end);
+#endif
+			map_soa_scalar(M, flags, s, begin, end);
+		}
+
+		void map_aos(const affine3x4f& M, unsigned flags, const vec3f* in, vec3f* out, size_t begin, size_t end)
+		{
+#if defined(LINALG_SSE)
+			begin = map_aos_sse(M, flags, in, out, begin, end);
+#elif defined(TRANSFORM_BATCH_NEON)
+			begin = map_aos_neon(M, flags, in, out, begin, end);
+#endif
+			for (; begin < end; begin++)
+				out[begin] = map(M, flags, in[begin]);
+		}
+
+		void bounds_soa(const affine3x4f& M, const soa_t& s, size_t begin, size_t end, aabb3f& box)
+		{
+#if defined(LINALG_SSE)
+			if (use_avx())
+				begin = bounds_soa_avx(M, s, begin, end, box);
+			begin = bounds_soa_sse(M, s, begin, end, box);
+#elif defined(TRANSFORM_BATCH_NEON)
+			begin = bounds_soa_neon(M, s, begin, end, box);
+#endif
+			bounds_soa_scalar(M, s, begin, end, box);
+		}
+
+		void transform_soa(const affine3x4f& M, unsigned flags, const float* x, const float* y, const float* z,
+			float* out_x, float* out_y, float* out_z, size_t n, unsigned nbr_threads)
+		{
+			soa_t s = { { x, y, z }, { out_x, out_y, out_z } };
+			parallel_for(n, nbr_threads, [&](size_t begin, size_t end) { map_soa(M, flags, s, begin, end); });
+		}
+
+		void transform_aos(const affine3x4f& M, unsigned flags, const vec3f* in, vec3f* out, size_t n, unsigned nbr_threads)
+		{
+			parallel_for(n, nbr_threads, [&](size_t begin, size_t end) { map_aos(M, flags, in, out, begin, end); });
+		}
+
+		void lerp_quats(const quatf* a, const quatf* b, float t, bool fast, quatf* out, size_t n, unsigned nbr_threads)
+		{
+			parallel_for(n, nbr_threads, [&](size_t begin, size_t end)
+			{
+#if defined(LINALG_SSE)
+				begin = lerp_quats_sse(a, b, t, fast, out, begin, end);
+#elif defined(TRANSFORM_BATCH_NEON)
+				begin = lerp_quats_neon(a, b, t, fast, out, begin, end);
+#endif
+				for (; begin < end; begin++)
+					out[begin] = lerp_quat(a[begin], b[begin], t, fast);
+			});
+		}
+
+		//
+		// The normal matrix as the 3x3 part of an affine transform without translation
+		//
+		affine3x4f normal_transform(const affine3x4f& M)
+		{
+			return affine3x4f(M.normal_matrix(), vec3f(0, 0, 0));
+		}
+	}
+
+	void transform_points(const affine3x4f& M, const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z, size_t n, unsigned nbr_threads)
+	{
+		transform_soa(M, TRANSLATE, x, y, z, out_x, out_y, out_z, n, nbr_threads);
+	}
+
+	void transform_vectors(const affine3x4f& M, const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z, size_t n, bool renormalize, unsigned nbr_threads)
+	{
+		transform_soa(M, renormalize ? RENORMALIZE : 0, x, y, z, out_x, out_y, out_z, n, nbr_threads);
+	}
+
+	void transform_normals(const affine3x4f& M, const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z, size_t n, bool renormalize, unsigned nbr_threads)
+	{
+		transform_soa(normal_transform(M), renormalize ? RENORMALIZE : 0, x, y, z, out_x, out_y, out_z, n, nbr_threads);
+	}
+
+	aabb3f transformed_bounds(const affine3x4f& M, const float* x, const float* y, const float* z,
+		size_t n, unsigned nbr_threads)
+	{
+		soa_t s = { { x, y, z }, { nullptr, nullptr, nullptr } };
+		std::vector<aabb3f> parts;
+		std::mutex lock;
+		parallel_for(n, nbr_threads, [&](size_t begin, size_t end)
+		{
+			aabb3f box = empty_aabb();
+			bounds_soa(M, s, begin, end, box);
+			std::lock_guard<std::mutex> guard(lock);
+			parts.push_back(box);
+		});
+
+		aabb3f box = empty_aabb();
+		for (const aabb3f& b : parts)
+		{
+			box.lo = vec3f(std::min(box.lo.x, b.lo.x), std::min(box.lo.y, b.lo.y), std::min(box.lo.z, b.lo.z));
+			box.hi = vec3f(std::max(box.hi.x, b.hi.x), std::max(box.hi.y, b.hi.y), std::max(box.hi.z, b.hi.z));
+		}
+		return box;
+	}
+
+	void transform_points(const affine3x4f& M, const vec3f* in, vec3f* out, size_t n, unsigned nbr_threads)
+	{
+		transform_aos(M, TRANSLATE, in, out, n, nbr_threads);
+	}
+
+	void transform_vectors(const affine3x4f& M, const vec3f* in, vec3f* out, size_t n, bool renormalize, unsigned nbr_threads)
+	{
+		transform_aos(M, renormalize ? RENORMALIZE : 0, in, out, n, nbr_threads);
+	}
+
+	void transform_normals(const affine3x4f& M, const vec3f* in, vec3f* out, size_t n, bool renormalize, unsigned nbr_threads)
+	{
+		transform_aos(normal_transform(M), renormalize ? RENORMALIZE : 0, in, out, n, nbr_threads);
+	}
+
+	void transform_points(const mat4f& M, const vec4f* in, vec4f* out, size_t n, unsigned nbr_threads)
+	{
+		parallel_for(n, nbr_threads, [&](size_t begin, size_t end)
+		{
+#if defined(LINALG_SSE)
+			begin = map_vec4_sse(M, in, out, begin, end);
+#endif
+			for (; begin < end; begin++)
+				out[begin] = M * in[begin];
+		});
+	}
+
+	void transform_aabbs(const affine3x4f& M, const aabb3f* in, aabb3f* out, size_t n, unsigned nbr_threads)
+	{
+		parallel_for(n, nbr_threads, [&](size_t begin, size_t end)
+		{
+#if defined(LINALG_SSE)
+			begin = map_aabbs_sse(M, in, out, begin, end);
+#endif
+			for (; begin < end; begin++)
+				out[begin] = transform_aabb(M, in[begin]);
+		});
+	}
+
+	void nlerp(const quatf* a, const quatf* b, float t, quatf* out, size_t n, unsigned nbr_threads)
+	{
+		lerp_quats(a, b, t, false, out, n, nbr_threads);
+	}
+
+	void fast_slerp(const quatf* a, const quatf* b, float t, quatf* out, size_t n, unsigned nbr_threads)
+	{
+		lerp_quats(a, b, t, true, out, n, nbr_threads);
+	}
+
+	void benchmark_transform_batch(size_t nbr_elements, unsigned rounds)
+	{
+		typedef std::chrono::high_resolution_clock bench_clock;
+		auto ns_per_element = [&](bench_clock::time_point start)
+		{
+			return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / ((double)nbr_elements * rounds);
+		};
+		unsigned nbr_threads = thread_count(0);
+		printf("transform batch benchmark (AVX: %s), %zu elements x %u rounds, %u threads\n",
+#if defined(LINALG_SSE)
+			use_avx() ? "yes" : "no",
+#else
+			"no",
+#endif
+			nbr_elements, rounds, nbr_threads);
+
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+		affine3x4f M = affine3x4f::TRS(vec3f(1, 2, 3), 0.7f, normalize(vec3f(1, -2, 0.5f)), vec3f(1.5f, 0.5f, 2.0f));
+		std::vector<float> x(nbr_elements), y(nbr_elements), z(nbr_elements);
+		std::vector<vec3f> p(nbr_elements);
+		std::vector<vec4f> p4(nbr_elements);
+		std::vector<aabb3f> boxes(nbr_elements);
+		for (size_t i = 0; i < nbr_elements; i++)
+		{
+			p[i] = vec3f(u(rng), u(rng), u(rng)) * 10.0f;
+			x[i] = p[i].x; y[i] = p[i].y; z[i] = p[i].z;
+			p4[i] = vec4f(p[i], 1.0f);
+			vec3f e(std::abs(u(rng)), std::abs(u(rng)), std::abs(u(rng)));
+			boxes[i].lo = p[i] - e;
+			boxes[i].hi = p[i] + e;
+		}
+		std::vector<float> ox(nbr_elements), oy(nbr_elements), oz(nbr_elements);
+		std::vector<vec3f> ref(nbr_elements), out(nbr_elements);
+		std::vector<vec4f> ref4(nbr_elements), out4(nbr_elements);
+		std::vector<aabb3f> ref_boxes(nbr_elements), out_boxes(nbr_elements);
+
+		auto diff_soa = [&]()
+		{
+			float d = 0;
+			for (size_t i = 0; i < nbr_elements; i++)
+				d = std::max(d, std::max(std::abs(ref[i].x - ox[i]), std::max(std::abs(ref[i].y - oy[i]), std::abs(ref[i].z - oz[i]))));
+			return d;
+		};
+		auto diff_aos = [&]()
+		{
+			float d = 0;
+			for (size_t i = 0; i < nbr_elements; i++)
+				d = std::max(d, (ref[i] - out[i]).norm2());
+			return d;
+		};
+		auto print = [](const char* op, double loop_ns, double batch_ns, double threads_ns, float diff)
+		{
+			printf("\t%-16s loop %5.2f ns, batch %5.2f ns (%.2fx), threaded %5.2f ns (%.2fx), max diff %g\n",
+				op, loop_ns, batch_ns, loop_ns / batch_ns, threads_ns, loop_ns / threads_ns, diff);
+		};
+		double loop_ns, batch_ns, threads_ns;
+
+		// points, SoA and AoS, against transform_point per vertex
+		auto start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (size_t i = 0; i < nbr_elements; i++)
+				ref[i] = M.transform_point(vec3f(x[i], y[i], z[i]));
+		loop_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_points(M, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), nbr_elements, 1);
+		batch_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_points(M, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), nbr_elements);
+		threads_ns = ns_per_element(start);
+		print("points SoA", loop_ns, batch_ns, threads_ns, diff_soa());
+
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (size_t i = 0; i < nbr_elements; i++)
+				ref[i] = M.transform_point(p[i]);
+		loop_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_points(M, p.data(), out.data(), nbr_elements, 1);
+		batch_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_points(M, p.data(), out.data(), nbr_elements);
+		threads_ns = ns_per_element(start);
+		print("points AoS", loop_ns, batch_ns, threads_ns, diff_aos());
+
+		// normals, against the normal matrix and normalize per vertex
+		mat3f N = M.normal_matrix();
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (size_t i = 0; i < nbr_elements; i++)
+				ref[i] = normalize(N * p[i]);
+		loop_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_normals(M, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), nbr_elements, true, 1);
+		batch_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_normals(M, x.data(), y.data(), z.data(), ox.data(), oy.data(), oz.data(), nbr_elements);
+		threads_ns = ns_per_element(start);
+		print("normals SoA", loop_ns, batch_ns, threads_ns, diff_soa());
+
+		// mat4f * vec4f, to clip space with a perspective projection
+		mat4f P = mat4f(1.36f, 0, 0, 0,
+						0, 2.41f, 0, 0,
+						0, 0, -1.002f, -0.2002f,
+						0, 0, -1, 0) * M.to_mat4();
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (size_t i = 0; i < nbr_elements; i++)
+				ref4[i] = P * p4[i];
+		loop_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_points(P, p4.data(), out4.data(), nbr_elements, 1);
+		batch_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_points(P, p4.data(), out4.data(), nbr_elements);
+		threads_ns = ns_per_element(start);
+		float diff = 0;
+		for (size_t i = 0; i < nbr_elements; i++)
+			for (int k = 0; k < 4; k++)
+				diff = std::max(diff, std::abs(ref4[i].vec[k] - out4[i].vec[k]));
+		print("vec4 by mat4", loop_ns, batch_ns, threads_ns, diff);
+
+		// boxes, against transforming their eight corners
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (size_t i = 0; i < nbr_elements; i++)
+			{
+				aabb3f b = empty_aabb();
+				for (int k = 0; k < 8; k++)
+				{
+					vec3f c = M.transform_point(vec3f(k & 1 ? boxes[i].hi.x : boxes[i].lo.x, k & 2 ? boxes[i].hi.y : boxes[i].lo.y, k & 4 ? boxes[i].hi.z : boxes[i].lo.z));
+					b.lo = vec3f(std::min(b.lo.x, c.x), std::min(b.lo.y, c.y), std::min(b.lo.z, c.z));
+					b.hi = vec3f(std::max(b.hi.x, c.x), std::max(b.hi.y, c.y), std::max(b.hi.z, c.z));
+				}
+				ref_boxes[i] = b;
+			}
+		loop_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_aabbs(M, boxes.data(), out_boxes.data(), nbr_elements, 1);
+		batch_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			transform_aabbs(M, boxes.data(), out_boxes.data(), nbr_elements);
+		threads_ns = ns_per_element(start);
+		diff = 0;
+		for (size_t i = 0; i < nbr_elements; i++)
+			diff = std::max(diff, std::max((ref_boxes[i].lo - out_boxes[i].lo).norm2(), (ref_boxes[i].hi - out_boxes[i].hi).norm2()));
+		print("boxes", loop_ns, batch_ns, threads_ns, diff);
+
+		// bounds of the transformed points
+		aabb3f box;
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+		{
+			box = empty_aabb();
+			for (size_t i = 0; i < nbr_elements; i++)
+			{
+				vec3f c = M.transform_point(vec3f(x[i], y[i], z[i]));
+				box.lo = vec3f(std::min(box.lo.x, c.x), std::min(box.lo.y, c.y), std::min(box.lo.z, c.z));
+				box.hi = vec3f(std::max(box.hi.x, c.x), std::max(box.hi.y, c.y), std::max(box.hi.z, c.z));
+			}
+		}
+		loop_ns = ns_per_element(start);
+		aabb3f batch_box;
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			batch_box = transformed_bounds(M, x.data(), y.data(), z.data(), nbr_elements, 1);
+		batch_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			batch_box = transformed_bounds(M, x.data(), y.data(), z.data(), nbr_elements);
+		threads_ns = ns_per_element(start);
+		print("bounds", loop_ns, batch_ns, threads_ns, std::max((box.lo - batch_box.lo).norm2(), (box.hi - batch_box.hi).norm2()));
+
+		// rotations between two keys: nlerp against itself per element, fast_slerp against slerp
+		std::vector<quatf> qa(nbr_elements), qb(nbr_elements), ref_q(nbr_elements), out_q(nbr_elements);
+		for (size_t i = 0; i < nbr_elements; i++)
+		{
+			qa[i] = quatf(u(rng), u(rng), u(rng), u(rng)).normalize();
+			qb[i] = quatf(u(rng), u(rng), u(rng), u(rng)).normalize();
+		}
+		const float t = 0.3f;
+		auto diff_quats = [&]()
+		{
+			float d = 0;
+			for (size_t i = 0; i < nbr_elements; i++)
+				for (int k = 0; k < 4; k++)
+					d = std::max(d, std::abs(ref_q[i].vec[k] - out_q[i].vec[k]));
+			return d;
+		};
+
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (size_t i = 0; i < nbr_elements; i++)
+				ref_q[i] = linalg::nlerp(qa[i], qb[i], t);
+		loop_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			nlerp(qa.data(), qb.data(), t, out_q.data(), nbr_elements, 1);
+		batch_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			nlerp(qa.data(), qb.data(), t, out_q.data(), nbr_elements);
+		threads_ns = ns_per_element(start);
+		print("quat nlerp", loop_ns, batch_ns, threads_ns, diff_quats());
+
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			for (size_t i = 0; i < nbr_elements; i++)
+				ref_q[i] = slerp(qa[i], qb[i], t);
+		loop_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			fast_slerp(qa.data(), qb.data(), t, out_q.data(), nbr_elements, 1);
+		batch_ns = ns_per_element(start);
+		start = bench_clock::now();
+		for (unsigned r = 0; r < rounds; r++)
+			fast_slerp(qa.data(), qb.data(), t, out_q.data(), nbr_elements);
+		threads_ns = ns_per_element(start);
+		print("slerp, fast", loop_ns, batch_ns, threads_ns, diff_quats());
+	}
+}
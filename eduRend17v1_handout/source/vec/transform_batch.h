@@ -0,0 +1,97 @@
+//
+//	transform_batch.h
+//
+//	Transforming arrays of points, vectors, normals and boxes by one matrix, and
+//	interpolating arrays of rotations
+//
+
+#pragma once
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include <cstddef>
+#include "mat.h"
+#include "quat.h"
+
+namespace linalg
+{
+	//
+	// Axis-aligned box; empty if lo > hi on any axis
+	//
+	struct aabb3f
+	{
+		vec3f lo, hi;
+	};
+
+	//
+	// The kernels work on four elements at a time with SSE2 or NEON, eight with AVX on
+	// the structure-of-arrays (SoA) forms when the CPU has it, and finish with scalar
+	// code. Points and vectors come out with the same bits as affine3x4f::transform_point
+	// and transform_vector. Input and output may be the same arrays, but not overlap
+	// otherwise.
+	//
+	// nbr_threads: 0 for one per hardware thread. Arrays shorter than a few ten thousand
+	// elements per thread are done on the calling thread.
+	//
+
+	//
+	// SoA, e.g. the position, normal and tangent streams of vertex_streams_t
+	//
+	void transform_points(const affine3x4f& M, const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z, size_t n, unsigned nbr_threads = 0);
+
+	//
+	// Directions, e.g. tangents, rescaled to unit length if renormalize is set; zero-length
+	// vectors stay zero
+	//
+	void transform_vectors(const affine3x4f& M, const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z, size_t n, bool renormalize = false, unsigned nbr_threads = 0);
+
+	//
+	// By M.normal_matrix(), then rescaled to unit length unless renormalize is false
+	//
+	void transform_normals(const affine3x4f& M, const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z, size_t n, bool renormalize = true, unsigned nbr_threads = 0);
+
+	//
+	// Box around the transformed points, without storing them
+	//
+	aabb3f transformed_bounds(const affine3x4f& M, const float* x, const float* y, const float* z,
+		size_t n, unsigned nbr_threads = 0);
+
+	//
+	// AoS: vec3f arrays are deinterleaved four at a time in registers
+	//
+	void transform_points(const affine3x4f& M, const vec3f* in, vec3f* out, size_t n, unsigned nbr_threads = 0);
+	void transform_vectors(const affine3x4f& M, const vec3f* in, vec3f* out, size_t n, bool renormalize = false, unsigned nbr_threads = 0);
+	void transform_normals(const affine3x4f& M, const vec3f* in, vec3f* out, size_t n, bool renormalize = true, unsigned nbr_threads = 0);
+
+	//
+	// Full 4x4 transform, e.g. to clip space for culling; same bits as mat4f * vec4f
+	//
+	void transform_points(const mat4f& M, const vec4f* in, vec4f* out, size_t n, unsigned nbr_threads = 0);
+
+	//
+	// Boxes around the transformed boxes, from their centers and half extents (Arvo):
+	// the center moves by M, the extent by M's 3x3 part with absolute values. Empty
+	// boxes come out as lo = FLT_MAX, hi = -FLT_MAX.
+	//
+	void transform_aabbs(const affine3x4f& M, const aabb3f* in, aabb3f* out, size_t n, unsigned nbr_threads = 0);
+
+	//
+	// out[i] = nlerp(a[i], b[i], t) and fast_slerp(a[i], b[i], t), e.g. blending the joint
+	// rotations of two animation keys; same bits as the scalar functions in quat.h. The
+	// kernels take four quaternions at a time, transposed to x, y, z and w registers. out
+	// may be a or b.
+	//
+	void nlerp(const quatf* a, const quatf* b, float t, quatf* out, size_t n, unsigned nbr_threads = 0);
+	void fast_slerp(const quatf* a, const quatf* b, float t, quatf* out, size_t n, unsigned nbr_threads = 0);
+
+	//
+	// Times the kernels against per-element loops over random data and prints ns per
+	// element and the largest differences
+	//
+	void benchmark_transform_batch(size_t nbr_elements = 1 << 20, unsigned rounds = 20);
+}
+
+#endif /* TRANSFORM_BATCH_H */
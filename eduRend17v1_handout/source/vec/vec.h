@@ -13,6 +13,11 @@
 #include <cstdio>
 #include <ostream>
 
+//
+// Constructors and the operations that are a single expression are constexpr, within the
+// C++11 rules VS2015 implements. Constant expressions have to read x, y, z and w, the union
+// member those constructors initialize; vec[] is only for run time.
+//
 namespace linalg
 {
     //
@@ -27,17 +32,9 @@ namespace linalg
             struct { T x, y; };
         };
         
-        vec2()
-        {
-            x = 0.0f;
-            y = 0.0f;
-        }
+        constexpr vec2() : x(0), y(0) { }
         
-        vec2(const T& x, const T& y)
-        {
-            this->x = x;
-            this->y = y;
-        }
+        constexpr vec2(const T& x, const T& y) : x(x), y(y) { }
         
         void set(const T &x, const T &y)
         {
@@ -45,7 +42,7 @@ namespace linalg
             this->y = y;
         }
         
-        float dot(const vec2<T> &u) const
+        constexpr float dot(const vec2<T> &u) const
         {
             return x*u.x + y*u.y;
         }
@@ -136,38 +133,37 @@ namespace linalg
             return *this;
         }
         
-        vec2<T> operator -() const
+        constexpr vec2<T> operator -() const
         {
             return vec2<T>(-x, -y);
         }
         
-        vec2<T> operator *(const T &s) const
+        constexpr vec2<T> operator *(const T &s) const
         {
             return vec2<T>(x * s, y * s);
         }
 
-        vec2<T> operator *(const vec2<T> &v) const
+        constexpr vec2<T> operator *(const vec2<T> &v) const
         {
             return vec2<T>(x * v.x, y * v.y);
         }
         
-        vec2<T> operator /(const T &v) const
+        constexpr vec2<T> operator /(const T &v) const
         {
-            T iv = 1.0 / v;
-            return vec2(x * iv, y * iv);
+            return *this * T(1.0 / v);
         }
         
-        vec2<T> operator +(const vec2<T> &v) const
+        constexpr vec2<T> operator +(const vec2<T> &v) const
         {
             return vec2<T>(x + v.x, y + v.y);
         }
         
-        vec2<T> operator -(const vec2<T> &v) const
+        constexpr vec2<T> operator -(const vec2<T> &v) const
         {
             return vec2<T>(x - v.x, y - v.y);
         }
         
-        T operator %(const vec2<T> &v) const
+        constexpr T operator %(const vec2<T> &v) const
         {
             return x * v.y - y * v.x;
         }
@@ -195,23 +191,13 @@ namespace linalg
             struct { T x, y, z; };
         };
         
-        vec3()
-        {
-            x = 0.0;
-            y = 0.0;
-            z = 0.0;
-        }
+        constexpr vec3() : x(0), y(0), z(0) { }
         
-        vec3(const T &x, const T &y, const T &z)
-        {
-            this->x = x;
-            this->y = y;
-            this->z = z;
-        }
+        constexpr vec3(const T &x, const T &y, const T &z) : x(x), y(y), z(z) { }
         
-        vec4<T> xyz0() const;
+        constexpr vec4<T> xyz0() const;
         
-        vec4<T> xyz1() const;
+        constexpr vec4<T> xyz1() const;
         
         void set(const T &x, const T &y, const T &z)
         {
@@ -220,7 +206,7 @@ namespace linalg
             this->z = z;
         }
         
-        T dot(const vec3<T> &u) const
+        constexpr T dot(const vec3<T> &u) const
         {
             return x*u.x + y*u.y + z*u.z;
         }
@@ -233,7 +219,7 @@ namespace linalg
             return sqrt(x*x + y*y + z*z);
         }
         
-        T norm2squared() const
+        constexpr T norm2squared() const
         {
             return x*x + y*y + z*z;
         }
@@ -315,45 +301,44 @@ namespace linalg
             return *this;
         }
         
-        vec3<T> operator -() const
+        constexpr vec3<T> operator -() const
         {
             return vec3<T>(-x, -y, -z);
         }
         
-        vec3<T> operator *(const T& s) const
+        constexpr vec3<T> operator *(const T& s) const
         {
             return vec3(x*s, y*s, z*s);
         }
         
-        vec3<T> operator *(const vec3<T>& v) const
+        constexpr vec3<T> operator *(const vec3<T>& v) const
         {
             return vec3<T>(x*v.x, y*v.y, z*v.z);
         }
         
-        vec3<T> operator /(const T& s) const
+        constexpr vec3<T> operator /(const T& s) const
         {
-            T is = 1.0 / s;
-            return vec3<T>(x*is, y*is, z*is);
+            return *this * T(1.0 / s);
         }
         
-        vec3<T> operator +(const vec3<T>& v) const
+        constexpr vec3<T> operator +(const vec3<T>& v) const
         {
             return vec3<T>(x+v.x, y+v.y, z+v.z);
         }
         
-        vec3<T> operator -(const vec3<T>& v) const
+        constexpr vec3<T> operator -(const vec3<T>& v) const
         {
             return vec3<T>(x-v.x, y-v.y, z-v.z);
         }
         
-        vec3<T> operator %(const vec3<T>& v) const
+        constexpr vec3<T> operator %(const vec3<T>& v) const
         {
             return vec3<T>(y*v.z-z*v.y, z*v.x-x*v.z, x*v.y-y*v.x);
         }
         
-        vec3<T> operator *(const mat3<T>& m) const;
+        constexpr vec3<T> operator *(const mat3<T>& m) const;
         
-        bool operator == (const vec3<T>& rhs) const
+        constexpr bool operator == (const vec3<T>& rhs) const
         {
             return x == rhs.x && y == rhs.y && z == rhs.z;
         }
@@ -384,26 +369,11 @@ namespace linalg
             struct { T x, y, z, w; };
         };
         
-        vec4()
-        {
-            x = y = z = w = 0;
-        }
+        constexpr vec4() : x(0), y(0), z(0), w(0) { }
         
-        vec4(const T &x, const T &y, const T &z, const T &w)
-        {
-            this->x = x;
-            this->y = y;
-            this->z = z;
-            this->w = w;
-        }
+        constexpr vec4(const T &x, const T &y, const T &z, const T &w) : x(x), y(y), z(z), w(w) { }
         
-        vec4(const vec3<T> &v, const T &w)
-        {
-            this->x = v.x;
-            this->y = v.y;
-            this->z = v.z;
-            this->w = w;
-        }
+        constexpr vec4(const vec3<T> &v, const T &w) : x(v.x), y(v.y), z(v.z), w(w) { }
         
         void set(const T &x, const T &y, const T &z, const T &w){
             this->x = x;
@@ -412,17 +382,17 @@ namespace linalg
             this->w = w;
         }
         
-        vec2<T> xy() const
+        constexpr vec2<T> xy() const
         {
             return vec2<T>(x, y);
         }
         
-        vec3<T> xyz() const
+        constexpr vec3<T> xyz() const
         {
             return vec3<T>(x, y, z);
         }
         
-        vec4<T> operator +(const vec4<T> &v) const
+        constexpr vec4<T> operator +(const vec4<T> &v) const
         {
             return vec4<T>(x+v.x, y+v.y, z+v.z, w+v.w);
         }
@@ -437,12 +407,12 @@ namespace linalg
             return *this;
         }
         
-        vec4<T> operator -(const vec4<T> &v) const
+        constexpr vec4<T> operator -(const vec4<T> &v) const
         {
             return vec4<T>(x-v.x, y-v.y, z-v.z, w-v.w);
         }
         
-        vec4<T> operator *(const T &s) const
+        constexpr vec4<T> operator *(const T &s) const
         {
             return vec4<T>(x*s, y*s, z*s, w*s);
         }
@@ -457,13 +427,25 @@ namespace linalg
     }
     
     template<class T>
-    inline T dot(const vec3<T>& u, const vec3<T>& v)
+    constexpr vec4<T> vec3<T>::xyz0() const
+    {
+        return vec4<T>(x, y, z, 0);
+    }
+    
+    template<class T>
+    constexpr vec4<T> vec3<T>::xyz1() const
+    {
+        return vec4<T>(x, y, z, 1);
+    }
+    
+    template<class T>
+    constexpr T dot(const vec3<T>& u, const vec3<T>& v)
     {
         return u.x*v.x + u.y*v.y + u.z*v.z;
     }
     
     template<class T>
-    inline T dot(const vec4<T>& u, const vec4<T>& v)
+    constexpr T dot(const vec4<T>& u, const vec4<T>& v)
     {
         return u.x*v.x + u.y*v.y + u.z*v.z + u.w*v.w;
     }
@@ -527,9 +509,9 @@ namespace linalg
     //
     // compile-time instances
     //
-    const vec2f vec2f_zero = vec2f(0, 0);
-    const vec3f vec3f_zero = vec3f(0, 0, 0);
-    const vec4f vec4f_zero = vec4f(0, 0, 0, 0);
+    constexpr vec2f vec2f_zero = vec2f(0, 0);
+    constexpr vec3f vec3f_zero = vec3f(0, 0, 0);
+    constexpr vec4f vec4f_zero = vec4f(0, 0, 0, 0);
 }
 
 #endif /* VEC_H */
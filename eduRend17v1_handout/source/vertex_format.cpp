@@ -0,0 +1,344 @@
+//
+//  vertex_format.cpp
+//
+//	Compact GPU vertex layouts encoded from vertex_t
+//
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include "vertex_format.h"
+
+namespace
+{
+	unsigned position_size(vertex_position_t p) { return p == POSITION_FLOAT3 ? 12 : 8; }
+	unsigned direction_size(vertex_direction_t d) { return d == DIRECTION_NONE ? 0 : d == DIRECTION_FLOAT3 ? 12 : 4; }
+	unsigned texcoord_size(vertex_texcoord_t t) { return t == TEXCOORD_NONE ? 0 : t == TEXCOORD_FLOAT2 ? 8 : 4; }
+
+	DXGI_FORMAT direction_format(vertex_direction_t d)
+	{
+		return d == DIRECTION_FLOAT3 ? DXGI_FORMAT_R32G32B32_FLOAT : DXGI_FORMAT_R16G16_SNORM;
+	}
+
+	//
+	// float <-> IEEE half, round to nearest even
+	//
+	uint16_t float_to_half(float f)
+	{
+		uint32_t x;
+		memcpy(&x, &f, 4);
+		uint32_t sign = (x >> 16) & 0x8000, a = x & 0x7fffffff;
+
+		if (a >= 0x7f800000)		// inf, nan
+			return (uint16_t)(sign | 0x7c00 | (a > 0x7f800000 ? 0x200 : 0));
+		if (a >= 0x477ff000)		// rounds to >= 65536
+			return (uint16_t)(sign | 0x7c00);
+		if (a < 0x38800000)			// half denormal or zero: exact scale, then round
+		{
+			float af;
+			memcpy(&af, &a, 4);
+			return (uint16_t)(sign | (uint32_t)lrintf(af * 16777216.0f));
+		}
+
+		// rebias exponent and round the 13 dropped mantissa bits
+		a += 0xc8000fff + ((a >> 13) & 1);
+		return (uint16_t)(sign | (a >> 13));
+	}
+
+	float half_to_float(uint16_t h)
+	{
+		uint32_t sign = (uint32_t)(h & 0x8000) << 16, e = (h >> 10) & 0x1f, m = h & 0x3ff, x;
+		if (!e)
+		{
+			float f = m * (1.0f / 16777216.0f);
+			return sign ? -f : f;
+		}
+		x = sign | (e == 31 ? 0x7f800000 | (m << 13) : ((e + 112) << 23) | (m << 13));
+		float f;
+		memcpy(&f, &x, 4);
+		return f;
+	}
+
+	//
+	// snorm16 as the input assembler reads it
+	//
+	float snorm16_to_float(int16_t s) { return std::max(s / 32767.0f, -1.0f); }
+
+	float sign_nz(float x) { return x >= 0.0f ? 1.0f : -1.0f; }
+
+	//
+	// Octahedral mapping of unit vectors to [-1,1]^2 (Cigolle et al. 2014)
+	//
+	vec3f oct_decode(float x, float y)
+	{
+		vec3f v(x, y, 1.0f - fabsf(x) - fabsf(y));
+		float t = std::max(-v.z, 0.0f);
+		v.x += v.x >= 0.0f ? -t : t;
+		v.y += v.y >= 0.0f ? -t : t;
+		return linalg::normalize(v);
+	}
+
+	//
+	// Rounds to the snorm16 pair that decodes closest to n, rather than just the nearest
+	// one, which roughly halves the worst-case angular error
+	//
+	void oct_encode(const vec3f& n, int16_t out[2])
+	{
+		float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+		if (l1 < 1e-20f)
+		{
+			out[0] = out[1] = 0;
+			return;
+		}
+		float x = n.x / l1, y = n.y / l1;
+		if (n.z < 0.0f)
+		{
+			float ox = x;
+			x = (1.0f - fabsf(y)) * sign_nz(ox);
+			y = (1.0f - fabsf(ox)) * sign_nz(y);
+		}
+
+		float fx = floorf(x * 32767.0f), fy = floorf(y * 32767.0f);
+		vec3f nn = linalg::normalize(n);
+		float best = -2.0f;
+		for (int i = 0; i < 4; i++)
+		{
+			float cx = std::min(std::max(fx + (i & 1), -32767.0f), 32767.0f);
+			float cy = std::min(std::max(fy + (i >> 1), -32767.0f), 32767.0f);
+			float d = linalg::dot(oct_decode(cx / 32767.0f, cy / 32767.0f), nn);
+			if (d > best)
+			{
+				best = d;
+				out[0] = (int16_t)cx;
+				out[1] = (int16_t)cy;
+			}
+		}
+	}
+
+	void encode_direction(vertex_direction_t d, const vec3f& v, unsigned char* dst)
+	{
+		if (d == DIRECTION_FLOAT3)
+			memcpy(dst, v.vec, 12);
+		else if (d == DIRECTION_OCT16)
+		{
+			int16_t e[2];
+			oct_encode(v, e);
+			memcpy(dst, e, 4);
+		}
+	}
+
+	vec3f decode_direction(vertex_direction_t d, const unsigned char* src)
+	{
+		vec3f v;
+		if (d == DIRECTION_FLOAT3)
+			memcpy(v.vec, src, 12);
+		else if (d == DIRECTION_OCT16)
+		{
+			int16_t e[2];
+			memcpy(e, src, 4);
+			v = oct_decode(snorm16_to_float(e[0]), snorm16_to_float(e[1]));
+		}
+		return v;
+	}
+
+	// atan2 rather than acos of the dot product, which is too coarse near 0
+	float angle_deg(const vec3f& a, const vec3f& b)
+	{
+		return atan2f((a % b).norm2(), linalg::dot(a, b)) * (180.0f / PI);
+	}
+}
+
+std::vector<vertex_element_t> vertex_format_t::elements() const
+{
+	std::vector<vertex_element_t> e;
+	unsigned ofs = 0;
+
+	e.push_back({ "POSITION", position == POSITION_FLOAT3 ? DXGI_FORMAT_R32G32B32_FLOAT : DXGI_FORMAT_R16G16B16A16_UNORM, ofs });
+	ofs += position_size(position);
+	if (normal != DIRECTION_NONE)
+	{
+		e.push_back({ "NORMAL", direction_format(normal), ofs });
+		ofs += direction_size(normal);
+	}
+	if (tangents != DIRECTION_NONE)
+	{
+		e.push_back({ "TANGENT", direction_format(tangents), ofs });
+		ofs += direction_size(tangents);
+		e.push_back({ "BINORMAL", direction_format(tangents), ofs });
+		ofs += direction_size(tangents);
+	}
+	if (texcoord != TEXCOORD_NONE)
+		e.push_back({ "TEX", texcoord == TEXCOORD_FLOAT2 ? DXGI_FORMAT_R32G32_FLOAT : DXGI_FORMAT_R16G16_FLOAT, ofs });
+
+	return e;
+}
+
+unsigned vertex_format_t::stride() const
+{
+	return position_size(position) + direction_size(normal) + 2 * direction_size(tangents) + texcoord_size(texcoord);
+}
+
+std::vector<D3D11_INPUT_ELEMENT_DESC> vertex_format_t::input_layout() const
+{
+	std::vector<D3D11_INPUT_ELEMENT_DESC> layout;
+	for (auto& e : elements())
+		layout.push_back({ e.semantic, 0, e.format, 0, e.offset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+	return layout;
+}
+
+std::vector<D3D_SHADER_MACRO> vertex_format_t::shader_defines() const
+{
+	static const char* values[] = { "0", "1", "2" };
+	return {
+		{ "VERTEX_NORMAL", values[normal] },
+		{ "VERTEX_TANGENTS", values[tangents] },
+		{ "VERTEX_TEXCOORD", values[texcoord != TEXCOORD_NONE] },
+		{ nullptr, nullptr } };
+}
+
+std::string vertex_format_t::name() const
+{
+	static const char* directions[] = { "-", "float3", "oct16" };
+	std::string s = position == POSITION_FLOAT3 ? "float3" : "pos16";
+	s += std::string("/") + directions[normal] + "/" + directions[tangents] + "/";
+	s += texcoord == TEXCOORD_NONE ? "-" : texcoord == TEXCOORD_FLOAT2 ? "float2" : "half2";
+	return s;
+}
+
+vertex_decode_t encode_vertices(	const vertex_format_t& format,
+									const vertex_t* vertices,
+									size_t nbr_vertices,
+									std::vector<unsigned char>& out)
+{
+	vertex_decode_t decode;
+	unsigned stride = format.stride();
+	out.assign(nbr_vertices * stride, 0);
+
+	if (format.position == POSITION_UNORM16 && nbr_vertices)
+	{
+		vec3f lo = vertices[0].Pos, hi = vertices[0].Pos;
+		for (size_t i = 1; i < nbr_vertices; i++)
+			for (int k = 0; k < 3; k++)
+			{
+				lo.vec[k] = std::min(lo.vec[k], vertices[i].Pos.vec[k]);
+				hi.vec[k] = std::max(hi.vec[k], vertices[i].Pos.vec[k]);
+			}
+		decode.pos_offset = lo;
+		decode.pos_scale = hi - lo;
+	}
+
+	std::vector<vertex_element_t> elements = format.elements();
+	for (size_t i = 0; i < nbr_vertices; i++)
+	{
+		const vertex_t& v = vertices[i];
+		unsigned char* dst = out.data() + i * stride;
+		unsigned e = 0;
+
+		if (format.position == POSITION_FLOAT3)
+			memcpy(dst, v.Pos.vec, 12);
+		else
+		{
+			uint16_t q[4] = { 0, 0, 0, 0 };
+			for (int k = 0; k < 3; k++)
+				if (decode.pos_scale.vec[k] > 0.0f)
+					q[k] = (uint16_t)lrintf((v.Pos.vec[k] - decode.pos_offset.vec[k]) / decode.pos_scale.vec[k] * 65535.0f);
+			memcpy(dst, q, 8);
+		}
+		e++;
+
+		if (format.normal != DIRECTION_NONE)
+			encode_direction(format.normal, v.Normal, dst + elements[e++].offset);
+		if (format.tangents != DIRECTION_NONE)
+		{
+			encode_direction(format.tangents, v.Tangent, dst + elements[e++].offset);
+			encode_direction(format.tangents, v.Binormal, dst + elements[e++].offset);
+		}
+
+		if (format.texcoord == TEXCOORD_FLOAT2)
+			memcpy(dst + elements[e].offset, v.TexCoord.vec, 8);
+		else if (format.texcoord == TEXCOORD_HALF2)
+		{
+			uint16_t h[2] = { float_to_half(v.TexCoord.x), float_to_half(v.TexCoord.y) };
+			memcpy(dst + elements[e].offset, h, 4);
+		}
+	}
+
+	return decode;
+}
+
+vertex_t decode_vertex(	const vertex_format_t& format,
+						const vertex_decode_t& decode,
+						const unsigned char* data)
+{
+	vertex_t v;
+	std::vector<vertex_element_t> elements = format.elements();
+	unsigned e = 0;
+
+	if (format.position == POSITION_FLOAT3)
+		memcpy(v.Pos.vec, data, 12);
+	else
+	{
+		uint16_t q[4];
+		memcpy(q, data, 8);
+		for (int k = 0; k < 3; k++)
+			v.Pos.vec[k] = q[k] / 65535.0f;
+	}
+	v.Pos = v.Pos * decode.pos_scale + decode.pos_offset;
+	e++;
+
+	if (format.normal != DIRECTION_NONE)
+		v.Normal = decode_direction(format.normal, data + elements[e++].offset);
+	if (format.tangents != DIRECTION_NONE)
+	{
+		v.Tangent = decode_direction(format.tangents, data + elements[e++].offset);
+		v.Binormal = decode_direction(format.tangents, data + elements[e++].offset);
+	}
+
+	if (format.texcoord == TEXCOORD_FLOAT2)
+		memcpy(v.TexCoord.vec, data + elements[e].offset, 8);
+	else if (format.texcoord == TEXCOORD_HALF2)
+	{
+		uint16_t h[2];
+		memcpy(h, data + elements[e].offset, 4);
+		v.TexCoord = vec2f(half_to_float(h[0]), half_to_float(h[1]));
+	}
+
+	return v;
+}
+
+vertex_encoding_error_t measure_encoding_error(	const vertex_format_t& format,
+												const vertex_decode_t& decode,
+												const vertex_t* vertices,
+												size_t nbr_vertices,
+												const unsigned char* encoded)
+{
+	vertex_encoding_error_t err;
+	float diagonal = decode.pos_scale.norm2();
+	unsigned stride = format.stride();
+
+	for (size_t i = 0; i < nbr_vertices; i++)
+	{
+		const vertex_t& v = vertices[i];
+		vertex_t d = decode_vertex(format, decode, encoded + i * stride);
+
+		if (format.position != POSITION_FLOAT3 && diagonal > 0.0f)
+			err.position = std::max(err.position, (d.Pos - v.Pos).norm2() / diagonal);
+
+		// unset (zero) directions have nothing to preserve
+		if (format.normal == DIRECTION_OCT16 && v.Normal.norm2squared() > 1e-8f)
+			err.normal = std::max(err.normal, angle_deg(d.Normal, v.Normal));
+		if (format.tangents == DIRECTION_OCT16)
+		{
+			if (v.Tangent.norm2squared() > 1e-8f)
+				err.tangent = std::max(err.tangent, angle_deg(d.Tangent, v.Tangent));
+			if (v.Binormal.norm2squared() > 1e-8f)
+				err.tangent = std::max(err.tangent, angle_deg(d.Binormal, v.Binormal));
+		}
+
+		if (format.texcoord == TEXCOORD_HALF2)
+			err.texcoord = std::max(err.texcoord, std::max(fabsf(d.TexCoord.x - v.TexCoord.x), fabsf(d.TexCoord.y - v.TexCoord.y)));
+	}
+
+	return err;
+}
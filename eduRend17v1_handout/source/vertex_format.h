@@ -0,0 +1,143 @@
+//
+//  vertex_format.h
+//
+//	Compact GPU vertex layouts encoded from vertex_t
+//
+
+#pragma once
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <vector>
+#include "stdafx.h"
+#include "drawcall.h"
+
+enum vertex_position_t
+{
+	POSITION_FLOAT3,		// 12 bytes
+	POSITION_UNORM16,		// 8 bytes, quantized to the mesh bounding box
+};
+
+enum vertex_direction_t
+{
+	DIRECTION_NONE,
+	DIRECTION_FLOAT3,		// 12 bytes
+	DIRECTION_OCT16,		// 4 bytes, octahedral encoding in two snorm16
+};
+
+enum vertex_texcoord_t
+{
+	TEXCOORD_NONE,
+	TEXCOORD_FLOAT2,		// 8 bytes
+	TEXCOORD_HALF2,			// 4 bytes
+};
+
+//
+// One attribute of an encoded vertex
+//
+struct vertex_element_t
+{
+	const char* semantic;
+	DXGI_FORMAT format;
+	unsigned offset;
+};
+
+//
+// Describes how vertex_t is stored in a vertex buffer. The same descriptor gives the
+// input layout, the shader defines that select the matching decode in DrawTri.vs, and
+// the encoder.
+//
+// tangents applies to both Tangent and Binormal.
+//
+struct vertex_format_t
+{
+	vertex_position_t position = POSITION_FLOAT3;
+	vertex_direction_t normal = DIRECTION_FLOAT3;
+	vertex_direction_t tangents = DIRECTION_FLOAT3;
+	vertex_texcoord_t texcoord = TEXCOORD_FLOAT2;
+
+	// vertex_t as is, 56 bytes
+	static vertex_format_t full() { return vertex_format_t(); }
+
+	// quantized position, octahedral normal & tangents, half texcoords, 24 bytes
+	static vertex_format_t compact()
+	{
+		vertex_format_t f;
+		f.position = POSITION_UNORM16;
+		f.normal = DIRECTION_OCT16;
+		f.tangents = DIRECTION_OCT16;
+		f.texcoord = TEXCOORD_HALF2;
+		return f;
+	}
+
+	// compact without tangents, 16 bytes
+	static vertex_format_t compact_no_tangents()
+	{
+		vertex_format_t f = compact();
+		f.tangents = DIRECTION_NONE;
+		return f;
+	}
+
+	std::vector<vertex_element_t> elements() const;
+
+	unsigned stride() const;
+
+	//
+	// D3D11 input layout; semantic names point to static strings
+	//
+	std::vector<D3D11_INPUT_ELEMENT_DESC> input_layout() const;
+
+	//
+	// Null-terminated macro list for compiling DrawTri.vs
+	//
+	std::vector<D3D_SHADER_MACRO> shader_defines() const;
+
+	// short description, e.g. "pos16/oct16/oct16/half2"
+	std::string name() const;
+};
+
+//
+// Maps a decoded position back to model space: pos = Pos * pos_scale + pos_offset.
+// Identity unless positions are quantized.
+//
+struct vertex_decode_t
+{
+	vec3f pos_scale = { 1, 1, 1 };
+	vec3f pos_offset = { 0, 0, 0 };
+};
+
+//
+// Encodes vertices to format.stride() bytes each and returns the position decode
+//
+vertex_decode_t encode_vertices(	const vertex_format_t& format,
+									const vertex_t* vertices,
+									size_t nbr_vertices,
+									std::vector<unsigned char>& out);
+
+//
+// Decodes one vertex the way the input assembler and DrawTri.vs would. Attributes the
+// format does not store are zero.
+//
+vertex_t decode_vertex(	const vertex_format_t& format,
+						const vertex_decode_t& decode,
+						const unsigned char* data);
+
+//
+// Largest encode/decode round trip error over a vertex array. Attributes the format
+// stores as floats, or not at all, report 0.
+//
+struct vertex_encoding_error_t
+{
+	float position = 0;		// distance, relative to the bounding box diagonal
+	float normal = 0;		// angle in degrees
+	float tangent = 0;		// angle in degrees, Tangent and Binormal
+	float texcoord = 0;		// absolute
+};
+
+vertex_encoding_error_t measure_encoding_error(	const vertex_format_t& format,
+												const vertex_decode_t& decode,
+												const vertex_t* vertices,
+												size_t nbr_vertices,
+												const unsigned char* encoded);
+
+#endif
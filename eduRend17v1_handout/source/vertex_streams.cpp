@@ -0,0 +1,61 @@
+//
+//  vertex_streams.cpp
+//
+//	Structure-of-arrays vertex storage for CPU-side mesh processing
+//
+
+#include "vertex_streams.h"
+#include "vec/transform_batch.h"
+
+std::vector<std::vector<float>*> vertex_streams_t::streams()
+{
+	return { &px, &py, &pz, &nx, &ny, &nz, &tx, &ty, &tz, &bx, &by, &bz, &u, &v };
+}
+
+void vertex_streams_t::reserve(size_t n) { for (auto s : streams()) s->reserve(n); }
+void vertex_streams_t::resize(size_t n) { for (auto s : streams()) s->resize(n); }
+void vertex_streams_t::clear() { for (auto s : streams()) s->clear(); }
+
+void vertex_streams_t::push_back_copy(size_t i)
+{
+	// copy the value first, push_back may reallocate
+	for (auto s : streams())
+	{
+		float f = (*s)[i];
+		s->push_back(f);
+	}
+}
+
+void vertex_streams_t::permute(const std::vector<unsigned>& remap)
+{
+	std::vector<float> tmp(size());
+	for (auto s : streams())
+	{
+		const float* src = s->data();
+		for (size_t i = 0; i < tmp.size(); i++)
+			tmp[remap[i]] = src[i];
+		s->swap(tmp);
+	}
+}
+
+void vertex_streams_t::bounds(vec3f& lo, vec3f& hi) const
+{
+	aabb3f box = transformed_bounds(affine3x4f_identity, px.data(), py.data(), pz.data(), size());
+	lo = box.lo;
+	hi = box.hi;
+}
+
+void vertex_streams_t::interleave(std::vector<vertex_t>& out) const
+{
+	size_t n = size();
+	out.resize(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		vertex_t& vert = out[i];
+		vert.Pos = vec3f(px[i], py[i], pz[i]);
+		vert.Normal = vec3f(nx[i], ny[i], nz[i]);
+		vert.Tangent = vec3f(tx[i], ty[i], tz[i]);
+		vert.Binormal = vec3f(bx[i], by[i], bz[i]);
+		vert.TexCoord = vec2f(u[i], v[i]);
+	}
+}
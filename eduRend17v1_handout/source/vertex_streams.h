@@ -0,0 +1,73 @@
+//
+//  vertex_streams.h
+//
+//	Structure-of-arrays vertex storage for CPU-side mesh processing
+//
+
+#pragma once
+#ifndef VERTEX_STREAMS_H
+#define VERTEX_STREAMS_H
+
+#include <vector>
+#include "drawcall.h"
+#include "vec/mat.h"
+
+//
+// Each vertex attribute component in its own array, so a pass reading positions only
+// touches position data, 12 bytes per vertex instead of a 56-byte vertex_t. Meshes are
+// processed in this form and interleaved to vertex_t for upload.
+//
+struct vertex_streams_t
+{
+	std::vector<float> px, py, pz;	// position
+	std::vector<float> nx, ny, nz;	// normal
+	std::vector<float> tx, ty, tz;	// tangent
+	std::vector<float> bx, by, bz;	// binormal
+	std::vector<float> u, v;		// texture coordinate
+
+	size_t size() const { return px.size(); }
+
+	// all of the above, for operations that treat them alike
+	std::vector<std::vector<float>*> streams();
+
+	void reserve(size_t n);
+	void resize(size_t n);
+	void clear();
+
+	void push_back(const vec3f& pos, const vec3f& normal, const vec2f& texcoord)
+	{
+		px.push_back(pos.x); py.push_back(pos.y); pz.push_back(pos.z);
+		nx.push_back(normal.x); ny.push_back(normal.y); nz.push_back(normal.z);
+		tx.push_back(0); ty.push_back(0); tz.push_back(0);
+		bx.push_back(0); by.push_back(0); bz.push_back(0);
+		u.push_back(texcoord.x); v.push_back(texcoord.y);
+	}
+
+	//
+	// Appends a copy of vertex i
+	//
+	void push_back_copy(size_t i);
+
+	vec3f position(size_t i) const { return vec3f(px[i], py[i], pz[i]); }
+	vec3f normal(size_t i) const { return vec3f(nx[i], ny[i], nz[i]); }
+	vec3f tangent(size_t i) const { return vec3f(tx[i], ty[i], tz[i]); }
+	vec3f binormal(size_t i) const { return vec3f(bx[i], by[i], bz[i]); }
+	vec2f texcoord(size_t i) const { return vec2f(u[i], v[i]); }
+
+	//
+	// Moves vertex i to remap[i]; remap must be a permutation
+	//
+	void permute(const std::vector<unsigned>& remap);
+
+	//
+	// Axis-aligned bounding box of the positions; an empty box (lo > hi) if there are none
+	//
+	void bounds(vec3f& lo, vec3f& hi) const;
+
+	//
+	// AoS copy for upload
+	//
+	void interleave(std::vector<vertex_t>& out) const;
+};
+
+#endif